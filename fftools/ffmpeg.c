@@ -132,9 +132,10 @@ static int64_t getmaxrss(void);
 static int ifilter_has_all_input_formats(FilterGraph *fg);
 
 static int run_as_daemon  = 0;
-static int nb_frames_dup = 0;
-static unsigned dup_warning = 1000;
-static int nb_frames_drop = 0;
+/* atomic since they are updated from the output threads with -parallel_outputs */
+static atomic_int nb_frames_dup = ATOMIC_VAR_INIT(0);
+static atomic_uint dup_warning = ATOMIC_VAR_INIT(1000);
+static atomic_int nb_frames_drop = ATOMIC_VAR_INIT(0);
 static int64_t decode_error_stat[2];
 
 static int want_sdp = 1;
@@ -166,6 +167,7 @@ static int restore_tty;
 
 #if HAVE_THREADS
 static void free_input_threads(void);
+static void free_output_threads(void);
 #endif
 
 /* sub2video hack:
@@ -484,6 +486,12 @@ static void ffmpeg_cleanup(int ret)
 {
     int i, j;
 
+#if HAVE_THREADS
+    /* the output threads may still be encoding, stop them before freeing
+     * anything they use */
+    free_output_threads();
+#endif
+
     if (do_benchmark) {
         int maxrss = getmaxrss() / 1024;
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%ikB\n", maxrss);
@@ -614,6 +622,7 @@ static void ffmpeg_cleanup(int ret)
                    av_err2str(AVERROR(errno)));
     }
     av_freep(&vstats_filename);
+    av_freep(&filter_thread_type);
 
     av_freep(&input_streams);
     av_freep(&input_files);
@@ -687,7 +696,7 @@ static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream,
     }
 }
 
-static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int unqueue)
+static int write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int unqueue)
 {
     AVFormatContext *s = of->ctx;
     AVStream *st = ost->st;
@@ -704,7 +713,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
     if (!(st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && ost->encoding_needed) && !unqueue) {
         if (ost->frame_number >= ost->max_frames) {
             av_packet_unref(pkt);
-            return;
+            return 0;
         }
         ost->frame_number++;
     }
@@ -719,18 +728,18 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
                 av_log(NULL, AV_LOG_ERROR,
                        "Too many packets buffered for output stream %d:%d.\n",
                        ost->file_index, ost->st->index);
-                exit_program(1);
+                return AVERROR(ENOSPC);
             }
             ret = av_fifo_realloc2(ost->muxing_queue, new_size);
             if (ret < 0)
-                exit_program(1);
+                return ret;
         }
         ret = av_packet_make_refcounted(pkt);
         if (ret < 0)
-            exit_program(1);
+            return ret;
         av_packet_move_ref(&tmp_pkt, pkt);
         av_fifo_generic_write(ost->muxing_queue, &tmp_pkt, sizeof(tmp_pkt), NULL);
-        return;
+        return 0;
     }
 
     if ((st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && video_sync_method == VSYNC_DROP) ||
@@ -785,7 +794,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
                        ost->file_index, ost->st->index, ost->last_mux_dts, pkt->dts);
                 if (exit_on_error) {
                     av_log(NULL, AV_LOG_FATAL, "aborting.\n");
-                    exit_program(1);
+                    return AVERROR(EINVAL);
                 }
                 av_log(s, loglevel, "changing to %"PRId64". This may result "
                        "in incorrect timestamps in the output file.\n",
@@ -816,10 +825,21 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
     ret = av_interleaved_write_frame(s, pkt);
     if (ret < 0) {
         print_error("av_interleaved_write_frame()", ret);
-        main_return_code = 1;
-        close_all_output_streams(ost, MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
+#if HAVE_THREADS
+        if (of->out_thread_queue && pthread_equal(of->thread, pthread_self())) {
+            /* the other output threads may be running, let the main thread
+             * finish their streams once they are idle */
+            ost->finished |= MUXER_FINISHED | ENCODER_FINISHED;
+            of->mux_error_ost = ost;
+        } else
+#endif
+        {
+            main_return_code = 1;
+            close_all_output_streams(ost, MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
+        }
     }
     av_packet_unref(pkt);
+    return 0;
 }
 
 static void close_output_stream(OutputStream *ost)
@@ -844,13 +864,14 @@ static void close_output_stream(OutputStream *ost)
  * therefore flush any delayed packets to the output.  A blank packet
  * must be supplied in this case.
  */
-static void output_packet(OutputFile *of, AVPacket *pkt,
-                          OutputStream *ost, int eof)
+static int output_packet(OutputFile *of, AVPacket *pkt,
+                         OutputStream *ost, int eof)
 {
     int ret = 0;
 
     /* apply the output bitstream filters, if any */
     if (ost->nb_bitstream_filters) {
+        const AVBuffer *buf = !eof && pkt->buf ? pkt->buf->buffer : NULL;
         int idx;
 
         ret = av_bsf_send_packet(ost->bsf_ctx[0], eof ? NULL : pkt);
@@ -880,19 +901,24 @@ static void output_packet(OutputFile *of, AVPacket *pkt,
                 eof = 0;
             } else if (eof)
                 goto finish;
-            else
-                write_packet(of, pkt, ost, 0);
+            else {
+                if (pkt->buf && pkt->buf->buffer != buf)
+                    ost->copied_size += pkt->size;
+                if ((ret = write_packet(of, pkt, ost, 0)) < 0)
+                    return ret;
+            }
         }
     } else if (!eof)
-        write_packet(of, pkt, ost, 0);
+        return write_packet(of, pkt, ost, 0);
 
 finish:
     if (ret < 0 && ret != AVERROR_EOF) {
         av_log(NULL, AV_LOG_ERROR, "Error applying bitstream filters to an output "
                "packet for stream #%d:%d.\n", ost->file_index, ost->index);
         if(exit_on_error)
-            exit_program(1);
+            return ret;
     }
+    return 0;
 }
 
 static int check_recording_time(OutputStream *ost)
@@ -908,8 +934,8 @@ static int check_recording_time(OutputStream *ost)
     return 1;
 }
 
-static void do_audio_out(OutputFile *of, OutputStream *ost,
-                         AVFrame *frame)
+static int do_audio_out(OutputFile *of, OutputStream *ost,
+                        AVFrame *frame)
 {
     AVCodecContext *enc = ost->enc_ctx;
     AVPacket pkt;
@@ -920,7 +946,7 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
     pkt.size = 0;
 
     if (!check_recording_time(ost))
-        return;
+        return 0;
 
     if (frame->pts == AV_NOPTS_VALUE || audio_sync_method < 0)
         frame->pts = ost->sync_opts;
@@ -959,13 +985,14 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                    av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
         }
 
-        output_packet(of, &pkt, ost, 0);
+        if ((ret = output_packet(of, &pkt, ost, 0)) < 0)
+            return ret;
     }
 
-    return;
+    return 0;
 error:
     av_log(NULL, AV_LOG_FATAL, "Audio encoding failed\n");
-    exit_program(1);
+    return ret;
 }
 
 static void do_subtitle_out(OutputFile *of,
@@ -1047,21 +1074,23 @@ static void do_subtitle_out(OutputFile *of,
                 pkt.pts += av_rescale_q(sub->end_display_time, (AVRational){ 1, 1000 }, ost->mux_timebase);
         }
         pkt.dts = pkt.pts;
-        output_packet(of, &pkt, ost, 0);
+        if (output_packet(of, &pkt, ost, 0) < 0)
+            exit_program(1);
     }
 }
 
-static void do_video_out(OutputFile *of,
-                         OutputStream *ost,
-                         AVFrame *next_picture,
-                         double sync_ipts)
+static int do_video_out(OutputFile *of,
+                        OutputStream *ost,
+                        AVFrame *next_picture,
+                        double sync_ipts)
 {
     int ret, format_video_sync;
     AVPacket pkt;
     AVCodecContext *enc = ost->enc_ctx;
     AVCodecParameters *mux_par = ost->st->codecpar;
     AVRational frame_rate;
-    int nb_frames, nb0_frames, i;
+    int nb_frames, nb0_frames, i, dup;
+    unsigned warning;
     double delta, delta0;
     double duration = 0;
     int frame_size = 0;
@@ -1175,7 +1204,7 @@ static void do_video_out(OutputFile *of,
     ost->last_nb0_frames[0] = nb0_frames;
 
     if (nb0_frames == 0 && ost->last_dropped) {
-        nb_frames_drop++;
+        atomic_fetch_add(&nb_frames_drop, 1);
         av_log(NULL, AV_LOG_VERBOSE,
                "*** dropping frame %d from stream %d at ts %"PRId64"\n",
                ost->frame_number, ost->st->index, ost->last_frame->pts);
@@ -1183,15 +1212,16 @@ static void do_video_out(OutputFile *of,
     if (nb_frames > (nb0_frames && ost->last_dropped) + (nb_frames > nb0_frames)) {
         if (nb_frames > dts_error_threshold * 30) {
             av_log(NULL, AV_LOG_ERROR, "%d frame duplication too large, skipping\n", nb_frames - 1);
-            nb_frames_drop++;
-            return;
+            atomic_fetch_add(&nb_frames_drop, 1);
+            return 0;
         }
-        nb_frames_dup += nb_frames - (nb0_frames && ost->last_dropped) - (nb_frames > nb0_frames);
+        dup  = nb_frames - (nb0_frames && ost->last_dropped) - (nb_frames > nb0_frames);
+        dup += atomic_fetch_add(&nb_frames_dup, dup);
         av_log(NULL, AV_LOG_VERBOSE, "*** %d dup!\n", nb_frames - 1);
-        if (nb_frames_dup > dup_warning) {
-            av_log(NULL, AV_LOG_WARNING, "More than %d frames duplicated\n", dup_warning);
-            dup_warning *= 10;
-        }
+        warning = atomic_load(&dup_warning);
+        if (dup > warning &&
+            atomic_compare_exchange_strong(&dup_warning, &warning, warning * 10))
+            av_log(NULL, AV_LOG_WARNING, "More than %u frames duplicated\n", warning);
     }
     ost->last_dropped = nb_frames == nb0_frames && next_picture;
 
@@ -1210,12 +1240,12 @@ static void do_video_out(OutputFile *of,
             in_picture = next_picture;
 
         if (!in_picture)
-            return;
+            return 0;
 
         in_picture->pts = ost->sync_opts;
 
         if (!check_recording_time(ost))
-            return;
+            return 0;
 
         if (enc->flags & (AV_CODEC_FLAG_INTERLACED_DCT | AV_CODEC_FLAG_INTERLACED_ME) &&
             ost->top_field_first >= 0)
@@ -1320,7 +1350,8 @@ static void do_video_out(OutputFile *of,
             }
 
             frame_size = pkt.size;
-            output_packet(of, &pkt, ost, 0);
+            if ((ret = output_packet(of, &pkt, ost, 0)) < 0)
+                return ret;
 
             /* if two pass, output log */
             if (ost->logfile && enc->stats_out) {
@@ -1347,10 +1378,10 @@ static void do_video_out(OutputFile *of,
     else
         av_frame_free(&ost->last_frame);
 
-    return;
+    return 0;
 error:
     av_log(NULL, AV_LOG_FATAL, "Video encoding failed\n");
-    exit_program(1);
+    return ret;
 }
 
 static double psnr(double d)
@@ -1416,6 +1447,251 @@ static void finish_output_stream(OutputStream *ost)
     }
 }
 
+/**
+ * Encode and mux a frame retrieved from the buffersink of an output stream.
+ *
+ * @param frame      filtered frame with its pts in the encoder time base,
+ *                   or NULL to flush the video frame rate conversion
+ * @param float_pts  higher precision version of frame->pts
+ * @return 0 on success, a negative error code if encoding or muxing failed
+ */
+static int encode_filtered_frame(OutputFile *of, OutputStream *ost,
+                                 AVFrame *frame, double float_pts)
+{
+    AVFilterContext *filter = ost->filter->filter;
+    AVCodecContext *enc = ost->enc_ctx;
+
+    if (!frame)
+        return do_video_out(of, ost, NULL, AV_NOPTS_VALUE);
+    if (ost->finished)
+        return 0;
+
+    switch (av_buffersink_get_type(filter)) {
+    case AVMEDIA_TYPE_VIDEO:
+        if (!ost->frame_aspect_ratio.num)
+            enc->sample_aspect_ratio = frame->sample_aspect_ratio;
+
+        if (debug_ts) {
+            av_log(NULL, AV_LOG_INFO, "filter -> pts:%s pts_time:%s exact:%f time_base:%d/%d\n",
+                    av_ts2str(frame->pts), av_ts2timestr(frame->pts, &enc->time_base),
+                    float_pts,
+                    enc->time_base.num, enc->time_base.den);
+        }
+
+        return do_video_out(of, ost, frame, float_pts);
+    case AVMEDIA_TYPE_AUDIO:
+        if (!(enc->codec->capabilities & AV_CODEC_CAP_PARAM_CHANGE) &&
+            enc->channels != frame->channels) {
+            av_log(NULL, AV_LOG_ERROR,
+                   "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
+            break;
+        }
+        return do_audio_out(of, ost, frame);
+    default:
+        // TODO support subtitle filters
+        av_assert0(0);
+    }
+    return 0;
+}
+
+#if HAVE_THREADS
+typedef struct OutputThreadJob {
+    OutputStream *ost;   /* NULL for a synchronization request */
+    AVFrame *frame;
+    double float_pts;
+} OutputThreadJob;
+
+static void free_output_thread_job(void *msg)
+{
+    OutputThreadJob *job = msg;
+    av_frame_free(&job->frame);
+}
+
+static void *output_thread(void *arg)
+{
+    OutputFile *of = arg;
+    OutputThreadJob job;
+    int ret;
+
+    while (av_thread_message_queue_recv(of->out_thread_queue, &job, 0) >= 0) {
+        if (!job.ost) {
+            if (av_thread_message_queue_send(of->out_thread_sync, &job, 0) < 0)
+                break;
+            continue;
+        }
+        ret = encode_filtered_frame(of, job.ost, job.frame, job.float_pts);
+        av_frame_free(&job.frame);
+        if (ret < 0) {
+            /* the main thread gets the error on its next message and exits,
+             * which stops and joins all the output threads */
+            av_thread_message_queue_set_err_send(of->out_thread_queue, ret);
+            av_thread_message_queue_set_err_recv(of->out_thread_sync, ret);
+            break;
+        }
+        /* publishes the state of the streams to sync_output_threads() */
+        atomic_fetch_add_explicit(&of->nb_jobs_done, 1, memory_order_release);
+    }
+
+    return NULL;
+}
+
+static void free_output_thread(int i)
+{
+    OutputFile *of = output_files[i];
+
+    if (!of || !of->out_thread_queue)
+        return;
+    av_thread_message_queue_set_err_recv(of->out_thread_queue, AVERROR_EOF);
+    av_thread_message_queue_set_err_send(of->out_thread_sync, AVERROR_EOF);
+    av_thread_message_flush(of->out_thread_queue);
+
+    pthread_join(of->thread, NULL);
+    av_thread_message_queue_free(&of->out_thread_queue);
+    av_thread_message_queue_free(&of->out_thread_sync);
+}
+
+static void free_output_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_files; i++)
+        free_output_thread(i);
+}
+
+static int init_output_thread(int i)
+{
+    int ret;
+    OutputFile *of = output_files[i];
+
+    ret = av_thread_message_queue_alloc(&of->out_thread_queue, 8,
+                                        sizeof(OutputThreadJob));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(of->out_thread_queue,
+                                          free_output_thread_job);
+
+    ret = av_thread_message_queue_alloc(&of->out_thread_sync, 1,
+                                        sizeof(OutputThreadJob));
+    if (ret < 0) {
+        av_thread_message_queue_free(&of->out_thread_queue);
+        return ret;
+    }
+
+    if ((ret = pthread_create(&of->thread, NULL, output_thread, of))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        av_thread_message_queue_free(&of->out_thread_queue);
+        av_thread_message_queue_free(&of->out_thread_sync);
+        return AVERROR(ret);
+    }
+
+    return 0;
+}
+
+/*
+ * Each output file gets its own thread running the encoders and the muxer,
+ * fed in order by the main thread. Output files do not share any state, so
+ * the output is identical to encoding everything on the main thread.
+ */
+static int init_output_threads(void)
+{
+    int i, ret;
+
+    if (!do_parallel_outputs || nb_output_files < 2)
+        return 0;
+    if (do_benchmark_all || vstats_filename) {
+        av_log(NULL, AV_LOG_WARNING, "-parallel_outputs is not supported "
+               "with -benchmark_all or -vstats, encoding on the main thread\n");
+        return 0;
+    }
+
+    for (i = 0; i < nb_output_files; i++) {
+        ret = init_output_thread(i);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static void send_output_sync(OutputFile *of)
+{
+    OutputThreadJob job = { NULL };
+
+    /* the thread is idle once it has processed every frame sent to it,
+     * and the acquire pairs with its release, so no round trip is needed */
+    if (atomic_load_explicit(&of->nb_jobs_done, memory_order_acquire) == of->nb_jobs_sent)
+        return;
+    if (av_thread_message_queue_send(of->out_thread_queue, &job, 0) < 0)
+        exit_program(1);
+    of->sync_pending = 1;
+}
+
+static void wait_output_sync(OutputFile *of)
+{
+    OutputThreadJob job;
+
+    if (of->sync_pending) {
+        if (av_thread_message_queue_recv(of->out_thread_sync, &job, 0) < 0)
+            exit_program(1);
+        of->sync_pending = 0;
+    }
+
+    if (of->mux_error_ost) {
+        main_return_code = 1;
+        close_all_output_streams(of->mux_error_ost,
+                                 MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
+        of->mux_error_ost = NULL;
+    }
+}
+#endif
+
+/* Wait until the thread of the given output file, or of all output files if
+ * NULL, has processed all the frames sent to it. */
+static void sync_output_threads(OutputFile *of)
+{
+#if HAVE_THREADS
+    int i;
+
+    if (of) {
+        if (of->out_thread_queue) {
+            send_output_sync(of);
+            wait_output_sync(of);
+        }
+        return;
+    }
+
+    for (i = 0; i < nb_output_files; i++)
+        if (output_files[i]->out_thread_queue)
+            send_output_sync(output_files[i]);
+    for (i = 0; i < nb_output_files; i++)
+        if (output_files[i]->out_thread_queue)
+            wait_output_sync(output_files[i]);
+#endif
+}
+
+static void submit_filtered_frame(OutputFile *of, OutputStream *ost,
+                                  AVFrame *frame, double float_pts)
+{
+#if HAVE_THREADS
+    if (of->out_thread_queue) {
+        OutputThreadJob job = { ost, NULL, float_pts };
+
+        if (frame) {
+            if (!(job.frame = av_frame_alloc()))
+                exit_program(1);
+            av_frame_move_ref(job.frame, frame);
+        }
+        if (av_thread_message_queue_send(of->out_thread_queue, &job, 0) < 0) {
+            av_frame_free(&job.frame);
+            exit_program(1);
+        }
+        of->nb_jobs_sent++;
+        return;
+    }
+#endif
+    if (encode_filtered_frame(of, ost, frame, float_pts) < 0)
+        exit_program(1);
+}
+
 /**
  * Get and encode new output from any of the filtergraphs, without causing
  * activity.
@@ -1441,6 +1717,7 @@ static int reap_filters(int flush)
 
         if (!ost->initialized) {
             char error[1024] = "";
+            sync_output_threads(of);
             ret = init_output_stream(ost, error, sizeof(error));
             if (ret < 0) {
                 av_log(NULL, AV_LOG_ERROR, "Error initializing output stream %d:%d -- %s\n",
@@ -1464,14 +1741,10 @@ static int reap_filters(int flush)
                            "Error in av_buffersink_get_frame_flags(): %s\n", av_err2str(ret));
                 } else if (flush && ret == AVERROR_EOF) {
                     if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_VIDEO)
-                        do_video_out(of, ost, NULL, AV_NOPTS_VALUE);
+                        submit_filtered_frame(of, ost, NULL, AV_NOPTS_VALUE);
                 }
                 break;
             }
-            if (ost->finished) {
-                av_frame_unref(filtered_frame);
-                continue;
-            }
             if (filtered_frame->pts != AV_NOPTS_VALUE) {
                 int64_t start_time = (of->start_time == AV_NOPTS_VALUE) ? 0 : of->start_time;
                 AVRational filter_tb = av_buffersink_get_time_base(filter);
@@ -1491,38 +1764,14 @@ static int reap_filters(int flush)
                     av_rescale_q(start_time, AV_TIME_BASE_Q, enc->time_base);
             }
 
-            switch (av_buffersink_get_type(filter)) {
-            case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
-                    enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
-
-                if (debug_ts) {
-                    av_log(NULL, AV_LOG_INFO, "filter -> pts:%s pts_time:%s exact:%f time_base:%d/%d\n",
-                            av_ts2str(filtered_frame->pts), av_ts2timestr(filtered_frame->pts, &enc->time_base),
-                            float_pts,
-                            enc->time_base.num, enc->time_base.den);
-                }
-
-                do_video_out(of, ost, filtered_frame, float_pts);
-                break;
-            case AVMEDIA_TYPE_AUDIO:
-                if (!(enc->codec->capabilities & AV_CODEC_CAP_PARAM_CHANGE) &&
-                    enc->channels != filtered_frame->channels) {
-                    av_log(NULL, AV_LOG_ERROR,
-                           "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
-                    break;
-                }
-                do_audio_out(of, ost, filtered_frame);
-                break;
-            default:
-                // TODO support subtitle filters
-                av_assert0(0);
-            }
-
+            submit_filtered_frame(of, ost, filtered_frame, float_pts);
             av_frame_unref(filtered_frame);
         }
     }
 
+    /* the main thread must see the state the encoders left the streams in */
+    sync_output_threads(NULL);
+
     return 0;
 }
 
@@ -1598,11 +1847,15 @@ static void print_final_stats(int64_t total_size)
 
         av_log(NULL, AV_LOG_VERBOSE, "  Total: %"PRIu64" packets (%"PRIu64" bytes) demuxed\n",
                total_packets, total_size);
+        av_log(NULL, AV_LOG_VERBOSE, "  %"PRId64" bytes copied (%.1f per packet)\n",
+               f->ctx->copied_bytes,
+               total_packets ? (double)f->ctx->copied_bytes / total_packets : 0.0);
     }
 
     for (i = 0; i < nb_output_files; i++) {
         OutputFile *of = output_files[i];
         uint64_t total_packets = 0, total_size = 0;
+        uint64_t copied_size = of->ctx->copied_bytes;
 
         av_log(NULL, AV_LOG_VERBOSE, "Output file #%d (%s):\n",
                i, of->ctx->url);
@@ -1613,6 +1866,7 @@ static void print_final_stats(int64_t total_size)
 
             total_size    += ost->data_size;
             total_packets += ost->packets_written;
+            copied_size   += ost->copied_size;
 
             av_log(NULL, AV_LOG_VERBOSE, "  Output stream #%d:%d (%s): ",
                    i, j, media_type_string(type));
@@ -1632,6 +1886,9 @@ static void print_final_stats(int64_t total_size)
 
         av_log(NULL, AV_LOG_VERBOSE, "  Total: %"PRIu64" packets (%"PRIu64" bytes) muxed\n",
                total_packets, total_size);
+        av_log(NULL, AV_LOG_VERBOSE, "  %"PRIu64" bytes copied (%.1f per packet)\n",
+               copied_size,
+               total_packets ? (double)copied_size / total_packets : 0.0);
     }
     if(video_size + data_size + audio_size + subtitle_size + extra_size == 0){
         av_log(NULL, AV_LOG_WARNING, "Output file is empty, nothing was encoded ");
@@ -1650,7 +1907,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     AVFormatContext *oc;
     int64_t total_size;
     AVCodecContext *enc;
-    int frame_number, vid, i;
+    int frame_number, vid, i, nb_dup, nb_drop;
     double bitrate;
     double speed;
     int64_t pts = INT64_MIN + 1;
@@ -1756,7 +2013,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
             pts = FFMAX(pts, av_rescale_q(av_stream_get_end_pts(ost->st),
                                           ost->st->time_base, AV_TIME_BASE_Q));
         if (is_last_report)
-            nb_frames_drop += ost->last_dropped;
+            atomic_fetch_add(&nb_frames_drop, ost->last_dropped);
     }
 
     secs = FFABS(pts) / AV_TIME_BASE;
@@ -1800,10 +2057,12 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
                    hours_sign, hours, mins, secs, us);
     }
 
-    if (nb_frames_dup || nb_frames_drop)
-        av_bprintf(&buf, " dup=%d drop=%d", nb_frames_dup, nb_frames_drop);
-    av_bprintf(&buf_script, "dup_frames=%d\n", nb_frames_dup);
-    av_bprintf(&buf_script, "drop_frames=%d\n", nb_frames_drop);
+    nb_dup  = atomic_load(&nb_frames_dup);
+    nb_drop = atomic_load(&nb_frames_drop);
+    if (nb_dup || nb_drop)
+        av_bprintf(&buf, " dup=%d drop=%d", nb_dup, nb_drop);
+    av_bprintf(&buf_script, "dup_frames=%d\n", nb_dup);
+    av_bprintf(&buf_script, "drop_frames=%d\n", nb_drop);
 
     if (speed < 0) {
         av_bprintf(&buf, " speed=N/A");
@@ -1954,7 +2213,8 @@ static void flush_encoders(void)
                 fprintf(ost->logfile, "%s", enc->stats_out);
             }
             if (ret == AVERROR_EOF) {
-                output_packet(of, &pkt, ost, 1);
+                if (output_packet(of, &pkt, ost, 1) < 0)
+                    exit_program(1);
                 break;
             }
             if (ost->finished & MUXER_FINISHED) {
@@ -1963,7 +2223,8 @@ static void flush_encoders(void)
             }
             av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
             pkt_size = pkt.size;
-            output_packet(of, &pkt, ost, 0);
+            if (output_packet(of, &pkt, ost, 0) < 0)
+                exit_program(1);
             if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename) {
                 do_video_stats(ost, pkt_size);
             }
@@ -2004,7 +2265,8 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
         av_init_packet(&opkt);
         opkt.data = NULL;
         opkt.size = 0;
-        output_packet(of, &opkt, ost, 1);
+        if (output_packet(of, &opkt, ost, 1) < 0)
+            exit_program(1);
         return;
     }
 
@@ -2065,7 +2327,8 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
 
     opkt.duration = av_rescale_q(pkt->duration, ist->st->time_base, ost->mux_timebase);
 
-    output_packet(of, &opkt, ost, 0);
+    if (output_packet(of, &opkt, ost, 0) < 0)
+        exit_program(1);
 }
 
 int guess_input_channel_layout(InputStream *ist)
@@ -2999,7 +3262,9 @@ static int check_init_output_file(OutputFile *of, int file_index)
         while (av_fifo_size(ost->muxing_queue)) {
             AVPacket pkt;
             av_fifo_generic_read(ost->muxing_queue, &pkt, sizeof(pkt), NULL);
-            write_packet(of, &pkt, ost, 1);
+            ret = write_packet(of, &pkt, ost, 1);
+            if (ret < 0)
+                return ret;
         }
     }
 
@@ -4664,6 +4929,8 @@ static int transcode(void)
 #if HAVE_THREADS
     if ((ret = init_input_threads()) < 0)
         goto fail;
+    if ((ret = init_output_threads()) < 0)
+        goto fail;
 #endif
 
     while (!received_sigterm) {
@@ -4691,6 +4958,7 @@ static int transcode(void)
     }
 #if HAVE_THREADS
     free_input_threads();
+    free_output_threads();
 #endif
 
     /* at the end of stream, we must flush the decoder buffers */
@@ -4757,6 +5025,7 @@ static int transcode(void)
  fail:
 #if HAVE_THREADS
     free_input_threads();
+    free_output_threads();
 #endif
 
     if (output_streams) {
@@ -21,6 +21,7 @@
 
 #include "config.h"
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <signal.h>
@@ -532,6 +533,8 @@ typedef struct OutputStream {
     uint64_t data_size;
     // number of packets send to the muxer
     uint64_t packets_written;
+    // size of the packets rewritten into new buffers by bitstream filters
+    uint64_t copied_size;
     // number of frames/samples sent to the encoder
     uint64_t frames_encoded;
     uint64_t samples_encoded;
@@ -562,6 +565,18 @@ typedef struct OutputFile {
     int shortest;
 
     int header_written;
+
+#if HAVE_THREADS
+    AVThreadMessageQueue *out_thread_queue; /* filtered frames to encode, see -parallel_outputs */
+    AVThreadMessageQueue *out_thread_sync;  /* synchronization replies from the thread */
+    pthread_t thread;           /* thread encoding and muxing this file */
+    int nb_jobs_sent;           /* frames sent to the thread, main thread only */
+    atomic_int nb_jobs_done;    /* frames processed by the thread, stored with release */
+    int sync_pending;           /* a synchronization request awaits its reply */
+    /* stream on which muxing failed on the thread, the other output files are
+     * closed by the main thread once all output threads are idle */
+    struct OutputStream *mux_error_ost;
+#endif
 } OutputFile;
 
 extern InputStream **input_streams;
@@ -590,6 +605,7 @@ extern int video_sync_method;
 extern float frame_drop_threshold;
 extern int do_benchmark;
 extern int do_benchmark_all;
+extern int do_parallel_outputs;
 extern int do_deinterlace;
 extern int do_hex_dump;
 extern int do_pkt_dump;
@@ -609,6 +625,7 @@ extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern char *filter_thread_type;
 extern int vstats_version;
 
 extern const AVIOInterruptCB int_cb;
@@ -1052,6 +1052,13 @@ int configure_filtergraph(FilterGraph *fg)
         fg->graph->nb_threads = filter_complex_nbthreads;
     }
 
+    if (filter_thread_type &&
+        (ret = av_opt_set(fg->graph, "thread_type", filter_thread_type, 0)) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Invalid filter thread type '%s'\n",
+               filter_thread_type);
+        goto fail;
+    }
+
     if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
         goto fail;
 
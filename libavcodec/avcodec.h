@@ -3433,6 +3433,18 @@ typedef struct AVCodecContext {
      * - encoding: set by user
      */
     int export_side_data;
+
+    /**
+     * A reference to the AVExecutorContext whose worker threads run the
+     * jobs of slice threading, instead of the pool shared by the process.
+     * Frame threads are still owned by the codec context, but get the
+     * priority and CPU affinity of the executor. The reference is set by the
+     * caller and afterwards owned (and freed) by libavcodec.
+     *
+     * - decoding: set by user before avcodec_open2()
+     * - encoding: set by user before avcodec_open2()
+     */
+    AVBufferRef *executor;
 } AVCodecContext;
 
 #if FF_API_CODEC_GET_SET
@@ -4472,6 +4484,7 @@ int av_new_packet(AVPacket *pkt, int size);
 
 /**
  * Reduce packet size, correctly zeroing padding
+ * The padding is left untouched if the packet data is not writable.
  *
  * @param pkt packet
  * @param size new size
@@ -4480,6 +4493,7 @@ void av_shrink_packet(AVPacket *pkt, int size);
 
 /**
  * Increase packet size, correctly zeroing padding
+ * If the packet data is not writable, it is copied to a new buffer first.
  *
  * @param pkt packet
  * @param grow_by number of bytes by which to increase the size of the packet
@@ -103,7 +103,9 @@ void av_shrink_packet(AVPacket *pkt, int size)
     if (pkt->size <= size)
         return;
     pkt->size = size;
-    memset(pkt->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    /* the bytes after a shared packet may belong to someone else */
+    if (!pkt->buf || av_buffer_is_writable(pkt->buf))
+        memset(pkt->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
 }
 
 int av_grow_packet(AVPacket *pkt, int grow_by)
@@ -115,7 +117,17 @@ int av_grow_packet(AVPacket *pkt, int grow_by)
         return AVERROR(ENOMEM);
 
     new_size = pkt->size + grow_by + AV_INPUT_BUFFER_PADDING_SIZE;
-    if (pkt->buf) {
+    if (pkt->buf && !av_buffer_is_writable(pkt->buf)) {
+        /* the data may be shared, e.g. with the demuxer I/O buffer */
+        AVBufferRef *buf = av_buffer_alloc(new_size);
+        if (!buf)
+            return AVERROR(ENOMEM);
+        if (pkt->size > 0)
+            memcpy(buf->data, pkt->data, pkt->size);
+        av_buffer_unref(&pkt->buf);
+        pkt->buf  = buf;
+        pkt->data = buf->data;
+    } else if (pkt->buf) {
         size_t data_offset;
         uint8_t *old_data = pkt->data;
         if (pkt->data == NULL) {
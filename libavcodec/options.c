@@ -204,6 +204,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     av_freep(&avctx->subtitle_header);
     av_buffer_unref(&avctx->hw_frames_ctx);
     av_buffer_unref(&avctx->hw_device_ctx);
+    av_buffer_unref(&avctx->executor);
     for (i = 0; i < avctx->nb_coded_side_data; i++)
         av_freep(&avctx->coded_side_data[i].data);
     av_freep(&avctx->coded_side_data);
@@ -256,6 +257,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     dest->subtitle_header = NULL;
     dest->hw_frames_ctx   = NULL;
     dest->hw_device_ctx   = NULL;
+    dest->executor        = NULL;
     dest->nb_coded_side_data = 0;
 
 #define alloc_and_copy_or_fail(obj, size, pad) \
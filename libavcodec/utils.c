@@ -1150,6 +1150,7 @@ av_cold int avcodec_close(AVCodecContext *avctx)
 
     av_buffer_unref(&avctx->hw_frames_ctx);
     av_buffer_unref(&avctx->hw_device_ctx);
+    av_buffer_unref(&avctx->executor);
 
     if (avctx->priv_data && avctx->codec && avctx->codec->priv_class)
         av_opt_free(avctx->priv_data);
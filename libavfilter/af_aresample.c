@@ -350,4 +350,5 @@ AVFilter ff_af_aresample = {
     .priv_class    = &aresample_class,
     .inputs        = aresample_inputs,
     .outputs       = aresample_outputs,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
@@ -493,4 +493,5 @@ AVFilter ff_af_volume = {
     .outputs        = avfilter_af_volume_outputs,
     .flags          = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
     .process_command = process_command,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
@@ -332,6 +332,16 @@ typedef struct AVFilter {
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Activate independent filters of the graph concurrently, e.g. the branches
+ * after a split filter or the distant stages of a long filter chain. Only
+ * filters which support it are activated concurrently.
+ *
+ * This must be set in AVFilterGraph.thread_type before adding any filter to
+ * the graph, and is not supported with a user-provided AVFilterGraph.execute.
+ */
+#define AVFILTER_THREAD_GRAPH (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
@@ -907,6 +917,14 @@ typedef struct AVFilterGraph {
     int sink_links_count;
 
     unsigned disable_auto_convert;
+
+    /**
+     * A reference to the AVExecutorContext whose worker threads run the
+     * threaded work of this graph, instead of the pool shared by the process.
+     * Set by the caller before adding any filters to the graph, and
+     * afterwards owned (and freed) by libavfilter.
+     */
+    AVBufferRef *executor;
 } AVFilterGraph;
 
 /**
@@ -50,6 +50,7 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "graph", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_GRAPH }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, F|V|A },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
@@ -126,6 +127,7 @@ void avfilter_graph_free(AVFilterGraph **graph)
         avfilter_free((*graph)->filters[0]);
 
     ff_graph_thread_free(*graph);
+    av_buffer_unref(&(*graph)->executor);
 
     av_freep(&(*graph)->sink_links);
 
@@ -1453,5 +1455,7 @@ int ff_filter_graph_run_once(AVFilterGraph *graph)
             filter = graph->filters[i];
     if (!filter->ready)
         return AVERROR(EAGAIN);
+    if (filter->thread_type & AVFILTER_THREAD_GRAPH)
+        return graph->internal->thread_activate(graph, filter);
     return ff_filter_activate(filter);
 }
@@ -321,6 +321,7 @@ AVFilter ff_vsink_buffer = {
     .activate      = activate,
     .inputs        = avfilter_vsink_buffer_inputs,
     .outputs       = NULL,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
 
 static const AVFilterPad avfilter_asink_abuffer_inputs[] = {
@@ -341,4 +342,5 @@ AVFilter ff_asink_abuffer = {
     .activate      = activate,
     .inputs        = avfilter_asink_abuffer_inputs,
     .outputs       = NULL,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
@@ -472,6 +472,7 @@ AVFilter ff_vsrc_buffer = {
     .inputs    = NULL,
     .outputs   = avfilter_vsrc_buffer_outputs,
     .priv_class = &buffer_class,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
 
 static const AVFilterPad avfilter_asrc_abuffer_outputs[] = {
@@ -496,4 +497,5 @@ AVFilter ff_asrc_abuffer = {
     .inputs    = NULL,
     .outputs   = avfilter_asrc_abuffer_outputs,
     .priv_class = &abuffer_class,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
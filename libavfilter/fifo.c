@@ -278,6 +278,7 @@ AVFilter ff_vf_fifo = {
     .priv_size   = sizeof(FifoContext),
     .inputs      = avfilter_vf_fifo_inputs,
     .outputs     = avfilter_vf_fifo_outputs,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
 
 static const AVFilterPad avfilter_af_afifo_inputs[] = {
@@ -306,4 +307,5 @@ AVFilter ff_af_afifo = {
     .priv_size   = sizeof(FifoContext),
     .inputs      = avfilter_af_afifo_inputs,
     .outputs     = avfilter_af_afifo_outputs,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
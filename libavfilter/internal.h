@@ -137,11 +137,19 @@ struct AVFilterPad {
 struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
+    /**
+     * Activate the given filter, and possibly other ready filters
+     * concurrently with it. Set if AVFILTER_THREAD_GRAPH is enabled.
+     */
+    int (*thread_activate)(AVFilterGraph *graph, AVFilterContext *filter);
     FFFrameQueueGlobal frame_queues;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+    /* generation of the last concurrent activation batch which included
+     * this filter or one of its neighbours, see pthread.c */
+    unsigned claim_generation;
 };
 
 /**
@@ -364,6 +372,13 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The filter only accesses its own state and its links during activation,
+ * so it can be activated concurrently with filters that are not its
+ * neighbours and share no neighbour with it (see AVFILTER_THREAD_GRAPH).
+ */
+#define FF_FILTER_FLAG_GRAPH_THREADS (1 << 1)
+
 /**
  * Run one round of processing on a filter graph.
  */
@@ -42,6 +42,14 @@ typedef struct ThreadContext {
     AVFilterContext *ctx;
     void *arg;
     int   *rets;
+
+    /* concurrent filter activation, see AVFILTER_THREAD_GRAPH */
+    AVSliceThread *graph_thread;
+    /* the slice threads can only run one filter at a time */
+    pthread_mutex_t execute_lock;
+    unsigned claim_generation;
+    AVFilterContext **active;
+    int              *active_rets;
 } ThreadContext;
 
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
@@ -52,8 +60,20 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
         c->rets[jobnr] = ret;
 }
 
+static void activate_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    ThreadContext *c = priv;
+    c->active_rets[jobnr] = ff_filter_activate(c->active[jobnr]);
+}
+
 static void slice_thread_uninit(ThreadContext *c)
 {
+    if (c->graph_thread) {
+        avpriv_slicethread_free(&c->graph_thread);
+        pthread_mutex_destroy(&c->execute_lock);
+    }
+    av_freep(&c->active);
+    av_freep(&c->active_rets);
     avpriv_slicethread_free(&c->thread);
 }
 
@@ -64,18 +84,100 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+    if (c->graph_thread)
+        pthread_mutex_lock(&c->execute_lock);
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    if (c->graph_thread)
+        pthread_mutex_unlock(&c->execute_lock);
+    return 0;
+}
+
+/*
+ * Activating a filter touches its links, the ready state of its neighbours
+ * and the output links of the filters it sends frames to. Two filters can
+ * thus run concurrently if they are not neighbours and share no neighbour.
+ */
+static int neighbourhood_claimed(AVFilterContext *filter, unsigned generation)
+{
+    unsigned i;
+
+    if (filter->internal->claim_generation == generation)
+        return 1;
+    for (i = 0; i < filter->nb_inputs; i++)
+        if (filter->inputs[i]->src->internal->claim_generation == generation)
+            return 1;
+    for (i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i]->dst->internal->claim_generation == generation)
+            return 1;
+    return 0;
+}
+
+static void claim_neighbourhood(AVFilterContext *filter, unsigned generation)
+{
+    unsigned i;
+
+    filter->internal->claim_generation = generation;
+    for (i = 0; i < filter->nb_inputs; i++)
+        filter->inputs[i]->src->internal->claim_generation = generation;
+    for (i = 0; i < filter->nb_outputs; i++)
+        filter->outputs[i]->dst->internal->claim_generation = generation;
+}
+
+static int thread_activate(AVFilterGraph *graph, AVFilterContext *filter)
+{
+    ThreadContext *c = graph->internal->thread;
+    unsigned generation = ++c->claim_generation;
+    int i, nb_active = 1;
+
+    c->active[0] = filter;
+    claim_neighbourhood(filter, generation);
+    for (i = 0; i < graph->nb_filters && nb_active < graph->nb_threads; i++) {
+        AVFilterContext *f = graph->filters[i];
+        if (!f->ready || !(f->thread_type & AVFILTER_THREAD_GRAPH) ||
+            neighbourhood_claimed(f, generation))
+            continue;
+        c->active[nb_active++] = f;
+        claim_neighbourhood(f, generation);
+    }
+
+    if (nb_active == 1)
+        return ff_filter_activate(filter);
+
+    avpriv_slicethread_execute(c->graph_thread, nb_active, 0);
+    for (i = 0; i < nb_active; i++)
+        if (c->active_rets[i] < 0)
+            return c->active_rets[i];
+    return 0;
+}
+
+static int graph_thread_init(ThreadContext *c, int nb_threads)
+{
+    int ret;
+
+    if (!(c->active      = av_calloc(nb_threads, sizeof(*c->active))) ||
+        !(c->active_rets = av_calloc(nb_threads, sizeof(*c->active_rets))))
+        return AVERROR(ENOMEM);
+
+    ret = avpriv_slicethread_create2(&c->graph_thread, c, activate_func, NULL,
+                                     nb_threads, c->graph->executor);
+    if (ret < 0)
+        return ret;
+    if ((ret = pthread_mutex_init(&c->execute_lock, NULL))) {
+        avpriv_slicethread_free(&c->graph_thread);
+        return AVERROR(ret);
+    }
     return 0;
 }
 
 static int thread_init_internal(ThreadContext *c, int nb_threads)
 {
-    nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
+    nb_threads = avpriv_slicethread_create2(&c->thread, c, worker_func, NULL,
+                                            nb_threads, c->graph->executor);
     if (nb_threads <= 1)
         avpriv_slicethread_free(&c->thread);
     return FFMAX(nb_threads, 1);
@@ -93,6 +195,7 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->internal->thread = av_mallocz(sizeof(ThreadContext));
     if (!graph->internal->thread)
         return AVERROR(ENOMEM);
+    ((ThreadContext*)graph->internal->thread)->graph = graph;
 
     ret = thread_init_internal(graph->internal->thread, graph->nb_threads);
     if (ret <= 1) {
@@ -103,6 +206,17 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     }
     graph->nb_threads = ret;
 
+    if (graph->thread_type & AVFILTER_THREAD_GRAPH) {
+        ret = graph_thread_init(graph->internal->thread, graph->nb_threads);
+        if (ret < 0) {
+            ff_graph_thread_free(graph);
+            graph->thread_type = 0;
+            graph->nb_threads  = 1;
+            return ret;
+        }
+        graph->internal->thread_activate = thread_activate;
+    }
+
     graph->internal->thread_execute = thread_execute;
 
     return 0;
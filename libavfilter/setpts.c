@@ -305,6 +305,7 @@ AVFilter ff_vf_setpts = {
 
     .inputs    = avfilter_vf_setpts_inputs,
     .outputs   = avfilter_vf_setpts_outputs,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
 #endif /* CONFIG_SETPTS_FILTER */
 
@@ -340,5 +341,6 @@ AVFilter ff_af_asetpts = {
     .priv_class  = &asetpts_class,
     .inputs      = asetpts_inputs,
     .outputs     = asetpts_outputs,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
 #endif /* CONFIG_ASETPTS_FILTER */
@@ -215,6 +215,7 @@ AVFilter ff_vf_trim = {
     .priv_class  = &trim_class,
     .inputs      = trim_inputs,
     .outputs     = trim_outputs,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
 #endif // CONFIG_TRIM_FILTER
 
@@ -370,5 +371,6 @@ AVFilter ff_af_atrim = {
     .priv_class  = &atrim_class,
     .inputs      = atrim_inputs,
     .outputs     = atrim_outputs,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
 #endif // CONFIG_ATRIM_FILTER
@@ -415,4 +415,5 @@ AVFilter ff_vf_crop = {
     .inputs          = avfilter_vf_crop_inputs,
     .outputs         = avfilter_vf_crop_outputs,
     .process_command = process_command,
+    .flags_internal  = FF_FILTER_FLAG_GRAPH_THREADS,
 };
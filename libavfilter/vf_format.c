@@ -180,6 +180,7 @@ AVFilter ff_vf_format = {
 
     .inputs        = avfilter_vf_format_inputs,
     .outputs       = avfilter_vf_format_outputs,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
 #endif /* CONFIG_FORMAT_FILTER */
 
@@ -219,5 +220,6 @@ AVFilter ff_vf_noformat = {
 
     .inputs        = avfilter_vf_noformat_inputs,
     .outputs       = avfilter_vf_noformat_outputs,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
 #endif /* CONFIG_NOFORMAT_FILTER */
@@ -353,4 +353,5 @@ AVFilter ff_vf_fps = {
     .activate    = activate,
     .inputs      = avfilter_vf_fps_inputs,
     .outputs     = avfilter_vf_fps_outputs,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
@@ -461,4 +461,5 @@ AVFilter ff_vf_pad = {
     .query_formats = query_formats,
     .inputs        = avfilter_vf_pad_inputs,
     .outputs       = avfilter_vf_pad_outputs,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
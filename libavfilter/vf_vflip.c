@@ -118,4 +118,5 @@ AVFilter ff_vf_vflip = {
     .inputs      = avfilter_vf_vflip_inputs,
     .outputs     = avfilter_vf_vflip_outputs,
     .flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_THREADS,
 };
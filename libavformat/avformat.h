@@ -695,6 +695,11 @@ typedef struct AVInputFormat {
      */
     int priv_data_size;
 
+    /**
+     * Internal flags. See FF_FMT_FLAG_* in internal.h.
+     */
+    int flags_internal;
+
     /**
      * Tell if a given file has a chance of being parsed as this format.
      * The buffer provided is guaranteed to be AVPROBE_PADDING_SIZE bytes
@@ -1500,6 +1505,20 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_FAST_SEEK   0x80000 ///< Enable fast, but inaccurate seeks for some formats
 #define AVFMT_FLAG_SHORTEST   0x100000 ///< Stop muxing when the shortest stream stops.
 #define AVFMT_FLAG_AUTO_BSF   0x200000 ///< Add bitstream filters as requested by the muxer
+/**
+ * Return packets pointing into the I/O buffer instead of copying them out of
+ * it, where the demuxer allows. The padding of such packets is not zeroed and
+ * the demuxer may not modify them in place, so this is meant for stream copy.
+ * Has no effect with custom I/O.
+ */
+#define AVFMT_FLAG_ZERO_COPY  0x400000
+/**
+ * Stop analyzing the streams in avformat_find_stream_info() as soon as the
+ * parameters of all known streams are found, without reading more frames to
+ * estimate frame rates or looking for further streams in formats without a
+ * header.
+ */
+#define AVFMT_FLAG_FAST_PROBE 0x800000
 
     /**
      * Maximum size of the data read from input for determining
@@ -1921,6 +1940,11 @@ typedef struct AVFormatContext {
      * additional internal format contexts. Thus the AVFormatContext pointer
      * passed to this callback may be different from the one facing the caller.
      * It will, however, have the same 'opaque' field.
+     *
+     * @note Some muxers and demuxers can open and close IO streams from
+     * background threads, e.g. to prefetch or upload segments. They only do
+     * so with the default io_open and io_close callbacks, so custom callbacks
+     * are always called from the thread calling into libavformat.
      */
     int (*io_open)(struct AVFormatContext *s, AVIOContext **pb, const char *url,
                    int flags, AVDictionary **options);
@@ -1957,6 +1981,34 @@ typedef struct AVFormatContext {
      * - decoding: set by user
      */
     int max_probe_packets;
+
+    /**
+     * Number of packet payload bytes copied into buffers of their own, i.e.
+     * not referenced from the I/O buffer or passed through unchanged.
+     * - demuxing: set by libavformat
+     * - muxing: set by libavformat
+     */
+    int64_t copied_bytes;
+
+    /**
+     * Path of a sidecar file caching the index entries of all streams.
+     * The entries are loaded before the first seek, if the file was written
+     * for the same input, and written back when closing the input, if the
+     * index grew. Only demuxers whose index is used for seeking alone use it.
+     * - muxing: unused
+     * - demuxing: set by user
+     */
+    char *index_cache;
+
+    /**
+     * Number of threads decoding the streams in avformat_find_stream_info().
+     * With more than one, the packets read are decoded in batches, with
+     * different streams decoded in parallel; this may read slightly more of
+     * the input than decoding each packet as it is read.
+     * - muxing: unused
+     * - demuxing: set by user
+     */
+    int probe_threads;
 } AVFormatContext;
 
 #if FF_API_FORMAT_GET_SET
@@ -653,6 +653,13 @@ int ffurl_get_short_seek(URLContext *h)
     return h->prot->url_get_short_seek(h);
 }
 
+int ffurl_get_mapping(URLContext *h, AVBufferRef **buf)
+{
+    if (!h || !h->prot || !h->prot->url_get_mapping)
+        return AVERROR(ENOSYS);
+    return h->prot->url_get_mapping(h, buf);
+}
+
 int ffurl_shutdown(URLContext *h, int flags)
 {
     if (!h || !h->prot || !h->prot->url_shutdown)
@@ -349,6 +349,32 @@ typedef struct AVIOContext {
      * Try to buffer at least this amount of data before flushing it
      */
     int min_packet_size;
+
+    /**
+     * Reference owning buffer, set when packets may point into it.
+     * Internal, not meant to be used from outside of AVIOContext.
+     */
+    struct AVBufferRef *buffer_ref;
+
+    /**
+     * The buffer maps the whole resource and is never refilled.
+     * Internal, not meant to be used from outside of AVIOContext.
+     */
+    int mapped;
+
+    /**
+     * Packets may point into the buffer, set by ffio_enable_buffer_refs().
+     * Internal, not meant to be used from outside of AVIOContext.
+     */
+    int buffer_refs;
+
+    /**
+     * Read ahead into a second buffer from a background thread, set by the
+     * "async_read" option.
+     * Internal, not meant to be used from outside of AVIOContext.
+     */
+    int async_read;
+    struct AVIOAsync *async;
 } AVIOContext;
 
 /**
@@ -22,6 +22,9 @@
 #include "avio.h"
 #include "url.h"
 
+#include "libavcodec/avcodec.h"
+
+#include "libavutil/buffer.h"
 #include "libavutil/log.h"
 
 extern const AVClass ff_avio_class;
@@ -106,6 +109,32 @@ int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size);
 
 int ffio_limit(AVIOContext *s, int size);
 
+/**
+ * Switch a read-only AVIOContext owned by libavformat to a refcounted
+ * buffer, so that ffio_read_ref() can return packets pointing into it.
+ * A mapped buffer is used as is.
+ * Parts of the buffer still referenced by packets are never overwritten,
+ * a new buffer is allocated instead.
+ *
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int ffio_enable_buffer_refs(AVIOContext *s);
+
+/**
+ * Read size bytes into pkt without copying them out of the I/O buffer.
+ * The padding of the returned packet is not guaranteed to be zeroed.
+ *
+ * @return the number of bytes read, 0 if the data cannot be returned this
+ *         way and the caller should fall back to a copying read, or a
+ *         negative AVERROR on failure
+ */
+int ffio_read_ref(AVIOContext *s, AVPacket *pkt, int size);
+
+/**
+ * @return 1 if buf was returned by ffio_read_ref() on s, 0 otherwise
+ */
+int ffio_is_buffer_ref(AVIOContext *s, const AVBufferRef *buf);
+
 void ffio_init_checksum(AVIOContext *s,
                         unsigned long (*update_checksum)(unsigned long c, const uint8_t *p, unsigned int len),
                         unsigned long checksum);
@@ -144,6 +173,10 @@ int ffio_fdopen(AVIOContext **s, URLContext *h);
 /**
  * Return the URLContext associated with the AVIOContext
  *
+ * Since the caller may reposition the URLContext, data read ahead by the
+ * async_read option is dropped, so the AVIOContext must not be read from
+ * again unless the URLContext is repositioned or a new request is made.
+ *
  * @param s IO context
  * @return pointer to URLContext or NULL.
  */
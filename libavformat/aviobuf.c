@@ -26,6 +26,7 @@
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/avassert.h"
+#include "libavutil/thread.h"
 #include "avformat.h"
 #include "avio.h"
 #include "avio_internal.h"
@@ -42,6 +43,303 @@
  */
 #define SHORT_SEEK_THRESHOLD 4096
 
+/**
+ * Allocate a padded buffer owned by a reference tagged with s, so that
+ * packets pointing into it can be recognized.
+ */
+static uint8_t *buffer_alloc_ref(AVIOContext *s, int size, AVBufferRef **ref)
+{
+    uint8_t *buf = av_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!buf)
+        return NULL;
+    memset(buf + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    *ref = av_buffer_create(buf, size + AV_INPUT_BUFFER_PADDING_SIZE,
+                            av_buffer_default_free, s, 0);
+    if (!*ref) {
+        av_free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+static uint8_t *buffer_alloc(AVIOContext *s, int size, AVBufferRef **ref)
+{
+    *ref = NULL;
+    if (!s->buffer_ref)
+        return av_malloc(size);
+    return buffer_alloc_ref(s, size, ref);
+}
+
+static void buffer_replace(AVIOContext *s, uint8_t *buf, AVBufferRef *ref)
+{
+    if (s->buffer_ref)
+        av_buffer_unref(&s->buffer_ref);
+    else
+        av_free(s->buffer);
+    s->buffer     = buf;
+    s->buffer_ref = ref;
+}
+
+/**
+ * Read-ahead state: a spare buffer which a worker thread fills with the
+ * next read_packet() result while the current buffer is being parsed.
+ * The worker is the only user of opaque while a read is in flight, so
+ * everything else touching opaque waits for it first. Data read ahead is
+ * dropped when opaque may have been repositioned: after a seek, a
+ * time-based seek, or when opaque is handed out by ffio_geturlcontext().
+ */
+typedef struct AVIOAsync {
+#if HAVE_THREADS
+    pthread_t       thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+#endif
+    int             abort;
+    int             busy;   ///< a read into buf is in flight
+    int             ready;  ///< buf holds the result of the last read
+    uint8_t        *buf;
+    AVBufferRef    *ref;
+    int             size;
+    int             off;    ///< bytes of buf already consumed
+    int             ret;    ///< bytes left in buf, or read error
+} AVIOAsync;
+
+static int read_packet_wrapper(AVIOContext *s, uint8_t *buf, int size);
+
+#if HAVE_THREADS
+static void *async_thread(void *arg)
+{
+    AVIOContext *s = arg;
+    AVIOAsync   *a = s->async;
+
+    pthread_mutex_lock(&a->mutex);
+    for (;;) {
+        int ret;
+
+        while (!a->busy && !a->abort)
+            pthread_cond_wait(&a->cond, &a->mutex);
+        if (a->abort)
+            break;
+        pthread_mutex_unlock(&a->mutex);
+
+        ret = read_packet_wrapper(s, a->buf, a->size);
+
+        pthread_mutex_lock(&a->mutex);
+        a->ret   = ret;
+        a->off   = 0;
+        a->busy  = 0;
+        a->ready = 1;
+        pthread_cond_broadcast(&a->cond);
+    }
+    pthread_mutex_unlock(&a->mutex);
+    return NULL;
+}
+
+static int async_start(AVIOContext *s)
+{
+    AVIOAsync *a;
+    int ret;
+
+    a = av_mallocz(sizeof(*a));
+    if (!a)
+        return AVERROR(ENOMEM);
+    a->size = s->orig_buffer_size;
+    a->buf  = buffer_alloc(s, a->size, &a->ref);
+    if (!a->buf) {
+        av_free(a);
+        return AVERROR(ENOMEM);
+    }
+    s->async = a;
+
+    if ((ret = pthread_mutex_init(&a->mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&a->cond, NULL))) {
+        pthread_mutex_destroy(&a->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_create(&a->thread, NULL, async_thread, s))) {
+        pthread_cond_destroy(&a->cond);
+        pthread_mutex_destroy(&a->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    return 0;
+fail:
+    if (a->ref)
+        av_buffer_unref(&a->ref);
+    else
+        av_free(a->buf);
+    av_freep(&s->async);
+    return ret;
+}
+
+static void async_stop(AVIOContext *s)
+{
+    AVIOAsync *a = s->async;
+
+    if (!a)
+        return;
+    pthread_mutex_lock(&a->mutex);
+    a->abort = 1;
+    pthread_cond_broadcast(&a->cond);
+    pthread_mutex_unlock(&a->mutex);
+    pthread_join(a->thread, NULL);
+    pthread_cond_destroy(&a->cond);
+    pthread_mutex_destroy(&a->mutex);
+
+    if (a->ref)
+        av_buffer_unref(&a->ref);
+    else
+        av_free(a->buf);
+    av_freep(&s->async);
+}
+
+/**
+ * Start reading into the spare buffer, unless it is already in progress
+ * or done.
+ */
+static void async_request(AVIOContext *s)
+{
+    AVIOAsync *a = s->async;
+
+    pthread_mutex_lock(&a->mutex);
+    if (!a->busy && !a->ready) {
+        a->busy = 1;
+        pthread_cond_signal(&a->cond);
+    }
+    pthread_mutex_unlock(&a->mutex);
+}
+
+/**
+ * Wait until the worker is idle. Data already read ahead stays valid.
+ */
+static void async_wait(AVIOContext *s)
+{
+    AVIOAsync *a = s->async;
+
+    if (!a)
+        return;
+    pthread_mutex_lock(&a->mutex);
+    while (a->busy)
+        pthread_cond_wait(&a->cond, &a->mutex);
+    pthread_mutex_unlock(&a->mutex);
+}
+#else
+static int async_start(AVIOContext *s)
+{
+    return AVERROR(ENOSYS);
+}
+
+static void async_stop(AVIOContext *s)
+{
+}
+
+static void async_request(AVIOContext *s)
+{
+}
+
+static void async_wait(AVIOContext *s)
+{
+}
+#endif /* HAVE_THREADS */
+
+/**
+ * Call the seek callback once the worker is idle. Data read ahead is
+ * dropped if opaque was repositioned.
+ */
+static int64_t seek_wrapper(AVIOContext *s, int64_t offset, int whence)
+{
+    int64_t ret;
+
+    async_wait(s);
+    ret = s->seek(s->opaque, offset, whence);
+    if (ret >= 0 && s->async && !(whence & AVSEEK_SIZE))
+        s->async->ready = 0;
+    return ret;
+}
+
+/**
+ * Get the next chunk of data read ahead. If *dst is the start of the
+ * buffer, the buffers are swapped and *dst is updated to point into the
+ * new one, otherwise the data is copied to *dst.
+ */
+static int async_read(AVIOContext *s, uint8_t **dst, int len)
+{
+    AVIOAsync *a = s->async;
+    int ret;
+
+    async_request(s);
+    async_wait(s);
+
+    ret = a->ret;
+    if (ret <= 0) {
+        a->ready = 0;
+        return ret;
+    }
+
+    if (*dst == s->buffer && !a->ref == !s->buffer_ref) {
+        uint8_t     *buf = s->buffer;
+        AVBufferRef *ref = s->buffer_ref;
+
+        /* the old buffer becomes the spare, unless packets still use it */
+        if (ref && !av_buffer_is_writable(ref)) {
+            av_buffer_unref(&ref);
+            buf = NULL;
+        }
+        if (s->buffer_size < a->size) {
+            if (ref)
+                av_buffer_unref(&ref);
+            else
+                av_free(buf);
+            buf = NULL;
+        }
+
+        s->buffer       = a->buf;
+        s->buffer_ref   = a->ref;
+        s->buffer_size  = a->size;
+        s->checksum_ptr =
+        *dst            = a->buf + a->off;
+
+        a->buf   = buf ? buf : buffer_alloc(s, a->size, &ref);
+        a->ref   = ref;
+        a->ready = 0;
+        if (a->buf)
+            async_request(s);
+        else
+            async_stop(s);
+        return ret;
+    }
+
+    ret = FFMIN(ret, len);
+    memcpy(*dst, a->buf + a->off, ret);
+    a->off += ret;
+    a->ret -= ret;
+    if (!a->ret) {
+        a->ready = 0;
+        /* buffer references were enabled after the spare was allocated */
+        if (!a->ref != !s->buffer_ref) {
+            uint8_t *buf;
+            AVBufferRef *ref;
+
+            if (!(buf = buffer_alloc(s, a->size, &ref))) {
+                async_stop(s);
+                return ret;
+            }
+            if (a->ref)
+                av_buffer_unref(&a->ref);
+            else
+                av_free(a->buf);
+            a->buf = buf;
+            a->ref = ref;
+        }
+        async_request(s);
+    }
+    return ret;
+}
+
 static void *ff_avio_child_next(void *obj, void *prev)
 {
     AVIOContext *s = obj;
@@ -58,6 +356,7 @@ static const AVClass *ff_avio_child_class_next(const AVClass *prev)
 #define D AV_OPT_FLAG_DECODING_PARAM
 static const AVOption ff_avio_options[] = {
     {"protocol_whitelist", "List of protocols that are allowed to be used", OFFSET(protocol_whitelist), AV_OPT_TYPE_STRING, { .str = NULL },  CHAR_MIN, CHAR_MAX, D },
+    {"async_read", "read ahead from a background thread", OFFSET(async_read), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
     { NULL },
 };
 
@@ -142,6 +441,8 @@ AVIOContext *avio_alloc_context(
 
 void avio_context_free(AVIOContext **ps)
 {
+    if (*ps)
+        async_stop(*ps);
     av_freep(ps);
 }
 
@@ -251,7 +552,7 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         return AVERROR(EINVAL);
 
     if ((whence & AVSEEK_SIZE))
-        return s->seek ? s->seek(s->opaque, offset, AVSEEK_SIZE) : AVERROR(ENOSYS);
+        return s->seek ? seek_wrapper(s, offset, AVSEEK_SIZE) : AVERROR(ENOSYS);
 
     buffer_size = s->buf_end - s->buffer;
     // pos is the absolute position that the beginning of s->buffer corresponds to in the file
@@ -272,6 +573,7 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         return AVERROR(EINVAL);
 
     if (s->short_seek_get) {
+        async_wait(s);
         short_seek = s->short_seek_get(s->opaque);
         /* fallback to default short seek */
         if (short_seek <= 0)
@@ -281,7 +583,10 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
 
     offset1 = offset - pos; // "offset1" is the relative offset from the beginning of s->buffer
     s->buf_ptr_max = FFMAX(s->buf_ptr_max, s->buf_ptr);
-    if ((!s->direct || !s->seek) &&
+    if (s->mapped && offset1 > buffer_size) {
+        /* like lseek() past the end, reads will hit EOF */
+        s->buf_ptr = s->buf_end;
+    } else if ((!s->direct || !s->seek) &&
         offset1 >= 0 && offset1 <= (s->write_flag ? s->buf_ptr_max - s->buffer : buffer_size)) {
         /* can do the seek inside the buffer */
         s->buf_ptr = s->buffer + offset1;
@@ -299,7 +604,7 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         int64_t res;
 
         pos -= FFMIN(buffer_size>>1, pos);
-        if ((res = s->seek(s->opaque, pos, SEEK_SET)) < 0)
+        if ((res = seek_wrapper(s, pos, SEEK_SET)) < 0)
             return res;
         s->buf_end =
         s->buf_ptr = s->buffer;
@@ -314,7 +619,7 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         }
         if (!s->seek)
             return AVERROR(EPIPE);
-        if ((res = s->seek(s->opaque, offset, SEEK_SET)) < 0)
+        if ((res = seek_wrapper(s, offset, SEEK_SET)) < 0)
             return res;
         s->seek_count ++;
         if (!s->write_flag)
@@ -343,12 +648,12 @@ int64_t avio_size(AVIOContext *s)
 
     if (!s->seek)
         return AVERROR(ENOSYS);
-    size = s->seek(s->opaque, 0, AVSEEK_SIZE);
+    size = seek_wrapper(s, 0, AVSEEK_SIZE);
     if (size < 0) {
-        if ((size = s->seek(s->opaque, -1, SEEK_END)) < 0)
+        if ((size = seek_wrapper(s, -1, SEEK_END)) < 0)
             return size;
         size++;
-        s->seek(s->opaque, s->pos, SEEK_SET);
+        seek_wrapper(s, s->pos, SEEK_SET);
     }
     return size;
 }
@@ -553,13 +858,24 @@ static void fill_buffer(AVIOContext *s)
     int len             = s->buffer_size - (dst - s->buffer);
 
     /* can't fill the buffer without read_packet, just set EOF if appropriate */
-    if (!s->read_packet && s->buf_ptr >= s->buf_end)
+    if ((!s->read_packet || s->mapped) && s->buf_ptr >= s->buf_end)
         s->eof_reached = 1;
+    if (s->mapped)
+        return;
 
     /* no need to do anything if EOF already reached */
     if (s->eof_reached)
         return;
 
+    if (s->async_read && !s->async && s->read_packet && !s->write_flag && !s->direct) {
+        int ret = async_start(s);
+        if (ret < 0) {
+            av_log(s, AV_LOG_WARNING, "Could not start reading ahead: %s\n",
+                   av_err2str(ret));
+            s->async_read = 0;
+        }
+    }
+
     if (s->update_checksum && dst == s->buffer) {
         if (s->buf_end > s->checksum_ptr)
             s->checksum = s->update_checksum(s->checksum, s->checksum_ptr,
@@ -567,6 +883,20 @@ static void fill_buffer(AVIOContext *s)
         s->checksum_ptr = s->buffer;
     }
 
+    /* do not overwrite data still referenced by packets */
+    if (dst == s->buffer && s->buffer_ref &&
+        !av_buffer_is_writable(s->buffer_ref)) {
+        AVBufferRef *ref;
+        uint8_t *buffer = buffer_alloc(s, s->buffer_size, &ref);
+        if (!buffer) {
+            s->eof_reached = 1;
+            s->error       = AVERROR(ENOMEM);
+            return;
+        }
+        buffer_replace(s, buffer, ref);
+        s->buf_ptr = s->buf_end = s->checksum_ptr = dst = buffer;
+    }
+
     /* make buffer smaller in case it ended up large after probing */
     if (s->read_packet && s->orig_buffer_size && s->buffer_size > s->orig_buffer_size && len >= s->orig_buffer_size) {
         if (dst == s->buffer && s->buf_ptr != dst) {
@@ -579,7 +909,10 @@ static void fill_buffer(AVIOContext *s)
         len = s->orig_buffer_size;
     }
 
-    len = read_packet_wrapper(s, dst, len);
+    if (s->async)
+        len = async_read(s, &dst, len);
+    else
+        len = read_packet_wrapper(s, dst, len);
     if (len == AVERROR_EOF) {
         /* do not modify buffer if EOF reached so that a seek back can
            be done without rereading data */
@@ -650,7 +983,7 @@ int avio_read(AVIOContext *s, unsigned char *buf, int size)
     while (size > 0) {
         len = FFMIN(s->buf_end - s->buf_ptr, size);
         if (len == 0 || s->write_flag) {
-            if((s->direct || size > s->buffer_size) && !s->update_checksum) {
+            if((s->direct || size > s->buffer_size) && !s->update_checksum && !s->mapped && !s->async) {
                 // bypass the buffer and read data directly into buf
                 len = read_packet_wrapper(s, buf, size);
                 if (len == AVERROR_EOF) {
@@ -711,6 +1044,63 @@ int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsig
     }
 }
 
+int ffio_enable_buffer_refs(AVIOContext *s)
+{
+    AVBufferRef *ref;
+    uint8_t *buffer;
+
+    if (s->write_flag)
+        return AVERROR(EINVAL);
+    s->buffer_refs = 1;
+    if (s->buffer_ref)
+        return 0;
+
+    buffer = buffer_alloc_ref(s, s->buffer_size, &ref);
+    if (!buffer)
+        return AVERROR(ENOMEM);
+
+    memcpy(buffer, s->buffer, s->buf_end - s->buffer);
+    s->buf_ptr = buffer + (s->buf_ptr - s->buffer);
+    s->buf_end = buffer + (s->buf_end - s->buffer);
+    if (s->checksum_ptr)
+        s->checksum_ptr = buffer + (s->checksum_ptr - s->buffer);
+    buffer_replace(s, buffer, ref);
+    return 0;
+}
+
+int ffio_read_ref(AVIOContext *s, AVPacket *pkt, int size)
+{
+    int len = s->buf_end - s->buf_ptr;
+
+    if (!s->buffer_refs || s->write_flag || s->update_checksum || size <= 0)
+        return 0;
+
+    if (!len && size <= s->buffer_size) {
+        fill_buffer(s);
+        len = s->buf_end - s->buf_ptr;
+    }
+
+    if (size <= len) {
+        pkt->buf = av_buffer_ref(s->buffer_ref);
+        if (!pkt->buf)
+            return AVERROR(ENOMEM);
+        pkt->data   = s->buf_ptr;
+        pkt->size   = size;
+        s->buf_ptr += size;
+        return size;
+    }
+
+    /* packets straddling the end of the buffer are copied, larger ones are
+     * read straight into a packet of their own by the caller */
+    return 0;
+}
+
+int ffio_is_buffer_ref(AVIOContext *s, const AVBufferRef *buf)
+{
+    return buf && (av_buffer_get_opaque(buf) == s ||
+                   (s->mapped && buf->buffer == s->buffer_ref->buffer));
+}
+
 int avio_read_partial(AVIOContext *s, unsigned char *buf, int size)
 {
     int len;
@@ -733,7 +1123,8 @@ int avio_read_partial(AVIOContext *s, unsigned char *buf, int size)
          * This avoids returning partial packets at the end of the buffer,
          * for packet based inputs.
          */
-        s->buf_end = s->buf_ptr = s->buffer;
+        if (!s->mapped)
+            s->buf_end = s->buf_ptr = s->buffer;
         fill_buffer(s);
         len = s->buf_end - s->buf_ptr;
     }
@@ -937,18 +1328,26 @@ uint64_t ffio_read_varlen(AVIOContext *bc){
 
 int ffio_fdopen(AVIOContext **s, URLContext *h)
 {
+    AVBufferRef *map = NULL;
     uint8_t *buffer = NULL;
     int buffer_size, max_packet_size;
 
     max_packet_size = h->max_packet_size;
-    if (max_packet_size) {
-        buffer_size = max_packet_size; /* no need to bufferize more than one packet */
+    if (!(h->flags & AVIO_FLAG_WRITE) && ffurl_get_mapping(h, &map) >= 0) {
+        /* the whole resource is the buffer */
+        buffer          = map->data;
+        buffer_size     = map->size;
+        max_packet_size = 0;
     } else {
-        buffer_size = IO_BUFFER_SIZE;
+        if (max_packet_size) {
+            buffer_size = max_packet_size; /* no need to bufferize more than one packet */
+        } else {
+            buffer_size = IO_BUFFER_SIZE;
+        }
+        buffer = av_malloc(buffer_size);
+        if (!buffer)
+            return AVERROR(ENOMEM);
     }
-    buffer = av_malloc(buffer_size);
-    if (!buffer)
-        return AVERROR(ENOMEM);
 
     *s = avio_alloc_context(buffer, buffer_size, h->flags & AVIO_FLAG_WRITE, h,
                             (int (*)(void *, uint8_t *, int))  ffurl_read,
@@ -956,6 +1355,14 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
                             (int64_t (*)(void *, int64_t, int))ffurl_seek);
     if (!*s)
         goto fail;
+    if (map) {
+        (*s)->buffer_ref = map;
+        (*s)->mapped     = 1;
+        (*s)->buf_end    = buffer + buffer_size;
+        (*s)->pos        = buffer_size;
+        map = NULL;
+    }
+    buffer = NULL;
 
     (*s)->protocol_whitelist = av_strdup(h->protocol_whitelist);
     if (!(*s)->protocol_whitelist && h->protocol_whitelist) {
@@ -967,7 +1374,7 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
         avio_closep(s);
         goto fail;
     }
-    (*s)->direct = h->flags & AVIO_FLAG_DIRECT;
+    (*s)->direct = h->flags & AVIO_FLAG_DIRECT && !(*s)->mapped;
 
     (*s)->seekable = h->is_streamed ? 0 : AVIO_SEEKABLE_NORMAL;
     (*s)->max_packet_size = max_packet_size;
@@ -984,6 +1391,7 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
     (*s)->av_class = &ff_avio_class;
     return 0;
 fail:
+    av_buffer_unref(&map);
     av_freep(&buffer);
     return AVERROR(ENOMEM);
 }
@@ -993,14 +1401,20 @@ URLContext* ffio_geturlcontext(AVIOContext *s)
     if (!s)
         return NULL;
 
-    if (s->opaque && s->read_packet == (int (*)(void *, uint8_t *, int))ffurl_read)
+    if (s->opaque && s->read_packet == (int (*)(void *, uint8_t *, int))ffurl_read) {
+        /* the caller may reposition it */
+        async_wait(s);
+        if (s->async)
+            s->async->ready = 0;
         return s->opaque;
+    }
     else
         return NULL;
 }
 
 int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
 {
+    AVBufferRef *ref;
     uint8_t *buffer;
     int max_buffer_size = s->max_packet_size ?
                           s->max_packet_size : IO_BUFFER_SIZE;
@@ -1009,19 +1423,18 @@ int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
 
     buf_size += s->buf_ptr - s->buffer + max_buffer_size;
 
-    if (buf_size < filled || s->seekable || !s->read_packet)
+    if (buf_size < filled || s->seekable || !s->read_packet || s->mapped)
         return 0;
     av_assert0(!s->write_flag);
 
-    buffer = av_malloc(buf_size);
+    buffer = buffer_alloc(s, buf_size, &ref);
     if (!buffer)
         return AVERROR(ENOMEM);
 
     memcpy(buffer, s->buffer, filled);
-    av_free(s->buffer);
     s->buf_ptr = buffer + (s->buf_ptr - s->buffer);
     s->buf_end = buffer + (s->buf_end - s->buffer);
-    s->buffer = buffer;
+    buffer_replace(s, buffer, ref);
     s->buffer_size = buf_size;
     if (checksum_ptr_offset >= 0)
         s->checksum_ptr = s->buffer + checksum_ptr_offset;
@@ -1030,13 +1443,18 @@ int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
 
 int ffio_set_buf_size(AVIOContext *s, int buf_size)
 {
+    AVBufferRef *ref;
     uint8_t *buffer;
-    buffer = av_malloc(buf_size);
+
+    /* a mapping already holds all the data */
+    if (s->mapped)
+        return 0;
+
+    buffer = buffer_alloc(s, buf_size, &ref);
     if (!buffer)
         return AVERROR(ENOMEM);
 
-    av_free(s->buffer);
-    s->buffer = buffer;
+    buffer_replace(s, buffer, ref);
     s->orig_buffer_size =
     s->buffer_size = buf_size;
     s->buf_ptr = s->buf_ptr_max = buffer;
@@ -1046,24 +1464,24 @@ int ffio_set_buf_size(AVIOContext *s, int buf_size)
 
 int ffio_realloc_buf(AVIOContext *s, int buf_size)
 {
+    AVBufferRef *ref;
     uint8_t *buffer;
     int data_size;
 
     if (!s->buffer_size)
         return ffio_set_buf_size(s, buf_size);
 
-    if (buf_size <= s->buffer_size)
+    if (buf_size <= s->buffer_size || s->mapped)
         return 0;
 
-    buffer = av_malloc(buf_size);
+    buffer = buffer_alloc(s, buf_size, &ref);
     if (!buffer)
         return AVERROR(ENOMEM);
 
     data_size = s->write_flag ? (s->buf_ptr - s->buffer) : (s->buf_end - s->buf_ptr);
     if (data_size > 0)
         memcpy(buffer, s->write_flag ? s->buffer : s->buf_ptr, data_size);
-    av_free(s->buffer);
-    s->buffer = buffer;
+    buffer_replace(s, buffer, ref);
     s->orig_buffer_size = buf_size;
     s->buffer_size = buf_size;
     s->buf_ptr = s->write_flag ? (s->buffer + data_size) : s->buffer;
@@ -1091,6 +1509,7 @@ static int url_resetbuf(AVIOContext *s, int flags)
 
 int ffio_rewind_with_probe_data(AVIOContext *s, unsigned char **bufp, int buf_size)
 {
+    AVBufferRef *ref = NULL;
     int64_t buffer_start;
     int buffer_size;
     int overlap, new_size, alloc_size;
@@ -1101,6 +1520,14 @@ int ffio_rewind_with_probe_data(AVIOContext *s, unsigned char **bufp, int buf_si
         return AVERROR(EINVAL);
     }
 
+    /* the probe data is still in the mapping */
+    if (s->mapped) {
+        av_freep(bufp);
+        s->buf_ptr     = s->buffer;
+        s->eof_reached = 0;
+        return 0;
+    }
+
     buffer_size = s->buf_end - s->buffer;
 
     /* the buffers must touch or overlap */
@@ -1122,8 +1549,19 @@ int ffio_rewind_with_probe_data(AVIOContext *s, unsigned char **bufp, int buf_si
         buf_size = new_size;
     }
 
-    av_free(s->buffer);
-    s->buf_ptr = s->buffer = buf;
+    if (s->buffer_ref) {
+        uint8_t *buffer = buffer_alloc(s, alloc_size, &ref);
+        if (!buffer) {
+            av_freep(bufp);
+            return AVERROR(ENOMEM);
+        }
+        memcpy(buffer, buf, buf_size);
+        av_freep(bufp);
+        buf = buffer;
+    }
+
+    buffer_replace(s, buf, ref);
+    s->buf_ptr = buf;
     s->buffer_size = alloc_size;
     s->pos = buf_size;
     s->buf_end = s->buf_ptr + buf_size;
@@ -1155,6 +1593,10 @@ int ffio_open_whitelist(AVIOContext **s, const char *filename, int flags,
         ffurl_close(h);
         return err;
     }
+    if (options && (err = av_opt_set_dict(*s, options)) < 0) {
+        avio_closep(s);
+        return err;
+    }
     return 0;
 }
 
@@ -1171,11 +1613,12 @@ int avio_close(AVIOContext *s)
     if (!s)
         return 0;
 
+    async_stop(s);
     avio_flush(s);
     h         = s->opaque;
     s->opaque = NULL;
 
-    av_freep(&s->buffer);
+    buffer_replace(s, NULL, NULL);
     if (s->write_flag)
         av_log(s, AV_LOG_VERBOSE, "Statistics: %d seeks, %d writeouts\n", s->seek_count, s->writeout_count);
     else
@@ -1223,6 +1666,7 @@ int avio_pause(AVIOContext *s, int pause)
 {
     if (!s->read_pause)
         return AVERROR(ENOSYS);
+    async_wait(s);
     return s->read_pause(s->opaque, pause);
 }
 
@@ -1232,9 +1676,12 @@ int64_t avio_seek_time(AVIOContext *s, int stream_index,
     int64_t ret;
     if (!s->read_seek)
         return AVERROR(ENOSYS);
+    async_wait(s);
     ret = s->read_seek(s->opaque, stream_index, timestamp, flags);
     if (ret >= 0) {
         int64_t pos;
+        if (s->async)
+            s->async->ready = 0;
         s->buf_ptr = s->buf_end; // Flush buffer
         pos = s->seek(s->opaque, 0, SEEK_CUR);
         if (pos >= 0)
@@ -24,9 +24,11 @@
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 #include "internal.h"
 #include "avio_internal.h"
 #include "dash.h"
+#include "prefetch.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 
@@ -117,6 +119,12 @@ struct representation {
     uint32_t init_sec_buf_read_offset;
     int64_t cur_timestamp;
     int is_restart_needed;
+
+    /* Fragment prefetching */
+    Prefetch *prefetch;
+    int prefetch_disabled;
+    /* prefetched data of the current fragment, read before pls->input */
+    PrefetchBuffer seg_buf;
 };
 
 typedef struct DASHContext {
@@ -167,6 +175,23 @@ typedef struct DASHContext {
     int is_init_section_common_video;
     int is_init_section_common_audio;
 
+    int prefetch_segments;
+    int64_t prefetch_size;
+
+    /* Background manifest reloading for live streams */
+#if HAVE_THREADS
+    pthread_t manifest_thread;
+    pthread_mutex_t manifest_mutex;
+    pthread_cond_t manifest_cond;
+#endif
+    int manifest_thread_started;
+    int manifest_abort;
+    int64_t manifest_interval;
+    AVDictionary *manifest_opts;
+    AVIOInterruptCB manifest_int_cb;
+    char *manifest_buf;
+    unsigned int manifest_len;
+    char *manifest_location;
 } DASHContext;
 
 static int ishttp(char *url)
@@ -357,6 +382,8 @@ static void free_timelines_list(struct representation *pls)
 
 static void free_representation(struct representation *pls)
 {
+    ff_prefetch_free(&pls->prefetch);
+    ff_prefetch_buffer_free(&pls->seg_buf);
     free_fragment_list(pls);
     free_timelines_list(pls);
     free_fragment(&pls->cur_seg);
@@ -407,7 +434,8 @@ static void free_subtitle_list(DASHContext *c)
 }
 
 static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary *opts, AVDictionary *opts2, int *is_http)
+                    AVDictionary *opts, AVDictionary *opts2,
+                    const AVIOInterruptCB *int_cb, int *is_http)
 {
     DASHContext *c = s->priv_data;
     AVDictionary *tmp = NULL;
@@ -450,7 +478,7 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
         return AVERROR_INVALIDDATA;
 
     av_freep(pb);
-    ret = avio_open2(pb, url, AVIO_FLAG_READ, c->interrupt_callback, &tmp);
+    ret = avio_open2(pb, url, AVIO_FLAG_READ, int_cb, &tmp);
     if (ret >= 0) {
         // update cookies on http response with setcookies.
         char *new_cookies = NULL;
@@ -1254,7 +1282,7 @@ static int parse_manifest(AVFormatContext *s, const char *url, AVIOContext *in)
 
     buffer = av_mallocz(filesize);
     if (!buffer) {
-        av_free(c->base_url);
+        av_freep(&c->base_url);
         return AVERROR(ENOMEM);
     }
 
@@ -1505,6 +1533,223 @@ static void move_segments(struct representation *rep_src, struct representation
 }
 
 
+#if HAVE_THREADS
+static int manifest_interrupt(void *opaque)
+{
+    AVFormatContext *s = opaque;
+    DASHContext *c = s->priv_data;
+    int abort;
+
+    pthread_mutex_lock(&c->manifest_mutex);
+    abort = c->manifest_abort;
+    pthread_mutex_unlock(&c->manifest_mutex);
+    return abort || ff_check_interrupt(c->interrupt_callback);
+}
+
+static int fetch_manifest(AVFormatContext *s, AVBPrint *bp, char **location)
+{
+    DASHContext *c = s->priv_data;
+    AVIOContext *in = NULL;
+    AVDictionary *opts = NULL;
+    int ret;
+
+    av_dict_copy(&opts, c->manifest_opts, 0);
+    ret = avio_open2(&in, s->url, AVIO_FLAG_READ, &c->manifest_int_cb, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    av_opt_get(in, "location", AV_OPT_SEARCH_CHILDREN, (uint8_t **)location);
+    ret = avio_read_to_bprint(in, bp, INT_MAX);
+    if (ret >= 0 && !av_bprint_is_complete(bp))
+        ret = AVERROR(ENOMEM);
+    if (ret >= 0 && !bp->len)
+        ret = AVERROR_INVALIDDATA;
+    avio_closep(&in);
+    if (ret < 0) {
+        av_bprint_finalize(bp, NULL);
+        av_freep(location);
+    }
+    return ret;
+}
+
+/* Reload the manifest of a live stream in the background, so that the
+ * demuxer does not block on it while switching fragments. */
+static void *manifest_thread(void *arg)
+{
+    AVFormatContext *s = arg;
+    DASHContext *c = s->priv_data;
+
+    pthread_mutex_lock(&c->manifest_mutex);
+    while (!c->manifest_abort) {
+        int64_t t = av_gettime() + c->manifest_interval;
+        struct timespec ts = { t / 1000000, t % 1000000 * 1000 };
+        char *location = NULL;
+        AVBPrint bp;
+        int ret;
+
+        while (!c->manifest_abort &&
+               pthread_cond_timedwait(&c->manifest_cond, &c->manifest_mutex, &ts) != ETIMEDOUT)
+            ;
+        if (c->manifest_abort)
+            break;
+
+        pthread_mutex_unlock(&c->manifest_mutex);
+        av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+        ret = fetch_manifest(s, &bp, &location);
+        pthread_mutex_lock(&c->manifest_mutex);
+        if (ret < 0) {
+            if (!c->manifest_abort)
+                av_log(s, AV_LOG_WARNING, "Failed to reload manifest '%s': %s\n",
+                       s->url, av_err2str(ret));
+            continue;
+        }
+
+        av_freep(&c->manifest_buf);
+        av_freep(&c->manifest_location);
+        c->manifest_len      = bp.len;
+        c->manifest_location = location;
+        av_bprint_finalize(&bp, &c->manifest_buf);
+        pthread_cond_broadcast(&c->manifest_cond);
+    }
+    pthread_mutex_unlock(&c->manifest_mutex);
+    return NULL;
+}
+
+static void manifest_set_interval(DASHContext *c)
+{
+    pthread_mutex_lock(&c->manifest_mutex);
+    c->manifest_interval = FFMIN(FFMAX(c->minimum_update_period, 1), 3600) * 1000000;
+    pthread_mutex_unlock(&c->manifest_mutex);
+}
+
+static int manifest_start(AVFormatContext *s)
+{
+    DASHContext *c = s->priv_data;
+    int ret;
+
+    if ((ret = av_dict_copy(&c->manifest_opts, c->avio_opts, 0)) < 0)
+        return ret;
+    c->manifest_int_cb.callback = manifest_interrupt;
+    c->manifest_int_cb.opaque   = s;
+
+    if ((ret = pthread_mutex_init(&c->manifest_mutex, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&c->manifest_cond, NULL))) {
+        pthread_mutex_destroy(&c->manifest_mutex);
+        return AVERROR(ret);
+    }
+    manifest_set_interval(c);
+    if ((ret = pthread_create(&c->manifest_thread, NULL, manifest_thread, s))) {
+        pthread_cond_destroy(&c->manifest_cond);
+        pthread_mutex_destroy(&c->manifest_mutex);
+        return AVERROR(ret);
+    }
+    c->manifest_thread_started = 1;
+    return 0;
+}
+
+static void manifest_stop(AVFormatContext *s)
+{
+    DASHContext *c = s->priv_data;
+
+    if (c->manifest_thread_started) {
+        pthread_mutex_lock(&c->manifest_mutex);
+        c->manifest_abort = 1;
+        pthread_cond_broadcast(&c->manifest_cond);
+        pthread_mutex_unlock(&c->manifest_mutex);
+        pthread_join(c->manifest_thread, NULL);
+        pthread_cond_destroy(&c->manifest_cond);
+        pthread_mutex_destroy(&c->manifest_mutex);
+        c->manifest_thread_started = 0;
+    }
+    av_freep(&c->manifest_buf);
+    av_freep(&c->manifest_location);
+    av_dict_free(&c->manifest_opts);
+}
+
+/* Wait until the background thread has reloaded the manifest. */
+static void manifest_wait(AVFormatContext *s)
+{
+    DASHContext *c = s->priv_data;
+
+    if (!c->manifest_thread_started)
+        return;
+    pthread_mutex_lock(&c->manifest_mutex);
+    while (!c->manifest_buf && !ff_check_interrupt(c->interrupt_callback)) {
+        int64_t t = av_gettime() + 100000;
+        struct timespec ts = { t / 1000000, t % 1000000 * 1000 };
+
+        pthread_cond_timedwait(&c->manifest_cond, &c->manifest_mutex, &ts);
+    }
+    pthread_mutex_unlock(&c->manifest_mutex);
+}
+
+/* Take the manifest reloaded in the background, if there is a new one. */
+static void manifest_take(DASHContext *c, char **buf, unsigned int *len, char **location)
+{
+    pthread_mutex_lock(&c->manifest_mutex);
+    *buf                 = c->manifest_buf;
+    *len                 = c->manifest_len;
+    *location            = c->manifest_location;
+    c->manifest_buf      = NULL;
+    c->manifest_location = NULL;
+    pthread_mutex_unlock(&c->manifest_mutex);
+}
+#else
+static void manifest_set_interval(DASHContext *c)
+{
+}
+
+static int manifest_start(AVFormatContext *s)
+{
+    return AVERROR(ENOSYS);
+}
+
+static void manifest_stop(AVFormatContext *s)
+{
+}
+
+static void manifest_wait(AVFormatContext *s)
+{
+}
+
+static void manifest_take(DASHContext *c, char **buf, unsigned int *len, char **location)
+{
+    *buf      = NULL;
+    *location = NULL;
+}
+#endif
+
+typedef struct ManifestReader {
+    const uint8_t *data;
+    int size;
+    int pos;
+} ManifestReader;
+
+static int manifest_read(void *opaque, uint8_t *buf, int buf_size)
+{
+    ManifestReader *r = opaque;
+    int len = FFMIN(buf_size, r->size - r->pos);
+
+    if (len <= 0)
+        return AVERROR_EOF;
+    memcpy(buf, r->data + r->pos, len);
+    r->pos += len;
+    return len;
+}
+
+static int64_t manifest_seek(void *opaque, int64_t offset, int whence)
+{
+    ManifestReader *r = opaque;
+
+    if (whence == AVSEEK_SIZE)
+        return r->size;
+    if (whence != SEEK_SET || offset < 0 || offset > r->size)
+        return AVERROR(EINVAL);
+    return r->pos = offset;
+}
+
 static int refresh_manifest(AVFormatContext *s)
 {
     int ret = 0, i;
@@ -1517,6 +1762,30 @@ static int refresh_manifest(AVFormatContext *s)
     int n_subtitles = c->n_subtitles;
     struct representation **subtitles = c->subtitles;
     char *base_url = c->base_url;
+    AVIOContext *in = NULL;
+    ManifestReader reader = { NULL };
+    uint8_t *iobuf = NULL;
+    char *buf = NULL, *location = NULL;
+    unsigned int len = 0;
+
+    if (c->manifest_thread_started) {
+        /* the manifest is reloaded in the background, only use a new one */
+        manifest_take(c, &buf, &len, &location);
+        if (!buf)
+            return 0;
+        reader.data = buf;
+        reader.size = len;
+        iobuf = av_malloc(INITIAL_BUFFER_SIZE);
+        if (iobuf)
+            in = avio_alloc_context(iobuf, INITIAL_BUFFER_SIZE, 0, &reader,
+                                    manifest_read, NULL, manifest_seek);
+        if (!in) {
+            av_free(iobuf);
+            av_free(buf);
+            av_free(location);
+            return AVERROR(ENOMEM);
+        }
+    }
 
     c->base_url = NULL;
     c->n_videos = 0;
@@ -1525,7 +1794,19 @@ static int refresh_manifest(AVFormatContext *s)
     c->audios = NULL;
     c->n_subtitles = 0;
     c->subtitles = NULL;
-    ret = parse_manifest(s, s->url, NULL);
+    ret = parse_manifest(s, s->url, in);
+    if (in) {
+        av_freep(&in->buffer);
+        avio_context_free(&in);
+        av_free(buf);
+        if (!ret && location) {
+            av_free(c->base_url);
+            c->base_url = location;
+            location = NULL;
+        }
+        av_free(location);
+        manifest_set_interval(c);
+    }
     if (ret)
         goto finish;
 
@@ -1604,30 +1885,67 @@ finish:
     return ret;
 }
 
+static struct fragment *copy_fragment(const struct fragment *src)
+{
+    struct fragment *seg = av_mallocz(sizeof(struct fragment));
+
+    if (!seg)
+        return NULL;
+    seg->url = av_strdup(src->url);
+    if (!seg->url) {
+        av_free(seg);
+        return NULL;
+    }
+    seg->size = src->size;
+    seg->url_offset = src->url_offset;
+    return seg;
+}
+
+static struct fragment *get_template_fragment(struct representation *pls, int64_t seq_no)
+{
+    DASHContext *c = pls->parent->priv_data;
+    struct fragment *seg;
+    char *tmpfilename;
+
+    /* past the end of a SegmentList */
+    if (!pls->url_template)
+        return NULL;
+
+    seg = av_mallocz(sizeof(struct fragment));
+    tmpfilename = av_mallocz(c->max_url_size);
+    if (!seg || !tmpfilename) {
+        av_free(seg);
+        av_free(tmpfilename);
+        return NULL;
+    }
+    ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, seq_no, 0, get_segment_start_time_based_on_timeline(pls, seq_no));
+    seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
+    if (!seg->url) {
+        av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
+        seg->url = av_strdup(pls->url_template);
+        if (!seg->url) {
+            av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
+            av_free(tmpfilename);
+            av_free(seg);
+            return NULL;
+        }
+    }
+    av_free(tmpfilename);
+    seg->size = -1;
+    return seg;
+}
+
 static struct fragment *get_current_fragment(struct representation *pls)
 {
     int64_t min_seq_no = 0;
     int64_t max_seq_no = 0;
-    struct fragment *seg = NULL;
-    struct fragment *seg_ptr = NULL;
     DASHContext *c = pls->parent->priv_data;
 
     while (( !ff_check_interrupt(c->interrupt_callback)&& pls->n_fragments > 0)) {
         if (pls->cur_seq_no < pls->n_fragments) {
-            seg_ptr = pls->fragments[pls->cur_seq_no];
-            seg = av_mallocz(sizeof(struct fragment));
-            if (!seg) {
-                return NULL;
-            }
-            seg->url = av_strdup(seg_ptr->url);
-            if (!seg->url) {
-                av_free(seg);
-                return NULL;
-            }
-            seg->size = seg_ptr->size;
-            seg->url_offset = seg_ptr->url_offset;
-            return seg;
+            return copy_fragment(pls->fragments[pls->cur_seq_no]);
         } else if (c->is_live) {
+            manifest_wait(pls->parent);
             refresh_manifest(pls->parent);
         } else {
             break;
@@ -1639,6 +1957,12 @@ static struct fragment *get_current_fragment(struct representation *pls)
 
         if (pls->timelines || pls->fragments) {
             refresh_manifest(pls->parent);
+            /* a manifest reloaded in the background may not list it yet */
+            while (c->manifest_thread_started && pls->cur_seq_no > calc_max_seg_no(pls, c) &&
+                   !ff_check_interrupt(c->interrupt_callback)) {
+                manifest_wait(pls->parent);
+                refresh_manifest(pls->parent);
+            }
         }
         if (pls->cur_seq_no <= min_seq_no) {
             av_log(pls->parent, AV_LOG_VERBOSE, "old fragment: cur[%"PRId64"] min[%"PRId64"] max[%"PRId64"], playlist %d\n", (int64_t)pls->cur_seq_no, min_seq_no, max_seq_no, (int)pls->rep_idx);
@@ -1646,37 +1970,25 @@ static struct fragment *get_current_fragment(struct representation *pls)
         } else if (pls->cur_seq_no > max_seq_no) {
             av_log(pls->parent, AV_LOG_VERBOSE, "new fragment: min[%"PRId64"] max[%"PRId64"], playlist %d\n", min_seq_no, max_seq_no, (int)pls->rep_idx);
         }
-        seg = av_mallocz(sizeof(struct fragment));
-        if (!seg) {
-            return NULL;
-        }
+        return get_template_fragment(pls, pls->cur_seq_no);
     } else if (pls->cur_seq_no <= pls->last_seq_no) {
-        seg = av_mallocz(sizeof(struct fragment));
-        if (!seg) {
-            return NULL;
-        }
-    }
-    if (seg) {
-        char *tmpfilename= av_mallocz(c->max_url_size);
-        if (!tmpfilename) {
-            return NULL;
-        }
-        ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, pls->cur_seq_no, 0, get_segment_start_time_based_on_timeline(pls, pls->cur_seq_no));
-        seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
-        if (!seg->url) {
-            av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
-            seg->url = av_strdup(pls->url_template);
-            if (!seg->url) {
-                av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
-                av_free(tmpfilename);
-                return NULL;
-            }
-        }
-        av_free(tmpfilename);
-        seg->size = -1;
+        return get_template_fragment(pls, pls->cur_seq_no);
     }
 
-    return seg;
+    return NULL;
+}
+
+/* Return the fragment with the given number if it is known without
+ * reloading the manifest, for prefetching. */
+static struct fragment *get_fragment(struct representation *pls, int64_t seq_no)
+{
+    DASHContext *c = pls->parent->priv_data;
+
+    if (pls->n_fragments > 0)
+        return seq_no < pls->n_fragments ? copy_fragment(pls->fragments[seq_no]) : NULL;
+    if (seq_no > (c->is_live ? calc_max_seg_no(pls, c) : pls->last_seq_no))
+        return NULL;
+    return get_template_fragment(pls, seq_no);
 }
 
 static int read_from_url(struct representation *pls, struct fragment *seg,
@@ -1688,24 +2000,31 @@ static int read_from_url(struct representation *pls, struct fragment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, pls->cur_seg_size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    ret = ff_prefetch_buffer_read(&pls->seg_buf, pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
     return ret;
 }
 
-static int open_input(DASHContext *c, struct representation *pls, struct fragment *seg)
+static char *get_fragment_url(DASHContext *c, const struct fragment *seg)
 {
-    AVDictionary *opts = NULL;
-    char *url = NULL;
-    int ret = 0;
+    char *url = av_mallocz(c->max_url_size);
 
-    url = av_mallocz(c->max_url_size);
-    if (!url) {
-        ret = AVERROR(ENOMEM);
-        goto cleanup;
-    }
+    if (url)
+        ff_make_absolute_url(url, c->max_url_size, c->base_url, seg->url);
+    return url;
+}
+
+/* Open a fragment given its absolute url without touching the read state
+ * of the representation, so that it can be done from a prefetch thread. */
+static int open_fragment(DASHContext *c, struct representation *pls,
+                         const struct fragment *seg, const char *url,
+                         AVDictionary *avio_opts, const AVIOInterruptCB *int_cb,
+                         AVIOContext **in)
+{
+    AVDictionary *opts = NULL;
+    int ret;
 
     if (seg->size >= 0) {
         /* try to restrict the HTTP request to the part we want
@@ -1714,14 +2033,23 @@ static int open_input(DASHContext *c, struct representation *pls, struct fragmen
         av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
     }
 
-    ff_make_absolute_url(url, c->max_url_size, c->base_url, seg->url);
     av_log(pls->parent, AV_LOG_VERBOSE, "DASH request for url '%s', offset %"PRId64", playlist %d\n",
            url, seg->url_offset, pls->rep_idx);
-    ret = open_url(pls->parent, &pls->input, url, c->avio_opts, opts, NULL);
+    ret = open_url(pls->parent, in, url, avio_opts, opts, int_cb, NULL);
 
-cleanup:
-    av_free(url);
     av_dict_free(&opts);
+    return ret;
+}
+
+static int open_input(DASHContext *c, struct representation *pls, struct fragment *seg)
+{
+    char *url = get_fragment_url(c, seg);
+    int ret = AVERROR(ENOMEM);
+
+    if (url)
+        ret = open_fragment(c, pls, seg, url, c->avio_opts,
+                            c->interrupt_callback, &pls->input);
+    av_free(url);
     pls->cur_seg_offset = 0;
     pls->cur_seg_size = seg->size;
     return ret;
@@ -1774,11 +2102,86 @@ static int update_init_section(struct representation *pls)
     return 0;
 }
 
+static int prefetch_open(void *opaque, const PrefetchSegment *pseg,
+                         AVDictionary **avio_opts, const AVIOInterruptCB *int_cb,
+                         AVIOContext **in)
+{
+    struct representation *pls = opaque;
+    struct fragment seg = {
+        .url_offset = pseg->url_offset,
+        .size       = pseg->size,
+        .url        = pseg->url,
+    };
+
+    return open_fragment(pls->parent->priv_data, pls, &seg, seg.url,
+                         *avio_opts, int_cb, in);
+}
+
+/* Start downloading the fragments following the current one. */
+static void prefetch_schedule(DASHContext *c, struct representation *pls)
+{
+    PrefetchSegment next[64];
+    int i, n, ret;
+
+    if (c->prefetch_segments <= 0 || pls->prefetch_disabled || pls->n_fragments == 1)
+        return;
+    if (!pls->prefetch &&
+        (ret = ff_prefetch_alloc(&pls->prefetch, pls->parent, c->prefetch_segments,
+                                 c->prefetch_size, prefetch_open, pls)) < 0) {
+        av_log(pls->parent, AV_LOG_WARNING,
+               "Could not start prefetching for playlist %d: %s\n",
+               pls->rep_idx, av_err2str(ret));
+        pls->prefetch_disabled = 1;
+        return;
+    }
+
+    /* the urls are made absolute here, the base url may change on reload */
+    for (n = 0; n < c->prefetch_segments; n++) {
+        struct fragment *seg = get_fragment(pls, pls->cur_seq_no + 1 + n);
+        char *url = seg ? get_fragment_url(c, seg) : NULL;
+
+        if (url)
+            next[n] = (PrefetchSegment) {
+                .url        = url,
+                .url_offset = seg->url_offset,
+                .size       = seg->size,
+            };
+        free_fragment(&seg);
+        if (!url)
+            break;
+    }
+    ff_prefetch_schedule(pls->prefetch, next, n, c->avio_opts);
+
+    for (i = 0; i < n; i++)
+        av_free(next[i].url);
+}
+
+/* Make a prefetched copy of the current fragment the input of the
+ * representation. Returns AVERROR(EAGAIN) if it has to be opened directly. */
+static int prefetch_take(DASHContext *c, struct representation *pls, struct fragment *seg)
+{
+    PrefetchSegment pseg = {
+        .url_offset = seg->url_offset,
+        .size       = seg->size,
+    };
+    int ret;
+
+    if (!pls->prefetch || !(pseg.url = get_fragment_url(c, seg)))
+        return AVERROR(EAGAIN);
+    ret = ff_prefetch_take(pls->prefetch, &pseg, &pls->input, &pls->seg_buf);
+    if (ret >= 0) {
+        pls->cur_seg_offset = 0;
+        pls->cur_seg_size   = seg->size;
+    }
+    av_free(pseg.url);
+    return ret;
+}
+
 static int64_t seek_data(void *opaque, int64_t offset, int whence)
 {
     struct representation *v = opaque;
     if (v->n_fragments && !v->init_sec_data_len) {
-        return avio_seek(v->input, offset, whence);
+        return ff_prefetch_buffer_seek(&v->seg_buf, v->input, offset, whence);
     }
 
     return AVERROR(ENOSYS);
@@ -1800,11 +2203,14 @@ restart:
         }
 
         /* load/update Media Initialization Section, if any */
+        ff_prefetch_buffer_reset(&v->seg_buf);
         ret = update_init_section(v);
         if (ret)
             goto end;
 
-        ret = open_input(c, v, v->cur_seg);
+        ret = prefetch_take(c, v, v->cur_seg);
+        if (ret < 0)
+            ret = open_input(c, v, v->cur_seg);
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback)) {
                 ret = AVERROR_EXIT;
@@ -1814,6 +2220,7 @@ restart:
             v->cur_seq_no++;
             goto restart;
         }
+        prefetch_schedule(c, v);
     }
 
     if (v->init_sec_buf_read_offset < v->init_sec_data_len) {
@@ -2039,6 +2446,8 @@ static int copy_init_section(struct representation *rep_dest, struct representat
 }
 
 
+static int dash_close(AVFormatContext *s);
+
 static int dash_read_header(AVFormatContext *s)
 {
     DASHContext *c = s->priv_data;
@@ -2052,6 +2461,12 @@ static int dash_read_header(AVFormatContext *s)
     if ((ret = save_avio_options(s)) < 0)
         goto fail;
 
+    if (c->prefetch_segments > 0 && !ff_format_io_is_default(s)) {
+        av_log(s, AV_LOG_WARNING, "Fragment prefetching is disabled with custom "
+               "I/O callbacks\n");
+        c->prefetch_segments = 0;
+    }
+
     if ((ret = parse_manifest(s, s->url, s->pb)) < 0)
         goto fail;
 
@@ -2128,6 +2543,7 @@ static int dash_read_header(AVFormatContext *s)
         AVProgram *program;
         program = av_new_program(s, 0);
         if (!program) {
+            ret = AVERROR(ENOMEM);
             goto fail;
         }
 
@@ -2158,8 +2574,13 @@ static int dash_read_header(AVFormatContext *s)
         }
     }
 
+    if (c->is_live && c->prefetch_segments > 0 && (ret = manifest_start(s)) < 0)
+        av_log(s, AV_LOG_WARNING, "Could not reload the manifest in the background: %s\n",
+               av_err2str(ret));
+
     return 0;
 fail:
+    dash_close(s);
     return ret;
 }
 
@@ -2254,8 +2675,10 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
 static int dash_close(AVFormatContext *s)
 {
     DASHContext *c = s->priv_data;
+    manifest_stop(s);
     free_audio_list(c);
     free_video_list(c);
+    free_subtitle_list(c);
     av_dict_free(&c->avio_opts);
     av_freep(&c->base_url);
     return 0;
@@ -2378,6 +2801,10 @@ static const AVOption dash_options[] = {
         OFFSET(allowed_extensions), AV_OPT_TYPE_STRING,
         {.str = "aac,m4a,m4s,m4v,mov,mp4,webm"},
         INT_MIN, INT_MAX, FLAGS},
+    {"prefetch_segments", "Number of fragments to download ahead per representation",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_size", "Maximum number of bytes to hold in memory for prefetched fragments per representation",
+        OFFSET(prefetch_size), AV_OPT_TYPE_INT64, {.i64 = 64 * 1024 * 1024}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
@@ -47,6 +47,7 @@
 #include "internal.h"
 #include "isom.h"
 #include "os_support.h"
+#include "uploadqueue.h"
 #include "url.h"
 #include "vpcc.h"
 #include "dash.h"
@@ -193,6 +194,9 @@ typedef struct DASHContext {
     int profile;
     int64_t target_latency;
     int target_latency_refid;
+    int upload_connections;
+    int64_t upload_queue_size;
+    UploadQueue *upload;
 } DASHContext;
 
 static struct codec_string {
@@ -222,7 +226,9 @@ static int dashenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
     DASHContext *c = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
-    if (!*pb || !http_base_proto || !c->http_persistent) {
+    if (c->upload && http_base_proto) {
+        err = ff_upload_queue_open(c->upload, pb, filename, options);
+    } else if (!*pb || !http_base_proto || !c->http_persistent) {
         err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -243,7 +249,9 @@ static void dashenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filenam
     if (!*pb)
         return;
 
-    if (!http_base_proto || !c->http_persistent) {
+    if (ff_upload_queue_owns(c->upload, *pb)) {
+        ff_upload_queue_close(c->upload, pb, 0);
+    } else if (!http_base_proto || !c->http_persistent) {
         ff_format_io_close(s, pb);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -255,6 +263,28 @@ static void dashenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filenam
     }
 }
 
+/* Manifests are only uploaded once the segments they reference are. */
+static void dashenc_io_close_manifest(AVFormatContext *s, AVIOContext **pb, char *filename)
+{
+    DASHContext *c = s->priv_data;
+
+    if (ff_upload_queue_owns(c->upload, *pb))
+        ff_upload_queue_close(c->upload, pb, 1);
+    else
+        dashenc_io_close(s, pb, filename);
+}
+
+/* Files still being written to memory are freed along with the queue. */
+static void dashenc_io_free(AVFormatContext *s, AVIOContext **pb)
+{
+    DASHContext *c = s->priv_data;
+
+    if (ff_upload_queue_owns(c->upload, *pb))
+        *pb = NULL;
+    else
+        ff_format_io_close(s, pb);
+}
+
 static const char *get_format_str(SegmentType segment_type) {
     int i;
     for (i = 0; i < SEGMENT_TYPE_NB; i++)
@@ -581,7 +611,7 @@ static void write_hls_media_playlist(OutputStream *os, AVFormatContext *s,
     if (final)
         ff_hls_write_end_list(c->m3u8_out);
 
-    dashenc_io_close(s, &c->m3u8_out, temp_filename_hls);
+    dashenc_io_close_manifest(s, &c->m3u8_out, temp_filename_hls);
 
     if (use_rename)
         ff_rename(temp_filename_hls, filename_hls, os->ctx);
@@ -629,7 +659,7 @@ static void dash_free(AVFormatContext *s)
             else
                 avio_close(os->ctx->pb);
         }
-        ff_format_io_close(s, &os->out);
+        dashenc_io_free(s, &os->out);
         avformat_free_context(os->ctx);
         avcodec_free_context(&os->parser_avctx);
         av_parser_close(os->parser);
@@ -642,8 +672,9 @@ static void dash_free(AVFormatContext *s)
     }
     av_freep(&c->streams);
 
-    ff_format_io_close(s, &c->mpd_out);
-    ff_format_io_close(s, &c->m3u8_out);
+    dashenc_io_free(s, &c->mpd_out);
+    dashenc_io_free(s, &c->m3u8_out);
+    ff_upload_queue_free(&c->upload);
 }
 
 static void output_segment_list(OutputStream *os, AVIOContext *out, AVFormatContext *s,
@@ -1230,7 +1261,7 @@ static int write_manifest(AVFormatContext *s, int final)
 
     avio_printf(out, "</MPD>\n");
     avio_flush(out);
-    dashenc_io_close(s, &c->mpd_out, temp_filename);
+    dashenc_io_close_manifest(s, &c->mpd_out, temp_filename);
 
     if (use_rename) {
         if ((ret = ff_rename(temp_filename, s->url, s)) < 0)
@@ -1313,7 +1344,7 @@ static int write_manifest(AVFormatContext *s, int final)
                                      playlist_file, agroup,
                                      codec_str_ptr, NULL);
         }
-        dashenc_io_close(s, &c->m3u8_out, temp_filename);
+        dashenc_io_close_manifest(s, &c->m3u8_out, temp_filename);
         if (use_rename)
             if ((ret = ff_rename(temp_filename, filename_hls, s)) < 0)
                 return ret;
@@ -1410,6 +1441,25 @@ static int dash_init(AVFormatContext *s)
         c->write_prft = 0;
     }
 
+    if (c->upload_connections && c->streaming) {
+        av_log(s, AV_LOG_WARNING, "Upload connections option will be ignored as streaming is enabled\n");
+        c->upload_connections = 0;
+    }
+
+    if (c->upload_connections && !ff_format_io_is_default(s)) {
+        av_log(s, AV_LOG_WARNING, "Upload connections option will be ignored as custom I/O callbacks are set\n");
+        c->upload_connections = 0;
+    }
+
+    if (c->upload_connections) {
+        ret = ff_upload_queue_alloc(&c->upload, s, c->upload_connections,
+                                    c->upload_queue_size, c->http_persistent);
+        if (ret == AVERROR(ENOSYS))
+            av_log(s, AV_LOG_WARNING, "Upload connections option will be ignored as threads are not available\n");
+        else if (ret < 0)
+            return ret;
+    }
+
     if (c->ldash && !c->write_prft) {
         av_log(s, AV_LOG_WARNING, "Low Latency mode enabled without Producer Reference Time element option! Resulting manifest may not be complaint\n");
     }
@@ -1543,7 +1593,7 @@ static int dash_init(AVFormatContext *s)
         if (!c->single_file) {
             if ((ret = avio_open_dyn_buf(&ctx->pb)) < 0)
                 return ret;
-            ret = s->io_open(s, &os->out, filename, AVIO_FLAG_WRITE, &opts);
+            ret = dashenc_io_open(s, &os->out, filename, &opts);
         } else {
             ctx->url = av_strdup(filename);
             ret = avio_open2(&ctx->pb, filename, AVIO_FLAG_WRITE, NULL, &opts);
@@ -1813,7 +1863,10 @@ static void dashenc_delete_file(AVFormatContext *s, char *filename) {
         set_http_options(&http_opts, c);
         av_dict_set(&http_opts, "method", "DELETE", 0);
 
-        if (dashenc_io_open(s, &out, filename, &http_opts) < 0) {
+        if (c->upload) {
+            if (ff_upload_queue_delete(c->upload, filename, &http_opts) < 0)
+                av_log(s, AV_LOG_ERROR, "failed to delete %s\n", filename);
+        } else if (s->io_open(s, &out, filename, AVIO_FLAG_WRITE, &http_opts) < 0) {
             av_log(s, AV_LOG_ERROR, "failed to delete %s\n", filename);
         }
 
@@ -2291,6 +2344,12 @@ static int dash_write_trailer(AVFormatContext *s)
         }
     }
 
+    if (c->upload) {
+        int ret = ff_upload_queue_flush(c->upload);
+        if (ret < 0 && !c->ignore_io_errors)
+            return ret;
+    }
+
     return 0;
 }
 
@@ -2344,6 +2403,8 @@ static const AVOption options[] = {
     { "method", "set the HTTP method", OFFSET(method), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, E },
     { "http_user_agent", "override User-Agent field in HTTP header", OFFSET(user_agent), AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, E},
     { "http_persistent", "Use persistent HTTP connections", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
+    { "upload_connections", "Upload files over HTTP in the background using this many connections", OFFSET(upload_connections), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, 64, E },
+    { "upload_queue_size", "Maximum size of the files waiting for a background upload", OFFSET(upload_queue_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20 }, 0, INT64_MAX, E },
     { "hls_playlist", "Generate HLS playlist files(master.m3u8, media_%d.m3u8)", OFFSET(hls_playlist), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     { "streaming", "Enable/Disable streaming mode of output. Each frame will be moof fragment", OFFSET(streaming), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     { "timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
@@ -19,6 +19,10 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* O_DIRECT */
+#endif
+
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
@@ -35,6 +39,16 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#if HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
@@ -67,6 +81,46 @@
 
 /* standard file protocol */
 
+#if HAVE_LINUX_IO_URING_H
+/* alignment of offsets, sizes and buffers for O_DIRECT */
+#define URING_ALIGN 4096
+
+typedef struct UringBlock {
+    struct iovec iov;
+    uint8_t *data;
+    int64_t pos;        ///< file offset of data
+    int len;            ///< bytes read so far
+    int err;            ///< negative errno of the last read, 0 otherwise
+    int pending;
+} UringBlock;
+
+/**
+ * Read-ahead window of nb_blocks consecutive blocks of block_size bytes,
+ * starting with blocks[first] at file offset window_pos.
+ */
+typedef struct Uring {
+    int fd;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned to_submit;
+    int nb_pending;
+
+    uint8_t *mem;
+    size_t mem_size;
+    UringBlock *blocks;
+    int nb_blocks;
+    int block_size;
+    int first;
+    int64_t window_pos; ///< -1 if the window has to be refilled
+    int64_t pos;        ///< logical read position
+} Uring;
+#endif
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
@@ -74,9 +128,18 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int io_uring;
+    int readahead;
+    int readahead_size;
+    int direct;
+    int mmap;
+    AVBufferRef *map;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
+#if HAVE_LINUX_IO_URING_H
+    Uring *uring;
+#endif
 } FileContext;
 
 static const AVOption file_options[] = {
@@ -84,6 +147,11 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring", "read through io_uring, falling back to read() when unavailable", offsetof(FileContext, io_uring), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "readahead", "number of io_uring read requests kept in flight", offsetof(FileContext, readahead), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, 64, AV_OPT_FLAG_DECODING_PARAM },
+    { "readahead_size", "size of each io_uring read request", offsetof(FileContext, readahead_size), AV_OPT_TYPE_INT, { .i64 = 262144 }, 4096, 64 << 20, AV_OPT_FLAG_DECODING_PARAM },
+    { "direct", "bypass the page cache with O_DIRECT when reading through io_uring", offsetof(FileContext, direct), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "mmap", "map the file into memory instead of reading it", offsetof(FileContext, mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -106,10 +174,239 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_LINUX_IO_URING_H
+static void uring_free(FileContext *c)
+{
+    Uring *u = c->uring;
+
+    if (!u)
+        return;
+    if (u->mem)
+        munmap(u->mem, u->mem_size);
+    if (u->sqes)
+        munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring)
+        munmap(u->cq_ring, u->cq_ring_size);
+    if (u->sq_ring)
+        munmap(u->sq_ring, u->sq_ring_size);
+    if (u->fd >= 0)
+        close(u->fd);
+    av_freep(&u->blocks);
+    av_freep(&c->uring);
+}
+
+static void *uring_mmap(int fd, size_t size, off_t offset)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     fd < 0 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED | MAP_POPULATE,
+                     fd, offset);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static int uring_init(FileContext *c)
+{
+    struct io_uring_params p = { 0 };
+    Uring *u;
+    int i;
+
+    u = c->uring = av_mallocz(sizeof(*u));
+    if (!u)
+        return AVERROR(ENOMEM);
+
+    u->fd = syscall(__NR_io_uring_setup, c->readahead, &p);
+    if (u->fd < 0)
+        return AVERROR(errno);
+
+    u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_ring_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->sqes_size    = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sq_ring = uring_mmap(u->fd, u->sq_ring_size, IORING_OFF_SQ_RING);
+    u->cq_ring = uring_mmap(u->fd, u->cq_ring_size, IORING_OFF_CQ_RING);
+    u->sqes    = uring_mmap(u->fd, u->sqes_size,    IORING_OFF_SQES);
+    if (!u->sq_ring || !u->cq_ring || !u->sqes)
+        return AVERROR(errno);
+
+    u->sq_tail  = (unsigned *)((uint8_t *)u->sq_ring + p.sq_off.tail);
+    u->sq_mask  = (unsigned *)((uint8_t *)u->sq_ring + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)((uint8_t *)u->sq_ring + p.sq_off.array);
+    u->cq_head  = (unsigned *)((uint8_t *)u->cq_ring + p.cq_off.head);
+    u->cq_tail  = (unsigned *)((uint8_t *)u->cq_ring + p.cq_off.tail);
+    u->cq_mask  = (unsigned *)((uint8_t *)u->cq_ring + p.cq_off.ring_mask);
+    u->cqes     = (struct io_uring_cqe *)((uint8_t *)u->cq_ring + p.cq_off.cqes);
+
+    /* anonymous mappings are page aligned, as O_DIRECT requires */
+    u->nb_blocks  = c->readahead;
+    u->block_size = FFALIGN(c->readahead_size, URING_ALIGN);
+    u->mem_size   = (size_t)u->block_size * u->nb_blocks;
+    u->mem        = uring_mmap(-1, u->mem_size, 0);
+    u->blocks     = av_calloc(u->nb_blocks, sizeof(*u->blocks));
+    if (!u->mem || !u->blocks)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < u->nb_blocks; i++)
+        u->blocks[i].data = u->mem + (size_t)i * u->block_size;
+    u->window_pos = -1;
+
+    return 0;
+}
+
+/* Queue a read of the part of the block not read yet. */
+static void uring_submit(FileContext *c, UringBlock *b)
+{
+    Uring *u = c->uring;
+    unsigned tail = *u->sq_tail;
+    unsigned idx  = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+
+    b->iov.iov_base = b->data + b->len;
+    b->iov.iov_len  = u->block_size - b->len;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = IORING_OP_READV;
+    sqe->fd        = c->fd;
+    sqe->off       = b->pos + b->len;
+    sqe->addr      = (uintptr_t)&b->iov;
+    sqe->len       = 1;
+    sqe->user_data = b - u->blocks;
+    u->sq_array[idx] = idx;
+    atomic_store_explicit((atomic_uint *)u->sq_tail, tail + 1, memory_order_release);
+
+    b->pending = 1;
+    u->to_submit++;
+    u->nb_pending++;
+}
+
+static void uring_queue(FileContext *c, UringBlock *b, int64_t pos)
+{
+    b->pos = pos;
+    b->len = 0;
+    b->err = 0;
+    uring_submit(c, b);
+}
+
+/**
+ * Submit the queued requests and, if wait is set, block until at least one
+ * request has completed.
+ */
+static int uring_enter(FileContext *c, int wait)
+{
+    Uring *u = c->uring;
+    unsigned head, tail;
+    int ret;
+
+    if (u->to_submit || wait) {
+        do {
+            ret = syscall(__NR_io_uring_enter, u->fd, u->to_submit, wait,
+                          wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        } while (ret < 0 && errno == EINTR);
+        if (ret < 0)
+            return AVERROR(errno);
+        u->to_submit -= ret;
+    }
+
+    head = *u->cq_head;
+    tail = atomic_load_explicit((atomic_uint *)u->cq_tail, memory_order_acquire);
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+        UringBlock *b = &u->blocks[cqe->user_data];
+
+        b->pending = 0;
+        u->nb_pending--;
+        if (cqe->res < 0) {
+            b->err = cqe->res;
+            continue;
+        }
+        b->len += cqe->res;
+        /* Reads may complete short before the end of the file, read the
+         * rest of the block. Only a read returning 0 marks the end of the
+         * file. With O_DIRECT an unaligned short read can only happen there
+         * and the rest cannot be read at an unaligned offset anyway. */
+        if (cqe->res > 0 && b->len < u->block_size &&
+            !(c->direct && b->len % URING_ALIGN))
+            uring_submit(c, b);
+    }
+    atomic_store_explicit((atomic_uint *)u->cq_head, head, memory_order_release);
+
+    return 0;
+}
+
+static int uring_wait(FileContext *c, UringBlock *b)
+{
+    int ret;
+
+    while (b->pending)
+        if ((ret = uring_enter(c, 1)) < 0)
+            return ret;
+    return 0;
+}
+
+/* Restart the read-ahead window at the block containing pos. */
+static int uring_reset(FileContext *c, int64_t pos)
+{
+    Uring *u = c->uring;
+    int i, ret;
+
+    /* the buffers of requests in flight cannot be reused */
+    while (u->nb_pending)
+        if ((ret = uring_enter(c, 1)) < 0)
+            return ret;
+
+    u->first      = 0;
+    u->window_pos = pos - pos % u->block_size;
+    for (i = 0; i < u->nb_blocks; i++)
+        uring_queue(c, &u->blocks[i], u->window_pos + (int64_t)i * u->block_size);
+    return uring_enter(c, 0);
+}
+
+static int uring_read(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    Uring *u = c->uring;
+    UringBlock *b;
+    int off, ret;
+
+    if (u->window_pos < 0 || u->pos < u->window_pos ||
+        u->pos >= u->window_pos + (int64_t)u->nb_blocks * u->block_size)
+        if ((ret = uring_reset(c, u->pos)) < 0)
+            return ret;
+
+    /* recycle the blocks before pos to read further ahead */
+    for (;;) {
+        b = &u->blocks[u->first];
+        if ((ret = uring_wait(c, b)) < 0)
+            return ret;
+        if (u->pos < u->window_pos + u->block_size)
+            break;
+        uring_queue(c, b, u->window_pos + (int64_t)u->nb_blocks * u->block_size);
+        u->first       = (u->first + 1) % u->nb_blocks;
+        u->window_pos += u->block_size;
+    }
+    if ((ret = uring_enter(c, 0)) < 0)
+        return ret;
+
+    off = u->pos - u->window_pos;
+    if (off >= b->len) {
+        /* read the block again next time, the file may be growing */
+        ret = b->err    ? AVERROR(-b->err) :
+              c->follow ? AVERROR(EAGAIN)  : AVERROR_EOF;
+        u->window_pos = -1;
+        return ret;
+    }
+
+    size = FFMIN(size, b->len - off);
+    memcpy(buf, b->data + off, size);
+    u->pos += size;
+    return size;
+}
+#endif
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
+#if HAVE_LINUX_IO_URING_H
+    if (c->uring)
+        return uring_read(h, buf, size);
+#endif
     size = FFMIN(size, c->blocksize);
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
@@ -205,12 +502,62 @@ static int file_move(URLContext *h_src, URLContext *h_dst)
 
 #if CONFIG_FILE_PROTOCOL
 
+#if HAVE_MMAP
+static void unmap_file(void *opaque, uint8_t *data)
+{
+    munmap(data, (uintptr_t)opaque);
+}
+
+static int map_file(URLContext *h, int64_t size)
+{
+    FileContext *c = h->priv_data;
+    size_t len = size + AV_INPUT_BUFFER_PADDING_SIZE;
+    uint8_t *data;
+
+    if (size <= 0 || size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR(EINVAL);
+
+    /* reserve room for the padding first, anonymous pages read as zero;
+     * the mapping is private and writable so that packets pointing into it
+     * can be modified in place without touching the file */
+    data = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+        return AVERROR(errno);
+    if (mmap(data, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             c->fd, 0) == MAP_FAILED) {
+        int ret = AVERROR(errno);
+        munmap(data, len);
+        return ret;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(data, size, MADV_SEQUENTIAL);
+#endif
+
+    c->map = av_buffer_create(data, size, unmap_file, (void *)(uintptr_t)len, 0);
+    if (!c->map) {
+        munmap(data, len);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+#endif
+
+static int file_get_mapping(URLContext *h, AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+
+    if (!c->map)
+        return AVERROR(ENOSYS);
+    *buf = av_buffer_ref(c->map);
+    return *buf ? 0 : AVERROR(ENOMEM);
+}
+
 static int file_open(URLContext *h, const char *filename, int flags)
 {
     FileContext *c = h->priv_data;
     int access;
     int fd;
-    struct stat st;
+    struct stat st = { 0 };
 
     av_strstart(filename, "file:", &filename);
 
@@ -228,13 +575,46 @@ static int file_open(URLContext *h, const char *filename, int flags)
 #ifdef O_BINARY
     access |= O_BINARY;
 #endif
-    fd = avpriv_open(filename, access, 0666);
+    fd = -1;
+#if HAVE_LINUX_IO_URING_H
+    if (c->io_uring && c->direct && access == O_RDONLY) {
+        fd = avpriv_open(filename, access | O_DIRECT, 0666);
+        /* not all filesystems support O_DIRECT */
+        if (fd == -1 && errno == EINVAL)
+            av_log(h, AV_LOG_WARNING, "O_DIRECT not supported for %s\n", filename);
+    }
+    c->direct = fd != -1;
+#endif
+    if (fd == -1)
+        fd = avpriv_open(filename, access, 0666);
     if (fd == -1)
         return AVERROR(errno);
     c->fd = fd;
 
     h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
 
+#if HAVE_MMAP
+    if (c->mmap && access == O_RDONLY && !c->follow && S_ISREG(st.st_mode)) {
+        int ret = map_file(h, st.st_size);
+        if (ret < 0)
+            av_log(h, AV_LOG_VERBOSE, "mmap unavailable (%s), using read()\n",
+                   av_err2str(ret));
+    }
+#endif
+
+#if HAVE_LINUX_IO_URING_H
+    if (c->io_uring && access == O_RDONLY && !h->is_streamed && !c->map) {
+        int ret = uring_init(c);
+        if (ret < 0) {
+            av_log(h, AV_LOG_VERBOSE, "io_uring unavailable (%s), using read()\n",
+                   av_err2str(ret));
+            uring_free(c);
+            if (c->direct)
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+        }
+    }
+#endif
+
     /* Buffer writes more than the default 32k to improve throughput especially
      * with networked file systems */
     if (!h->is_streamed && flags & AVIO_FLAG_WRITE)
@@ -258,6 +638,25 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+#if HAVE_LINUX_IO_URING_H
+    /* reads are positioned, only track the offset */
+    if (c->uring) {
+        if (whence == SEEK_CUR) {
+            pos += c->uring->pos;
+        } else if (whence == SEEK_END) {
+            struct stat st;
+            if (fstat(c->fd, &st) < 0)
+                return AVERROR(errno);
+            pos += st.st_size;
+        } else if (whence != SEEK_SET) {
+            return AVERROR(EINVAL);
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        return c->uring->pos = pos;
+    }
+#endif
+
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -266,6 +665,14 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+#if HAVE_LINUX_IO_URING_H
+    Uring *u = c->uring;
+
+    /* the kernel may still be writing into the buffers */
+    while (u && u->nb_pending && uring_enter(c, 1) >= 0);
+    uring_free(c);
+#endif
+    av_buffer_unref(&c->map);
     return close(c->fd);
 }
 
@@ -369,6 +776,7 @@ const URLProtocol ff_file_protocol = {
     .url_open_dir        = file_open_dir,
     .url_read_dir        = file_read_dir,
     .url_close_dir       = file_close_dir,
+    .url_get_mapping     = file_get_mapping,
     .default_whitelist   = "file,crypto,data"
 };
 
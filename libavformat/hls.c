@@ -38,6 +38,7 @@
 #include "internal.h"
 #include "avio_internal.h"
 #include "id3v2.h"
+#include "prefetch.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 
@@ -160,6 +161,12 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* Segment prefetching */
+    Prefetch *prefetch;
+    int prefetch_disabled;
+    /* prefetched data of the current segment, read before pls->input */
+    PrefetchBuffer seg_buf;
 };
 
 /*
@@ -212,6 +219,8 @@ typedef struct HLSContext {
     int http_persistent;
     int http_multiple;
     int http_seekable;
+    int prefetch_segments;
+    int64_t prefetch_size;
     AVIOContext *playlist_pb;
 } HLSContext;
 
@@ -248,6 +257,8 @@ static void free_playlist_list(HLSContext *c)
     int i;
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
+        ff_prefetch_free(&pls->prefetch);
+        ff_prefetch_buffer_free(&pls->seg_buf);
         free_segment_list(pls);
         free_init_section_list(pls);
         av_freep(&pls->main_streams);
@@ -619,8 +630,21 @@ static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
 #endif
 }
 
+/* Prefetch threads open segments with their own interrupt callback, which
+ * also fires once the segment is dropped. They only run with the default
+ * I/O callbacks. */
+static int open_url_io(AVFormatContext *s, AVIOContext **pb, const char *url,
+                       AVDictionary **opts, const AVIOInterruptCB *int_cb)
+{
+    if (int_cb)
+        return ffio_open_whitelist(pb, url, AVIO_FLAG_READ, int_cb, opts,
+                                   s->protocol_whitelist, s->protocol_blacklist);
+    return s->io_open(s, pb, url, AVIO_FLAG_READ, opts);
+}
+
 static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary *opts, AVDictionary *opts2, int *is_http_out)
+                    AVDictionary *opts, AVDictionary *opts2,
+                    const AVIOInterruptCB *int_cb, int *is_http_out)
 {
     HLSContext *c = s->priv_data;
     AVDictionary *tmp = NULL;
@@ -680,10 +704,10 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
                 av_log(s, AV_LOG_WARNING,
                     "keepalive request failed for '%s' with error: '%s' when opening url, retrying with new connection\n",
                     url, av_err2str(ret));
-            ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
+            ret = open_url_io(s, pb, url, &tmp, int_cb);
         }
     } else {
-        ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
+        ret = open_url_io(s, pb, url, &tmp, int_cb);
     }
     if (ret >= 0) {
         // update cookies on http response with setcookies.
@@ -987,7 +1011,7 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    ret = ff_prefetch_buffer_read(&pls->seg_buf, pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1192,7 +1216,11 @@ static void intercept_id3(struct playlist *pls, uint8_t *buf,
         pls->is_id3_timestamped = (pls->id3_mpegts_timestamp != AV_NOPTS_VALUE);
 }
 
-static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg, AVIOContext **in)
+/* Open a segment without touching the read state of the playlist. Only
+ * unencrypted segments can be opened from a prefetch thread. */
+static int open_segment(HLSContext *c, struct playlist *pls, struct segment *seg,
+                        AVDictionary *avio_opts, const AVIOInterruptCB *int_cb,
+                        AVIOContext **in)
 {
     AVDictionary *opts = NULL;
     int ret;
@@ -1212,12 +1240,12 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
            seg->url, seg->url_offset, pls->index);
 
     if (seg->key_type == KEY_NONE) {
-        ret = open_url(pls->parent, in, seg->url, c->avio_opts, opts, &is_http);
+        ret = open_url(pls->parent, in, seg->url, avio_opts, opts, int_cb, &is_http);
     } else if (seg->key_type == KEY_AES_128) {
         char iv[33], key[33], url[MAX_URL_SIZE];
         if (strcmp(seg->key, pls->key_url)) {
             AVIOContext *pb = NULL;
-            if (open_url(pls->parent, &pb, seg->key, c->avio_opts, opts, NULL) == 0) {
+            if (open_url(pls->parent, &pb, seg->key, avio_opts, opts, NULL, NULL) == 0) {
                 ret = avio_read(pb, pls->key, sizeof(pls->key));
                 if (ret != sizeof(pls->key)) {
                     av_log(pls->parent, AV_LOG_ERROR, "Unable to read key file %s\n",
@@ -1241,7 +1269,7 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
         av_dict_set(&opts, "key", key, 0);
         av_dict_set(&opts, "iv", iv, 0);
 
-        ret = open_url(pls->parent, in, url, c->avio_opts, opts, &is_http);
+        ret = open_url(pls->parent, in, url, avio_opts, opts, NULL, &is_http);
         if (ret < 0) {
             goto cleanup;
         }
@@ -1275,6 +1303,12 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
 
 cleanup:
     av_dict_free(&opts);
+    return ret;
+}
+
+static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg, AVIOContext **in)
+{
+    int ret = open_segment(c, pls, seg, c->avio_opts, NULL, in);
     pls->cur_seg_offset = 0;
     return ret;
 }
@@ -1336,6 +1370,77 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     return 0;
 }
 
+static int prefetch_open(void *opaque, const PrefetchSegment *pseg,
+                         AVDictionary **avio_opts, const AVIOInterruptCB *int_cb,
+                         AVIOContext **in)
+{
+    struct playlist *pls = opaque;
+    struct segment seg = {
+        .url_offset = pseg->url_offset,
+        .size       = pseg->size,
+        .url        = pseg->url,
+        .key_type   = KEY_NONE,
+    };
+
+    return open_segment(pls->parent->priv_data, pls, &seg, *avio_opts, int_cb, in);
+}
+
+/* Start downloading the segments following the current one. */
+static void prefetch_schedule(HLSContext *c, struct playlist *pls)
+{
+    PrefetchSegment next[64];
+    int seq_no, n = 0, ret;
+
+    if (c->prefetch_segments <= 0 || pls->prefetch_disabled)
+        return;
+    if (!pls->prefetch &&
+        (ret = ff_prefetch_alloc(&pls->prefetch, pls->parent, c->prefetch_segments,
+                                 c->prefetch_size, prefetch_open, pls)) < 0) {
+        av_log(pls->parent, AV_LOG_WARNING,
+               "Could not start prefetching for playlist %d: %s\n",
+               pls->index, av_err2str(ret));
+        pls->prefetch_disabled = 1;
+        return;
+    }
+
+    for (seq_no = FFMAX(pls->cur_seq_no + 1, pls->start_seq_no);
+         seq_no <= pls->cur_seq_no + c->prefetch_segments &&
+         seq_no <  pls->start_seq_no + pls->n_segments; seq_no++) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+
+        /* fetching keys changes the playlist state, keep them in order */
+        if (seg->key_type != KEY_NONE)
+            continue;
+        next[n++] = (PrefetchSegment) {
+            .url        = seg->url,
+            .url_offset = seg->url_offset,
+            .size       = seg->size,
+            .id         = seq_no,
+        };
+    }
+    ff_prefetch_schedule(pls->prefetch, next, n, c->avio_opts);
+}
+
+/* Make a prefetched copy of the current segment the input of the playlist.
+ * Returns AVERROR(EAGAIN) if the segment has to be opened directly. */
+static int prefetch_take(HLSContext *c, struct playlist *pls, struct segment *seg)
+{
+    PrefetchSegment pseg = {
+        .url        = seg->url,
+        .url_offset = seg->url_offset,
+        .size       = seg->size,
+        .id         = pls->cur_seq_no,
+    };
+    int ret;
+
+    if (!pls->prefetch)
+        return AVERROR(EAGAIN);
+    ret = ff_prefetch_take(pls->prefetch, &pseg, &pls->input, &pls->seg_buf);
+    if (ret >= 0)
+        pls->cur_seg_offset = 0;
+    return ret;
+}
+
 static int64_t default_reload_interval(struct playlist *pls)
 {
     return pls->n_segments > 0 ?
@@ -1466,6 +1571,7 @@ reload:
         }
 
         v->input_read_done = 0;
+        ff_prefetch_buffer_reset(&v->seg_buf);
         seg = current_segment(v);
 
         /* load/update Media Initialization Section, if any */
@@ -1473,7 +1579,9 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (!prefetch_take(c, v, seg)) {
+            ret = 0;
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1491,6 +1599,7 @@ reload:
             goto reload;
         }
         just_opened = 1;
+        prefetch_schedule(c, v);
     }
 
     if (c->http_multiple == -1) {
@@ -1503,7 +1612,7 @@ reload:
     }
 
     seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    if (c->http_multiple == 1 && !v->input_next_requested && !c->prefetch_segments &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1823,6 +1932,12 @@ static int hls_read_header(AVFormatContext *s)
     if ((ret = save_avio_options(s)) < 0)
         goto fail;
 
+    if (c->prefetch_segments > 0 && !ff_format_io_is_default(s)) {
+        av_log(s, AV_LOG_WARNING, "Segment prefetching is disabled with custom "
+               "I/O callbacks\n");
+        c->prefetch_segments = 0;
+    }
+
     /* XXX: Some HLS servers don't like being sent the range header,
        in this case, need to  setting http_seekable = 0 to disable
        the range header */
@@ -2349,6 +2464,10 @@ static const AVOption hls_options[] = {
         OFFSET(http_multiple), AV_OPT_TYPE_BOOL, {.i64 = -1}, -1, 1, FLAGS},
     {"http_seekable", "Use HTTP partial requests, 0 = disable, 1 = enable, -1 = auto",
         OFFSET(http_seekable), AV_OPT_TYPE_BOOL, { .i64 = -1}, -1, 1, FLAGS},
+    {"prefetch_segments", "Number of segments to download ahead per playlist",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_size", "Maximum number of bytes to hold in memory for prefetched segments per playlist",
+        OFFSET(prefetch_size), AV_OPT_TYPE_INT64, {.i64 = 64 * 1024 * 1024}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
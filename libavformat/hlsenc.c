@@ -51,6 +51,7 @@
 #include "hlsplaylist.h"
 #include "internal.h"
 #include "os_support.h"
+#include "uploadqueue.h"
 
 typedef enum {
     HLS_START_SEQUENCE_AS_START_NUMBER = 0,
@@ -240,6 +241,9 @@ typedef struct HLSContext {
     char *headers;
     int has_default_key; /* has DEFAULT field of var_stream_map */
     int has_video_m3u8; /* has video stream m3u8 list */
+    int upload_connections;
+    int64_t upload_queue_size;
+    UploadQueue *upload;
 } HLSContext;
 
 static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
@@ -248,7 +252,9 @@ static int hlsenc_io_open(AVFormatContext *s, AVIOContext **pb, char *filename,
     HLSContext *hls = s->priv_data;
     int http_base_proto = filename ? ff_is_http_proto(filename) : 0;
     int err = AVERROR_MUXER_NOT_FOUND;
-    if (!*pb || !http_base_proto || !hls->http_persistent) {
+    if (hls->upload && http_base_proto) {
+        err = ff_upload_queue_open(hls->upload, pb, filename, options);
+    } else if (!*pb || !http_base_proto || !hls->http_persistent) {
         err = s->io_open(s, pb, filename, AVIO_FLAG_WRITE, options);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -270,7 +276,9 @@ static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
     int ret = 0;
     if (!*pb)
         return ret;
-    if (!http_base_proto || !hls->http_persistent || hls->key_info_file || hls->encrypt) {
+    if (ff_upload_queue_owns(hls->upload, *pb)) {
+        ret = ff_upload_queue_close(hls->upload, pb, 0);
+    } else if (!http_base_proto || !hls->http_persistent || hls->key_info_file || hls->encrypt) {
         ff_format_io_close(s, pb);
 #if CONFIG_HTTP_PROTOCOL
     } else {
@@ -284,6 +292,16 @@ static int hlsenc_io_close(AVFormatContext *s, AVIOContext **pb, char *filename)
     return ret;
 }
 
+/* Playlists are only uploaded once the segments they reference are. */
+static int hlsenc_io_close_playlist(AVFormatContext *s, AVIOContext **pb, char *filename)
+{
+    HLSContext *hls = s->priv_data;
+
+    if (ff_upload_queue_owns(hls->upload, *pb))
+        return ff_upload_queue_close(hls->upload, pb, 1);
+    return hlsenc_io_close(s, pb, filename);
+}
+
 static void set_http_options(AVFormatContext *s, AVDictionary **options, HLSContext *c)
 {
     int http_base_proto = ff_is_http_proto(s->url);
@@ -566,12 +584,17 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         proto = avio_find_protocol_name(s->url);
         if (hls->method || (proto && !av_strcasecmp(proto, "http"))) {
             av_dict_set(&options, "method", "DELETE", 0);
-            if ((ret = vs->avf->io_open(vs->avf, &out, path, AVIO_FLAG_WRITE, &options)) < 0) {
-                if (hls->ignore_io_errors)
-                    ret = 0;
-                goto fail;
+            if (hls->upload) {
+                if ((ret = ff_upload_queue_delete(hls->upload, path, &options)) < 0)
+                    goto fail;
+            } else {
+                if ((ret = vs->avf->io_open(vs->avf, &out, path, AVIO_FLAG_WRITE, &options)) < 0) {
+                    if (hls->ignore_io_errors)
+                        ret = 0;
+                    goto fail;
+                }
+                ff_format_io_close(vs->avf, &out);
             }
-            ff_format_io_close(vs->avf, &out);
         } else if (unlink(path) < 0) {
             av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
                    path, strerror(errno));
@@ -593,13 +616,20 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
 
             if (hls->method || (proto && !av_strcasecmp(proto, "http"))) {
                 av_dict_set(&options, "method", "DELETE", 0);
-                if ((ret = vs->vtt_avf->io_open(vs->vtt_avf, &out, sub_path, AVIO_FLAG_WRITE, &options)) < 0) {
-                    if (hls->ignore_io_errors)
-                        ret = 0;
-                    av_freep(&sub_path);
-                    goto fail;
+                if (hls->upload) {
+                    if ((ret = ff_upload_queue_delete(hls->upload, sub_path, &options)) < 0) {
+                        av_freep(&sub_path);
+                        goto fail;
+                    }
+                } else {
+                    if ((ret = vs->vtt_avf->io_open(vs->vtt_avf, &out, sub_path, AVIO_FLAG_WRITE, &options)) < 0) {
+                        if (hls->ignore_io_errors)
+                            ret = 0;
+                        av_freep(&sub_path);
+                        goto fail;
+                    }
+                    ff_format_io_close(vs->vtt_avf, &out);
                 }
-                ff_format_io_close(vs->vtt_avf, &out);
             } else if (unlink(sub_path) < 0) {
                 av_log(hls, AV_LOG_ERROR, "failed to delete old segment %s: %s\n",
                        sub_path, strerror(errno));
@@ -617,6 +647,7 @@ fail:
     av_freep(&dirname_r);
     av_freep(&dirname_repl);
     av_freep(&vtt_dirname_r);
+    av_dict_free(&options);
 
     return ret;
 }
@@ -1413,7 +1444,7 @@ static int create_master_playlist(AVFormatContext *s,
 fail:
     if (ret >=0)
         hls->master_m3u8_created = 1;
-    hlsenc_io_close(s, &hls->m3u8_out, temp_filename);
+    hlsenc_io_close_playlist(s, &hls->m3u8_out, temp_filename);
     if (use_temp_file)
         ff_rename(temp_filename, hls->master_m3u8_url, s);
 
@@ -1534,11 +1565,11 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 
 fail:
     av_dict_free(&options);
-    ret = hlsenc_io_close(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename);
+    ret = hlsenc_io_close_playlist(s, byterange_mode ? &hls->m3u8_out : &vs->out, temp_filename);
     if (ret < 0) {
         return ret;
     }
-    hlsenc_io_close(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name);
+    hlsenc_io_close_playlist(s, &hls->sub_m3u8_out, vs->vtt_m3u8_name);
     if (use_temp_file) {
         ff_rename(temp_filename, vs->m3u8_name, s);
         if (vs->vtt_m3u8_name)
@@ -2557,7 +2588,8 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 vs->start_pos = range_length;
                 byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
                 if (!byterange_mode) {
-                    ff_format_io_close(s, &vs->out);
+                    if (!ff_upload_queue_owns(hls->upload, vs->out))
+                        ff_format_io_close(s, &vs->out);
                     hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
                 }
             }
@@ -2596,6 +2628,7 @@ static int hls_write_trailer(struct AVFormatContext *s)
 
 failed:
         av_freep(&filename);
+        av_dict_free(&options);
         av_write_trailer(oc);
         if (oc->url[0]) {
             proto = avio_find_protocol_name(oc->url);
@@ -2622,7 +2655,10 @@ failed:
             if (vtt_oc->pb)
                 av_write_trailer(vtt_oc);
             vs->size = avio_tell(vs->vtt_avf->pb) - vs->start_pos;
-            ff_format_io_close(s, &vtt_oc->pb);
+            if (ff_upload_queue_owns(hls->upload, vtt_oc->pb))
+                hlsenc_io_close(s, &vtt_oc->pb, vtt_oc->url);
+            else
+                ff_format_io_close(s, &vtt_oc->pb);
         }
         ret = hls_window(s, 1, vs);
         if (ret < 0) {
@@ -2635,6 +2671,14 @@ failed:
         av_free(old_filename);
     }
 
+    ret = 0;
+    if (hls->upload) {
+        ret = ff_upload_queue_flush(hls->upload);
+        ff_upload_queue_free(&hls->upload);
+        if (hls->ignore_io_errors)
+            ret = 0;
+    }
+
     hls_free_variant_streams(hls);
 
     for (i = 0; i < hls->nb_ccstreams; i++) {
@@ -2650,7 +2694,7 @@ failed:
     av_freep(&hls->var_streams);
     av_freep(&hls->cc_streams);
     av_freep(&hls->master_m3u8_url);
-    return 0;
+    return ret;
 }
 
 
@@ -2685,6 +2729,23 @@ static int hls_init(AVFormatContext *s)
         goto fail;
     }
 
+    if (hls->upload_connections > 0 && !ff_format_io_is_default(s)) {
+        av_log(s, AV_LOG_WARNING, "upload_connections is ignored with custom"
+               " I/O callbacks, uploading synchronously\n");
+        hls->upload_connections = 0;
+    }
+    if (hls->upload_connections > 0) {
+        ret = ff_upload_queue_alloc(&hls->upload, s, hls->upload_connections,
+                                    hls->upload_queue_size, hls->http_persistent);
+        if (ret == AVERROR(ENOSYS)) {
+            av_log(s, AV_LOG_WARNING, "upload_connections requires threads,"
+                   " uploading synchronously\n");
+        } else if (ret < 0) {
+            goto fail;
+        }
+        ret = 0;
+    }
+
     if (!hls->method && http_base_proto) {
         av_log(hls, AV_LOG_WARNING, "No HTTP method set, hls muxer defaulting to method PUT.\n");
     }
@@ -2965,6 +3026,14 @@ fail:
     return ret;
 }
 
+static void hls_deinit(AVFormatContext *s)
+{
+    HLSContext *hls = s->priv_data;
+
+    /* stop the uploads if muxing is aborted before the trailer */
+    ff_upload_queue_free(&hls->upload);
+}
+
 #define OFFSET(x) offsetof(HLSContext, x)
 #define E AV_OPT_FLAG_ENCODING_PARAM
 static const AVOption options[] = {
@@ -3030,6 +3099,8 @@ static const AVOption options[] = {
     {"master_pl_name", "Create HLS master playlist with this name", OFFSET(master_pl_name), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
     {"master_pl_publish_rate", "Publish master play list every after this many segment intervals", OFFSET(master_publish_rate), AV_OPT_TYPE_INT, {.i64 = 0}, 0, UINT_MAX, E},
     {"http_persistent", "Use persistent HTTP connections", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
+    {"upload_connections", "Upload files over HTTP in the background using this many connections", OFFSET(upload_connections), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, 64, E },
+    {"upload_queue_size", "Maximum size of the files waiting for a background upload", OFFSET(upload_queue_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20 }, 0, INT64_MAX, E },
     {"timeout", "set timeout for socket I/O operations", OFFSET(timeout), AV_OPT_TYPE_DURATION, { .i64 = -1 }, -1, INT_MAX, .flags = E },
     {"ignore_io_errors", "Ignore IO errors for stable long-duration runs with network output", OFFSET(ignore_io_errors), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, E },
     {"headers", "set custom HTTP headers, can override built in default headers", OFFSET(headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
@@ -3057,5 +3128,6 @@ AVOutputFormat ff_hls_muxer = {
     .write_header   = hls_write_header,
     .write_packet   = hls_write_packet,
     .write_trailer  = hls_write_trailer,
+    .deinit         = hls_deinit,
     .priv_class     = &hls_class,
 };
@@ -0,0 +1,304 @@
+/*
+ * Persistent seek index cache
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Sidecar file holding the index entries of all streams of an input, so that
+ * indexes found by scanning or by timestamp searches survive reopening.
+ *
+ * Layout, all values little-endian:
+ *   "FFIC", version
+ *   input size, modification time, CRC of the first and last 64 KiB
+ *   number of streams, then for each stream:
+ *     codec id, time base, number of entries, and for each entry:
+ *       position, timestamp, size and flags, minimum distance
+ */
+
+#include <sys/stat.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/crc.h"
+#include "libavutil/intreadwrite.h"
+#include "avformat.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "url.h"
+
+#define INDEX_CACHE_VERSION 1
+#define HASH_SIZE           65536
+#define ENTRY_SIZE          24
+
+static int64_t input_mtime(AVFormatContext *s)
+{
+    const char *filename = s->url;
+    const char *proto    = avio_find_protocol_name(filename);
+    struct stat st;
+
+    if (!proto || strcmp(proto, "file"))
+        return 0;
+    av_strstart(filename, "file:", &filename);
+    if (stat(filename, &st) < 0)
+        return 0;
+    return st.st_mtime;
+}
+
+static int hash_block(AVIOContext *pb, int64_t pos, int size, uint32_t *crc)
+{
+    uint8_t *buf;
+    int ret;
+
+    if ((ret = avio_seek(pb, pos, SEEK_SET)) < 0)
+        return ret;
+    if (!(buf = av_malloc(size)))
+        return AVERROR(ENOMEM);
+    ret = ffio_read_size(pb, buf, size);
+    if (ret >= 0)
+        *crc = av_crc(av_crc_get_table(AV_CRC_32_IEEE), *crc, buf, size);
+    av_free(buf);
+    return ret;
+}
+
+/**
+ * Identify the input by size, modification time and a hash of its first
+ * and last blocks.
+ */
+static int compute_key(AVFormatContext *s)
+{
+    AVFormatInternal *in = s->internal;
+    int64_t pos  = avio_tell(s->pb);
+    int64_t size = avio_size(s->pb);
+    uint32_t crc = 0;
+    int ret;
+
+    if (size <= 0 || !(s->pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return AVERROR(ENOSYS);
+
+    ret = hash_block(s->pb, 0, FFMIN(size, HASH_SIZE), &crc);
+    if (ret >= 0 && size > HASH_SIZE)
+        ret = hash_block(s->pb, FFMAX(size - HASH_SIZE, HASH_SIZE),
+                         FFMIN(size - HASH_SIZE, HASH_SIZE), &crc);
+    avio_seek(s->pb, pos, SEEK_SET);
+    if (ret < 0)
+        return ret;
+
+    in->index_cache_size  = size;
+    in->index_cache_mtime = input_mtime(s);
+    in->index_cache_crc   = crc;
+    return 0;
+}
+
+static int nb_entries_total(AVFormatContext *s)
+{
+    int i, nb = 0;
+
+    for (i = 0; i < s->nb_streams; i++)
+        nb += s->streams[i]->nb_index_entries;
+    return nb;
+}
+
+/**
+ * Read and check the entries of one stream into a new array, which is
+ * only handed to the stream once all streams of the cache are valid.
+ */
+static int read_stream_entries(AVIOContext *pb, unsigned nb, AVIndexEntry **out)
+{
+    int64_t left = avio_size(pb) - avio_tell(pb);
+    AVIndexEntry *entries;
+    int64_t last = INT64_MIN;
+    unsigned i;
+
+    *out = NULL;
+    /* the count is untrusted, check it against the file before allocating */
+    if (left < 0 || nb > left / ENTRY_SIZE || nb >= UINT_MAX / sizeof(*entries))
+        return AVERROR_INVALIDDATA;
+    if (!nb)
+        return 0;
+    if (!(entries = av_malloc_array(nb, sizeof(*entries))))
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb; i++) {
+        AVIndexEntry *ie = &entries[i];
+        unsigned size_flags;
+
+        ie->pos          = avio_rl64(pb);
+        ie->timestamp    = avio_rl64(pb);
+        size_flags       = avio_rl32(pb);
+        ie->min_distance = avio_rl32(pb);
+        ie->size         = size_flags & 0x3FFFFFFF;
+        ie->flags        = size_flags >> 30;
+        if (ie->timestamp <= last || ie->timestamp == AV_NOPTS_VALUE)
+            break;
+        last = ie->timestamp;
+    }
+    if (i < nb || pb->eof_reached) {
+        av_free(entries);
+        return AVERROR_INVALIDDATA;
+    }
+    *out = entries;
+    return 0;
+}
+
+int ff_index_cache_load(AVFormatContext *s)
+{
+    AVFormatInternal *in = s->internal;
+    AVDictionary *opts = NULL;
+    AVIOContext *pb;
+    AVIndexEntry **entries = NULL;
+    unsigned *nb_entries = NULL;
+    unsigned nb_streams;
+    int i, ret;
+
+    if (!s->index_cache || !*s->index_cache || !s->pb || in->index_cache_loaded ||
+        !(s->iformat->flags_internal & FF_FMT_FLAG_SEEK_INDEX))
+        return 0;
+    in->index_cache_loaded = 1;
+
+    if ((ret = compute_key(s)) < 0) {
+        av_log(s, AV_LOG_VERBOSE, "Not using the index cache: %s\n",
+               av_err2str(ret));
+        return 0;
+    }
+    in->index_cache_valid = 1;
+
+    av_dict_set(&opts, "mmap", "1", 0);
+    ret = s->io_open(s, &pb, s->index_cache, AVIO_FLAG_READ, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        av_log(s, AV_LOG_VERBOSE, "No index cache in %s\n", s->index_cache);
+        return 0;
+    }
+
+    if (avio_rl32(pb) != MKTAG('F', 'F', 'I', 'C') ||
+        avio_rl32(pb) != INDEX_CACHE_VERSION ||
+        avio_rl64(pb) != in->index_cache_size ||
+        avio_rl64(pb) != in->index_cache_mtime ||
+        avio_rl32(pb) != in->index_cache_crc) {
+        av_log(s, AV_LOG_VERBOSE, "Index cache %s is stale\n", s->index_cache);
+        goto end;
+    }
+
+    nb_streams = avio_rl32(pb);
+    if (nb_streams != s->nb_streams)
+        goto invalid;
+    if (!(entries = av_mallocz_array(s->nb_streams, sizeof(*entries))) ||
+        !(nb_entries = av_mallocz_array(s->nb_streams, sizeof(*nb_entries))))
+        goto end;
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st     = s->streams[i];
+        unsigned codec_id = avio_rl32(pb);
+        AVRational tb;
+
+        tb.num        = avio_rl32(pb);
+        tb.den        = avio_rl32(pb);
+        nb_entries[i] = avio_rl32(pb);
+        if (codec_id != st->codecpar->codec_id ||
+            av_cmp_q(tb, st->time_base))
+            goto invalid;
+        if ((ret = read_stream_entries(pb, nb_entries[i], &entries[i])) < 0)
+            goto invalid;
+    }
+
+    /* never mix the cached entries into an index the demuxer started */
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+
+        if (st->nb_index_entries || !entries[i])
+            continue;
+        av_free(st->index_entries);
+        st->index_entries                = entries[i];
+        st->index_entries_allocated_size = nb_entries[i] * sizeof(*entries[i]);
+        st->nb_index_entries             = nb_entries[i];
+        entries[i] = NULL;
+    }
+    in->index_cache_nb_entries = nb_entries_total(s);
+    av_log(s, AV_LOG_VERBOSE, "Loaded %d index entries from %s\n",
+           in->index_cache_nb_entries, s->index_cache);
+    goto end;
+
+invalid:
+    av_log(s, AV_LOG_WARNING, "Index cache %s does not match the input\n",
+           s->index_cache);
+end:
+    if (entries) {
+        for (i = 0; i < s->nb_streams; i++)
+            av_free(entries[i]);
+        av_free(entries);
+    }
+    av_free(nb_entries);
+    ff_format_io_close(s, &pb);
+    return 0;
+}
+
+int ff_index_cache_save(AVFormatContext *s)
+{
+    AVFormatInternal *in = s->internal;
+    AVIOContext *pb;
+    char *tmp;
+    int i, j, ret;
+
+    /* keep what an earlier session found if this one never seeked */
+    ff_index_cache_load(s);
+    if (!s->index_cache || !*s->index_cache || !in->index_cache_valid ||
+        nb_entries_total(s) <= in->index_cache_nb_entries)
+        return 0;
+
+    if (!(tmp = av_asprintf("%s.tmp", s->index_cache)))
+        return AVERROR(ENOMEM);
+    if ((ret = s->io_open(s, &pb, tmp, AVIO_FLAG_WRITE, NULL)) < 0) {
+        av_log(s, AV_LOG_WARNING, "Could not write the index cache %s: %s\n",
+               tmp, av_err2str(ret));
+        goto end;
+    }
+
+    ffio_wfourcc(pb, "FFIC");
+    avio_wl32(pb, INDEX_CACHE_VERSION);
+    avio_wl64(pb, in->index_cache_size);
+    avio_wl64(pb, in->index_cache_mtime);
+    avio_wl32(pb, in->index_cache_crc);
+    avio_wl32(pb, s->nb_streams);
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+
+        avio_wl32(pb, st->codecpar->codec_id);
+        avio_wl32(pb, st->time_base.num);
+        avio_wl32(pb, st->time_base.den);
+        avio_wl32(pb, st->nb_index_entries);
+        for (j = 0; j < st->nb_index_entries; j++) {
+            const AVIndexEntry *ie = &st->index_entries[j];
+
+            avio_wl64(pb, ie->pos);
+            avio_wl64(pb, ie->timestamp);
+            avio_wl32(pb, ie->size | (ie->flags & 3U) << 30);
+            avio_wl32(pb, ie->min_distance);
+        }
+    }
+    avio_flush(pb);
+    ret = pb->error;
+    ff_format_io_close(s, &pb);
+
+    if (ret >= 0)
+        ret = ff_rename(tmp, s->index_cache, s);
+    if (ret < 0)
+        av_log(s, AV_LOG_WARNING, "Could not write the index cache %s: %s\n",
+               s->index_cache, av_err2str(ret));
+end:
+    av_free(tmp);
+    return ret;
+}
@@ -142,6 +142,17 @@ struct AVFormatInternal {
      * Prefer the codec framerate for avg_frame_rate computation.
      */
     int prefer_codec_framerate;
+
+    /**
+     * Identity of the input and number of index entries after loading
+     * the index cache, see indexcache.c.
+     */
+    int      index_cache_loaded;
+    int      index_cache_valid;
+    int64_t  index_cache_size;
+    int64_t  index_cache_mtime;
+    uint32_t index_cache_crc;
+    int      index_cache_nb_entries;
 };
 
 struct AVStreamInternal {
@@ -588,6 +599,21 @@ int ff_stream_encode_params_copy(AVStream *dst, const AVStream *src);
  */
 int ff_rename(const char *url_src, const char *url_dst, void *logctx);
 
+/**
+ * Add the index entries stored in the AVFormatContext.index_cache file to
+ * the streams which have no index entries yet, if it was written for the
+ * same input and the demuxer sets FF_FMT_FLAG_SEEK_INDEX.
+ * Only the first call does anything, it is made before the first seek so
+ * that streams found while probing are known.
+ */
+int ff_index_cache_load(AVFormatContext *s);
+
+/**
+ * Write the index entries of all streams to the AVFormatContext.index_cache
+ * file, if they grew since ff_index_cache_load().
+ */
+int ff_index_cache_save(AVFormatContext *s);
+
 /**
  * Allocate extradata with additional AV_INPUT_BUFFER_PADDING_SIZE at end
  * which is always set to 0.
@@ -658,6 +684,13 @@ int ff_format_output_open(AVFormatContext *s, const char *url, AVDictionary **op
  */
 void ff_format_io_close(AVFormatContext *s, AVIOContext **pb);
 
+/**
+ * Check whether AVFormatContext.io_open and io_close are the default
+ * callbacks. Only then may they be called from other threads than the one
+ * calling into the (de)muxer, see AVFormatContext.io_open.
+ */
+int ff_format_io_is_default(AVFormatContext *s);
+
 /**
  * Utility function to check if the file uses http or https protocol
  *
@@ -740,6 +773,18 @@ int ff_unlock_avformat(void);
  */
 void ff_format_set_url(AVFormatContext *s, char *url);
 
+/**
+ * The demuxer makes packets read with av_get_packet() writable before
+ * modifying their data, so they may point into the I/O buffer.
+ */
+#define FF_FMT_FLAG_ZERO_COPY (1 << 0)
+
+/**
+ * The index entries of the demuxer are only used to find seek points, never
+ * to locate the packets read, so they may be taken from the index cache.
+ */
+#define FF_FMT_FLAG_SEEK_INDEX (1 << 1)
+
 #define FF_PACKETLIST_FLAG_REF_PACKET (1 << 0) /**< Create a new reference for the packet instead of
                                                     transferring the ownership of the existing one to the
                                                     list. */
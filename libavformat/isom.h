@@ -154,6 +154,27 @@ typedef struct MOVIndexRange {
     int64_t end;
 } MOVIndexRange;
 
+/** position of the sample table walk building the index of a track */
+typedef struct MOVIndexState {
+    unsigned int chunk;
+    unsigned int chunk_samples_left;
+    int64_t offset;       ///< position of the next sample
+    unsigned int current_sample;
+    unsigned int stts_index;
+    unsigned int stts_sample;
+    unsigned int stsc_index;
+    unsigned int stss_index;
+    unsigned int stps_index;
+    unsigned int distance;
+    unsigned int rap_group_index;
+    unsigned int rap_group_sample;
+    int64_t current_dts;
+    int64_t last_dts;
+    int64_t dts_correction;
+    uint64_t stream_size;
+    unsigned int stsz_sample_size;
+} MOVIndexState;
+
 typedef struct MOVStreamContext {
     AVIOContext *pb;
     int pb_is_copied;
@@ -192,6 +213,8 @@ typedef struct MOVStreamContext {
     int64_t current_index;
     MOVIndexRange* index_ranges;
     MOVIndexRange* current_index_range;
+    int lazy_index;       ///< the index is extended from the sample tables while reading
+    MOVIndexState index_state;
     unsigned int bytes_per_frame;
     unsigned int samples_per_frame;
     int dv_audio_container;
@@ -266,6 +289,7 @@ typedef struct MOVContext {
     int use_absolute_path;
     int ignore_editlist;
     int advanced_editlist;
+    int lazy_index;
     int ignore_chapters;
     int seek_individually;
     int64_t next_root_atom; ///< offset of the next root atom
@@ -44,6 +44,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/time_internal.h"
 #include "libavutil/spherical.h"
+#include "libavutil/thread.h"
 
 #include "libavcodec/bytestream.h"
 #include "libavcodec/flac.h"
@@ -336,6 +337,45 @@ typedef struct MatroskaLevel1Element {
     int parsed;
 } MatroskaLevel1Element;
 
+/* A level 1 element, or a part of one, read ahead by the prefetch thread. */
+typedef struct MatroskaPrefetchUnit {
+    int64_t pos;
+    uint8_t *data;
+    int size;
+    int element_end;        ///< the unit ends a level 1 element
+    struct MatroskaPrefetchUnit *next;
+} MatroskaPrefetchUnit;
+
+/*
+ * Clusters read ahead from a separate input by a helper thread. The demuxer
+ * parses them through pb, which is exchanged with the input of the demuxer
+ * while packets are read.
+ */
+typedef struct MatroskaPrefetch {
+    AVFormatContext *s;
+    AVIOContext *in;        ///< only used by the thread
+    AVIOContext *pb;        ///< only used by the demuxer
+    AVIOInterruptCB int_cb;
+    int max_units;
+    int64_t max_size;
+    int64_t file_size;
+#if HAVE_THREADS
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+    MatroskaPrefetchUnit *head, **tail;
+    int nb_units;           ///< number of level 1 elements ended in the queue
+    int64_t size;           ///< bytes in the queue
+    int64_t pos;            ///< position of the next byte read from pb
+    int64_t fetch_pos;      ///< position the thread (re)starts from
+    int generation;         ///< incremented when the thread has to restart
+    int fetch_generation;   ///< generation the thread is reading for
+    int eof;
+    int error;
+    int abort;
+} MatroskaPrefetch;
+
 typedef struct MatroskaDemuxContext {
     const AVClass *class;
     AVFormatContext *ctx;
@@ -386,6 +426,11 @@ typedef struct MatroskaDemuxContext {
 
     /* Bandwidth value for WebM DASH Manifest */
     int bandwidth;
+
+    /* Cluster prefetching */
+    int prefetch_clusters;
+    int64_t prefetch_size;
+    MatroskaPrefetch *prefetch;
 } MatroskaDemuxContext;
 
 #define CHILD_OF(parent) { .def = { .n = parent } }
@@ -2782,6 +2827,380 @@ static int matroska_parse_tracks(AVFormatContext *s)
     return 0;
 }
 
+#if HAVE_THREADS
+#define PREFETCH_CHUNK_SIZE (256 * 1024)
+#define PREFETCH_IO_SIZE    32768
+
+static void prefetch_pop_unit(MatroskaPrefetch *p)
+{
+    MatroskaPrefetchUnit *unit = p->head;
+
+    p->head = unit->next;
+    if (!p->head)
+        p->tail = &p->head;
+    p->size     -= unit->size;
+    p->nb_units -= unit->element_end;
+    av_free(unit->data);
+    av_free(unit);
+}
+
+/* Interrupt a blocked read of the thread once its data is not wanted anymore. */
+static int prefetch_interrupt(void *opaque)
+{
+    MatroskaPrefetch *p = opaque;
+    int cancel;
+
+    pthread_mutex_lock(&p->mutex);
+    cancel = p->abort || p->generation != p->fetch_generation;
+    pthread_mutex_unlock(&p->mutex);
+    return cancel || ff_check_interrupt(&p->s->interrupt_callback);
+}
+
+/*
+ * Parse the ID and length of an EBML element from memory.
+ * Returns the size of the header, < 0 if it is invalid or the length unknown.
+ */
+static int prefetch_parse_header(const uint8_t *buf, int size, uint64_t *length)
+{
+    int id_len, len, n;
+
+    if (size < 1 || !buf[0] || (id_len = 8 - ff_log2_tab[buf[0]]) > 4 ||
+        size <= id_len || !buf[id_len])
+        return AVERROR_INVALIDDATA;
+    len = 8 - ff_log2_tab[buf[id_len]];
+    if (size < id_len + len)
+        return AVERROR_INVALIDDATA;
+
+    *length = buf[id_len] & (0xff >> len);
+    for (n = 1; n < len; n++)
+        *length = (*length << 8) | buf[id_len + n];
+    if (*length == (1ULL << 7 * len) - 1)
+        return AVERROR_INVALIDDATA;
+
+    return id_len + len;
+}
+
+/*
+ * Read the unit starting at pos: the whole level 1 element starting there if
+ * it is small enough, a chunk of data otherwise. *end is the end of the
+ * element being read in chunks, 0 at the start of an element and -1 once
+ * the element boundaries are unknown.
+ */
+static int prefetch_read_unit(MatroskaPrefetch *p, int64_t pos, int64_t *end,
+                              MatroskaPrefetchUnit **punit)
+{
+    MatroskaPrefetchUnit *unit;
+    uint8_t header[12];
+    uint64_t length;
+    int64_t size = PREFETCH_CHUNK_SIZE;
+    int header_size = 0, whole = 0, ret;
+
+    if (!*end) {
+        header_size = avio_read(p->in, header, sizeof(header));
+        if (header_size < 0)
+            return header_size;
+        ret = prefetch_parse_header(header, header_size, &length);
+        if (ret >= 0 && length <= FFMIN(p->max_size, INT_MAX) - ret) {
+            size  = ret + length;
+            whole = 1;
+        } else {
+            *end = ret >= 0 ? pos + ret + length : -1;
+        }
+    }
+    if (*end > 0)
+        size = FFMIN(size, *end - pos);
+    if (header_size > size) {
+        /* the header buffer extends into the next element */
+        int64_t err = avio_seek(p->in, pos + size, SEEK_SET);
+        if (err < 0)
+            return err;
+        header_size = size;
+    }
+
+    if (!(unit = av_mallocz(sizeof(*unit))))
+        return AVERROR(ENOMEM);
+    if (!(unit->data = av_malloc(size))) {
+        av_free(unit);
+        return AVERROR(ENOMEM);
+    }
+    memcpy(unit->data, header, header_size);
+    ret = size > header_size ?
+          avio_read(p->in, unit->data + header_size, size - header_size) : 0;
+    if (ret < 0 && ret != AVERROR_EOF) {
+        av_free(unit->data);
+        av_free(unit);
+        return ret;
+    }
+    unit->pos  = pos;
+    unit->size = header_size + FFMAX(ret, 0);
+    if (!unit->size) {
+        av_free(unit->data);
+        av_free(unit);
+        return AVERROR_EOF;
+    }
+
+    if (whole || (*end > 0 && pos + unit->size >= *end)) {
+        unit->element_end = 1;
+        *end = 0;
+    }
+    *punit = unit;
+    return 0;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    MatroskaPrefetch *p = arg;
+    int64_t pos = 0, end = 0;
+    int started = 0;
+
+    pthread_mutex_lock(&p->mutex);
+    while (!p->abort) {
+        MatroskaPrefetchUnit *unit = NULL;
+        int generation, restart = 0, ret = 0;
+
+        if (!started || p->fetch_generation != p->generation) {
+            p->fetch_generation = p->generation;
+            pos     = p->fetch_pos;
+            end     = 0;
+            restart = started = 1;
+        } else if (p->eof || p->error ||
+                   (p->head && (p->nb_units >= p->max_units || p->size >= p->max_size))) {
+            pthread_cond_wait(&p->cond, &p->mutex);
+            continue;
+        }
+        generation = p->generation;
+        pthread_mutex_unlock(&p->mutex);
+
+        if (restart) {
+            int64_t err = avio_seek(p->in, pos, SEEK_SET);
+            if (err < 0)
+                ret = err;
+            p->in->error = 0;
+        }
+        if (ret >= 0)
+            ret = prefetch_read_unit(p, pos, &end, &unit);
+
+        pthread_mutex_lock(&p->mutex);
+        if (generation != p->generation) {
+            if (unit)
+                av_free(unit->data);
+            av_free(unit);
+            continue;
+        }
+        if (ret == AVERROR_EOF) {
+            p->eof = 1;
+        } else if (ret < 0) {
+            p->error = ret;
+        } else {
+            *p->tail     = unit;
+            p->tail      = &unit->next;
+            p->size     += unit->size;
+            p->nb_units += unit->element_end;
+            pos         += unit->size;
+        }
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->mutex);
+    return NULL;
+}
+
+static int prefetch_read(void *opaque, uint8_t *buf, int buf_size)
+{
+    MatroskaPrefetch *p = opaque;
+    MatroskaPrefetchUnit *unit;
+    int ret;
+
+    pthread_mutex_lock(&p->mutex);
+    while (!(unit = p->head) || p->pos >= unit->pos + unit->size) {
+        if (unit) {
+            prefetch_pop_unit(p);
+            pthread_cond_broadcast(&p->cond);
+        } else if (p->error || p->eof) {
+            ret = p->error ? p->error : AVERROR_EOF;
+            pthread_mutex_unlock(&p->mutex);
+            return ret;
+        } else {
+            pthread_cond_wait(&p->cond, &p->mutex);
+        }
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    /* the head unit is only removed by the demuxer */
+    ret = FFMIN(buf_size, unit->pos + unit->size - p->pos);
+    memcpy(buf, unit->data + p->pos - unit->pos, ret);
+    p->pos += ret;
+    return ret;
+}
+
+static int64_t prefetch_seek(void *opaque, int64_t offset, int whence)
+{
+    MatroskaPrefetch *p = opaque;
+    MatroskaPrefetchUnit *unit;
+
+    if (whence == AVSEEK_SIZE)
+        return p->file_size >= 0 ? p->file_size : AVERROR(ENOSYS);
+    if (whence == SEEK_END) {
+        if (p->file_size < 0)
+            return AVERROR(ENOSYS);
+        offset += p->file_size;
+    } else if (whence == SEEK_CUR) {
+        offset += p->pos;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (offset < 0)
+        return AVERROR(EINVAL);
+
+    pthread_mutex_lock(&p->mutex);
+    for (unit = p->head; unit && unit->pos + unit->size <= offset; unit = unit->next)
+        ;
+    if (unit && offset >= p->head->pos) {
+        /* the target has been prefetched */
+        while (p->head != unit)
+            prefetch_pop_unit(p);
+    } else if (p->head || offset != p->pos) {
+        /* restart from the target, which is usually the cluster a seek
+         * through the Cues points to */
+        while (p->head)
+            prefetch_pop_unit(p);
+        p->fetch_pos = offset;
+        p->generation++;
+        p->eof       = 0;
+        p->error     = 0;
+    }
+    p->pos = offset;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+
+    return offset;
+}
+
+static void matroska_prefetch_free(MatroskaDemuxContext *matroska)
+{
+    MatroskaPrefetch *p = matroska->prefetch;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->mutex);
+    p->abort = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+    pthread_join(p->thread, NULL);
+
+    while (p->head)
+        prefetch_pop_unit(p);
+    avio_closep(&p->in);
+    if (p->pb)
+        av_freep(&p->pb->buffer);
+    avio_context_free(&p->pb);
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+    av_freep(&matroska->prefetch);
+}
+
+/*
+ * Start reading the clusters ahead from a separate input, from the level 1
+ * element the demuxer is in.
+ */
+static int matroska_prefetch_init(AVFormatContext *s)
+{
+    static const char * const avio_opts[] = {
+        "headers", "http_proxy", "user_agent", "cookies", "referer", "rw_timeout", "icy", NULL };
+    MatroskaDemuxContext *matroska = s->priv_data;
+    MatroskaPrefetch *p;
+    AVDictionary *opts = NULL;
+    int64_t pos = avio_tell(s->pb), start = pos, err;
+    uint8_t *buf;
+    int i, ret;
+
+    if (s->flags & AVFMT_FLAG_CUSTOM_IO || !s->url ||
+        !(s->pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return AVERROR(ENOSYS);
+    if (matroska->current_id)
+        start -= (av_log2(matroska->current_id) + 7) / 8;
+
+    if (!(p = av_mallocz(sizeof(*p))))
+        return AVERROR(ENOMEM);
+    if ((ret = pthread_mutex_init(&p->mutex, NULL))) {
+        av_free(p);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&p->cond, NULL))) {
+        pthread_mutex_destroy(&p->mutex);
+        av_free(p);
+        return AVERROR(ret);
+    }
+    p->s               = s;
+    p->max_units       = matroska->prefetch_clusters;
+    p->max_size        = matroska->prefetch_size;
+    p->file_size       = avio_size(s->pb);
+    p->tail            = &p->head;
+    p->pos             = start;
+    p->fetch_pos       = start;
+    p->int_cb.callback = prefetch_interrupt;
+    p->int_cb.opaque   = p;
+    matroska->prefetch = p;
+
+    for (i = 0; avio_opts[i]; i++) {
+        if (av_opt_get(s->pb, avio_opts[i], AV_OPT_SEARCH_CHILDREN | AV_OPT_ALLOW_NULL,
+                       &buf) >= 0 &&
+            (ret = av_dict_set(&opts, avio_opts[i], buf, AV_DICT_DONT_STRDUP_VAL)) < 0)
+            goto fail;
+    }
+    ret = ffio_open_whitelist(&p->in, s->url, AVIO_FLAG_READ, &p->int_cb, &opts,
+                              s->protocol_whitelist, s->protocol_blacklist);
+    av_dict_free(&opts);
+    if (ret < 0)
+        goto fail;
+
+    if (!(buf = av_malloc(PREFETCH_IO_SIZE))) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    p->pb = avio_alloc_context(buf, PREFETCH_IO_SIZE, 0, p, prefetch_read, NULL, prefetch_seek);
+    if (!p->pb) {
+        av_free(buf);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    p->pb->seekable = AVIO_SEEKABLE_NORMAL;
+    p->pb->pos      = start;
+
+    if ((ret = pthread_create(&p->thread, NULL, prefetch_thread, p))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    /* skip the part of the element that has already been parsed */
+    if ((err = avio_seek(p->pb, pos, SEEK_SET)) < 0) {
+        matroska_prefetch_free(matroska);
+        return err;
+    }
+    return 0;
+
+fail:
+    av_dict_free(&opts);
+    avio_closep(&p->in);
+    if (p->pb)
+        av_freep(&p->pb->buffer);
+    avio_context_free(&p->pb);
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+    av_freep(&matroska->prefetch);
+    return ret;
+}
+#else
+static void matroska_prefetch_free(MatroskaDemuxContext *matroska)
+{
+}
+
+static int matroska_prefetch_init(AVFormatContext *s)
+{
+    return AVERROR(ENOSYS);
+}
+#endif
+
 static int matroska_read_header(AVFormatContext *s)
 {
     MatroskaDemuxContext *matroska = s->priv_data;
@@ -2936,6 +3355,11 @@ static int matroska_read_header(AVFormatContext *s)
 
     matroska_convert_tags(s);
 
+    if (matroska->prefetch_clusters &&
+        (res = matroska_prefetch_init(s)) < 0)
+        av_log(s, AV_LOG_WARNING, "Cannot prefetch clusters: %s\n",
+               av_err2str(res));
+
     return 0;
 fail:
     matroska_read_close(s);
@@ -3386,7 +3810,9 @@ static int matroska_parse_frame(MatroskaDemuxContext *matroska,
     int res;
     AVPacket pktl, *pkt = &pktl;
 
-    if (encodings && !encodings->type && encodings->scope & 1) {
+    /* stripped headers are restored by matroska_restore_headers() */
+    if (encodings && !encodings->type && encodings->scope & 1 &&
+        encodings->compression.algo != MATROSKA_TRACK_ENCODING_COMP_HEADERSTRIP) {
         res = matroska_decode_buffer(&pkt_data, &pkt_size, track);
         if (res < 0)
             return res;
@@ -3495,6 +3921,59 @@ fail:
     return res;
 }
 
+/*
+ * Prepend the stripped header to each lace of a block. The header is
+ * written in front of the frame in the block buffer if it is not shared
+ * and there is room, otherwise all laces are copied into a single new
+ * buffer. On success, *buf is a new reference the caller must unref, and
+ * *data and lace_size describe the restored laces, still contiguous.
+ */
+static int matroska_restore_headers(MatroskaTrack *track, AVBufferRef **buf,
+                                    uint8_t **data, uint32_t lace_size[256],
+                                    int laces)
+{
+    MatroskaTrackEncoding *encodings = track->encodings.elem;
+    int header_size = encodings[0].compression.settings.size;
+    uint8_t *header = encodings[0].compression.settings.data;
+    uint8_t *src = *data, *dst;
+    int64_t size = 0;
+    int n;
+
+    if (!header) {
+        av_log(NULL, AV_LOG_ERROR, "Compression size but no data in headerstrip\n");
+        return AVERROR_INVALIDDATA;
+    }
+
+    if (laces == 1 && header_size <= src - (*buf)->data &&
+        av_buffer_is_writable(*buf)) {
+        if (!(*buf = av_buffer_ref(*buf)))
+            return AVERROR(ENOMEM);
+        *data -= header_size;
+        memcpy(*data, header, header_size);
+        lace_size[0] += header_size;
+        return 0;
+    }
+
+    for (n = 0; n < laces; n++)
+        size += lace_size[n] + header_size;
+    if (size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR_INVALIDDATA;
+
+    if (!(*buf = av_buffer_alloc(size + AV_INPUT_BUFFER_PADDING_SIZE)))
+        return AVERROR(ENOMEM);
+    dst = *data = (*buf)->data;
+    for (n = 0; n < laces; n++) {
+        memcpy(dst, header, header_size);
+        memcpy(dst + header_size, src, lace_size[n]);
+        dst          += header_size + lace_size[n];
+        src          += lace_size[n];
+        lace_size[n] += header_size;
+    }
+    memset(dst, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    return 0;
+}
+
 static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf, uint8_t *data,
                                 int size, int64_t pos, uint64_t cluster_time,
                                 uint64_t block_duration, int is_keyframe,
@@ -3511,6 +3990,9 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
     int n, flags, laces = 0;
     uint64_t num;
     int trust_default_duration = 1;
+    MatroskaTrackEncoding *encodings;
+    AVBufferRef *restored = NULL;
+    int rm_audio;
 
     ffio_init_context(&pb, data, size, 0, NULL, NULL, NULL, NULL);
 
@@ -3588,19 +4070,33 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
         track->end_timecode =
             FFMAX(track->end_timecode, timecode + block_duration);
 
+    rm_audio = (st->codecpar->codec_id == AV_CODEC_ID_RA_288 ||
+                st->codecpar->codec_id == AV_CODEC_ID_COOK   ||
+                st->codecpar->codec_id == AV_CODEC_ID_SIPR   ||
+                st->codecpar->codec_id == AV_CODEC_ID_ATRAC3) &&
+               st->codecpar->block_align && track->audio.sub_packet_size;
+
+    encodings = track->encodings.elem;
+    if (encodings && !encodings->type && encodings->scope & 1 &&
+        encodings->compression.algo == MATROSKA_TRACK_ENCODING_COMP_HEADERSTRIP &&
+        encodings->compression.settings.size &&
+        !rm_audio && st->codecpar->codec_id != AV_CODEC_ID_WEBVTT) {
+        restored = buf;
+        res = matroska_restore_headers(track, &restored, &data, lace_size, laces);
+        if (res < 0)
+            return res;
+        buf = restored;
+    }
+
     for (n = 0; n < laces; n++) {
         int64_t lace_duration = block_duration*(n+1) / laces - block_duration*n / laces;
 
-        if ((st->codecpar->codec_id == AV_CODEC_ID_RA_288 ||
-             st->codecpar->codec_id == AV_CODEC_ID_COOK   ||
-             st->codecpar->codec_id == AV_CODEC_ID_SIPR   ||
-             st->codecpar->codec_id == AV_CODEC_ID_ATRAC3) &&
-            st->codecpar->block_align && track->audio.sub_packet_size) {
+        if (rm_audio) {
             res = matroska_parse_rm_audio(matroska, track, st, data,
                                           lace_size[n],
                                           timecode, pos);
             if (res)
-                return res;
+                goto end;
 
         } else if (st->codecpar->codec_id == AV_CODEC_ID_WEBVTT) {
             res = matroska_parse_webvtt(matroska, track, st,
@@ -3608,7 +4104,7 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
                                         timecode, lace_duration,
                                         pos);
             if (res)
-                return res;
+                goto end;
         } else {
             res = matroska_parse_frame(matroska, track, st, buf, data, lace_size[n],
                                        timecode, lace_duration, pos,
@@ -3616,7 +4112,7 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
                                        additional, additional_id, additional_size,
                                        discard_padding);
             if (res)
-                return res;
+                goto end;
         }
 
         if (timecode != AV_NOPTS_VALUE)
@@ -3624,7 +4120,9 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
         data += lace_size[n];
     }
 
-    return 0;
+end:
+    av_buffer_unref(&restored);
+    return res;
 }
 
 static int matroska_parse_cluster(MatroskaDemuxContext *matroska)
@@ -3686,25 +4184,37 @@ static int matroska_parse_cluster(MatroskaDemuxContext *matroska)
 static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MatroskaDemuxContext *matroska = s->priv_data;
+    AVIOContext *pb = s->pb;
     int ret = 0;
 
     if (matroska->resync_pos == -1) {
         // This can only happen if generic seeking has been used.
         matroska->resync_pos = avio_tell(s->pb);
+        if (matroska->prefetch)
+            avio_seek(matroska->prefetch->pb, matroska->resync_pos, SEEK_SET);
     }
 
+    /* Parse the prefetched data instead of the input while reading. */
+    if (matroska->prefetch)
+        s->pb = matroska->prefetch->pb;
+
     while (matroska_deliver_packet(matroska, pkt)) {
-        if (matroska->done)
-            return (ret < 0) ? ret : AVERROR_EOF;
+        if (matroska->done) {
+            ret = (ret < 0) ? ret : AVERROR_EOF;
+            goto end;
+        }
         if (matroska_parse_cluster(matroska) < 0 && !matroska->done)
             ret = matroska_resync(matroska, matroska->resync_pos);
     }
+    ret = 0;
 
-    return 0;
+end:
+    s->pb = pb;
+    return ret;
 }
 
-static int matroska_read_seek(AVFormatContext *s, int stream_index,
-                              int64_t timestamp, int flags)
+static int matroska_seek(AVFormatContext *s, int stream_index,
+                         int64_t timestamp, int flags)
 {
     MatroskaDemuxContext *matroska = s->priv_data;
     MatroskaTrack *tracks = NULL;
@@ -3767,12 +4277,29 @@ err:
     return -1;
 }
 
+static int matroska_read_seek(AVFormatContext *s, int stream_index,
+                              int64_t timestamp, int flags)
+{
+    MatroskaDemuxContext *matroska = s->priv_data;
+    AVIOContext *pb = s->pb;
+    int ret;
+
+    /* The prefetch thread restarts from the cluster the Cues point to. */
+    if (matroska->prefetch)
+        s->pb = matroska->prefetch->pb;
+    ret = matroska_seek(s, stream_index, timestamp, flags);
+    s->pb = pb;
+
+    return ret;
+}
+
 static int matroska_read_close(AVFormatContext *s)
 {
     MatroskaDemuxContext *matroska = s->priv_data;
     MatroskaTrack *tracks = matroska->tracks.elem;
     int n;
 
+    matroska_prefetch_free(matroska);
     matroska_clear_queue(matroska);
 
     for (n = 0; n < matroska->tracks.nb_elem; n++)
@@ -4190,6 +4717,19 @@ static const AVClass webm_dash_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+static const AVOption matroska_options[] = {
+    { "prefetch_clusters", "Number of clusters to read ahead in a background thread", OFFSET(prefetch_clusters), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1024, AV_OPT_FLAG_DECODING_PARAM },
+    { "prefetch_size", "Maximum number of bytes to hold in memory for prefetched clusters", OFFSET(prefetch_size), AV_OPT_TYPE_INT64, {.i64 = 64 * 1024 * 1024}, 1, INT64_MAX, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "matroska,webm demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 AVInputFormat ff_matroska_demuxer = {
     .name           = "matroska,webm",
     .long_name      = NULL_IF_CONFIG_SMALL("Matroska / WebM"),
@@ -4200,7 +4740,8 @@ AVInputFormat ff_matroska_demuxer = {
     .read_packet    = matroska_read_packet,
     .read_close     = matroska_read_close,
     .read_seek      = matroska_read_seek,
-    .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska"
+    .mime_type      = "audio/webm,audio/x-matroska,video/webm,video/x-matroska",
+    .priv_class     = &matroska_class,
 };
 
 AVInputFormat ff_webm_dash_manifest_demuxer = {
@@ -3339,62 +3339,6 @@ static int64_t add_ctts_entry(MOVStts** ctts_data, unsigned int* ctts_count, uns
     return *ctts_count;
 }
 
-#define MAX_REORDER_DELAY 16
-static void mov_estimate_video_delay(MOVContext *c, AVStream* st) {
-    MOVStreamContext *msc = st->priv_data;
-    int ind;
-    int ctts_ind = 0;
-    int ctts_sample = 0;
-    int64_t pts_buf[MAX_REORDER_DELAY + 1]; // Circular buffer to sort pts.
-    int buf_start = 0;
-    int j, r, num_swaps;
-
-    for (j = 0; j < MAX_REORDER_DELAY + 1; j++)
-        pts_buf[j] = INT64_MIN;
-
-    if (st->codecpar->video_delay <= 0 && msc->ctts_data &&
-        st->codecpar->codec_id == AV_CODEC_ID_H264) {
-        st->codecpar->video_delay = 0;
-        for(ind = 0; ind < st->nb_index_entries && ctts_ind < msc->ctts_count; ++ind) {
-            // Point j to the last elem of the buffer and insert the current pts there.
-            j = buf_start;
-            buf_start = (buf_start + 1);
-            if (buf_start == MAX_REORDER_DELAY + 1)
-                buf_start = 0;
-
-            pts_buf[j] = st->index_entries[ind].timestamp + msc->ctts_data[ctts_ind].duration;
-
-            // The timestamps that are already in the sorted buffer, and are greater than the
-            // current pts, are exactly the timestamps that need to be buffered to output PTS
-            // in correct sorted order.
-            // Hence the video delay (which is the buffer size used to sort DTS and output PTS),
-            // can be computed as the maximum no. of swaps any particular timestamp needs to
-            // go through, to keep this buffer in sorted order.
-            num_swaps = 0;
-            while (j != buf_start) {
-                r = j - 1;
-                if (r < 0) r = MAX_REORDER_DELAY;
-                if (pts_buf[j] < pts_buf[r]) {
-                    FFSWAP(int64_t, pts_buf[j], pts_buf[r]);
-                    ++num_swaps;
-                } else {
-                    break;
-                }
-                j = r;
-            }
-            st->codecpar->video_delay = FFMAX(st->codecpar->video_delay, num_swaps);
-
-            ctts_sample++;
-            if (ctts_sample == msc->ctts_data[ctts_ind].count) {
-                ctts_ind++;
-                ctts_sample = 0;
-            }
-        }
-        av_log(c->fc, AV_LOG_DEBUG, "Setting codecpar->delay to %d for stream st: %d\n",
-               st->codecpar->video_delay, st->index);
-    }
-}
-
 static void mov_current_sample_inc(MOVStreamContext *sc)
 {
     sc->current_sample++;
@@ -3751,19 +3695,351 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
     msc->current_index = msc->index_ranges[0].start;
 }
 
+#define MOV_LAZY_INDEX_SIZE 1024
+
+/**
+ * Walk the sample tables over the next sample.
+ *
+ * @param e   set to the index entry of the sample
+ * @param dry only look ahead of the index, without logging or fixing up the
+ *            sample tables
+ * @return 1 if e was set, 0 if the sample belongs to another sample
+ *         description, AVERROR_EOF after the last chunk, <0 on error
+ */
+static int mov_index_next_sample(MOVContext *mov, AVStream *st, MOVIndexState *is,
+                                 AVIndexEntry *e, int dry)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int rap_group_present = sc->rap_group_count && sc->rap_group;
+    int key_off = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
+    unsigned int sample_size;
+    int keyframe = 0, duration, ret = 0;
+
+    while (!is->chunk_samples_left) {
+        int64_t next_offset;
+        unsigned int i = is->chunk;
+
+        if (i >= sc->chunk_count)
+            return AVERROR_EOF;
+        next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
+        is->offset = sc->chunk_offsets[i];
+        while (mov_stsc_index_valid(is->stsc_index, sc->stsc_count) &&
+            i + 1 == sc->stsc_data[is->stsc_index + 1].first)
+            is->stsc_index++;
+
+        if (next_offset > is->offset && sc->sample_size>0 && sc->sample_size < is->stsz_sample_size &&
+            sc->stsc_data[is->stsc_index].count * (int64_t)is->stsz_sample_size > next_offset - is->offset) {
+            if (!dry) {
+                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", is->stsz_sample_size);
+                sc->stsz_sample_size = sc->sample_size;
+            }
+            is->stsz_sample_size = sc->sample_size;
+        }
+        if (is->stsz_sample_size>0 && is->stsz_sample_size < sc->sample_size) {
+            if (!dry) {
+                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", is->stsz_sample_size);
+                sc->stsz_sample_size = sc->sample_size;
+            }
+            is->stsz_sample_size = sc->sample_size;
+        }
+
+        is->chunk_samples_left = sc->stsc_data[is->stsc_index].count;
+        if (!is->chunk_samples_left)
+            is->chunk++;
+    }
+
+    if (is->current_sample >= sc->sample_count) {
+        if (!dry)
+            av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
+        return AVERROR_INVALIDDATA;
+    }
+
+    if (!sc->keyframe_absent && (!sc->keyframe_count || is->current_sample+key_off == sc->keyframes[is->stss_index])) {
+        keyframe = 1;
+        if (is->stss_index + 1 < sc->keyframe_count)
+            is->stss_index++;
+    } else if (sc->stps_count && is->current_sample+key_off == sc->stps_data[is->stps_index]) {
+        keyframe = 1;
+        if (is->stps_index + 1 < sc->stps_count)
+            is->stps_index++;
+    }
+    if (rap_group_present && is->rap_group_index < sc->rap_group_count) {
+        if (sc->rap_group[is->rap_group_index].index > 0)
+            keyframe = 1;
+        if (++is->rap_group_sample == sc->rap_group[is->rap_group_index].count) {
+            is->rap_group_sample = 0;
+            is->rap_group_index++;
+        }
+    }
+    if (sc->keyframe_absent
+        && !sc->stps_count
+        && !rap_group_present
+        && (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO ||
+            (is->chunk == 0 && is->chunk_samples_left == sc->stsc_data[is->stsc_index].count)))
+         keyframe = 1;
+    if (keyframe)
+        is->distance = 0;
+    sample_size = is->stsz_sample_size > 0 ? is->stsz_sample_size : sc->sample_sizes[is->current_sample];
+    if (sc->pseudo_stream_id == -1 ||
+       sc->stsc_data[is->stsc_index].id - 1 == sc->pseudo_stream_id) {
+        if (sample_size > 0x3FFFFFFF) {
+            if (!dry)
+                av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", sample_size);
+            return AVERROR_INVALIDDATA;
+        }
+        e->pos = is->offset;
+        e->timestamp = is->current_dts;
+        e->size = sample_size;
+        e->min_distance = is->distance;
+        e->flags = keyframe ? AVINDEX_KEYFRAME : 0;
+        ret = 1;
+    }
+
+    is->offset += sample_size;
+    is->stream_size += sample_size;
+
+    /* A negative sample duration is invalid based on the spec,
+     * but some samples need it to correct the DTS. */
+    duration = sc->stts_data[is->stts_index].duration;
+    if (duration < 0) {
+        if (!is->stts_sample) {
+            if (!dry) {
+                av_log(mov->fc, AV_LOG_WARNING,
+                       "Invalid SampleDelta %d in STTS, at %d st:%d\n",
+                       duration, is->stts_index, st->index);
+                sc->stts_data[is->stts_index].duration = 1;
+            }
+            is->dts_correction += duration - 1;
+        }
+        duration = 1;
+    }
+    is->current_dts += duration;
+    if (!is->dts_correction || is->current_dts + is->dts_correction > is->last_dts) {
+        is->current_dts += is->dts_correction;
+        is->dts_correction = 0;
+    } else {
+        /* Avoid creating non-monotonous DTS */
+        is->dts_correction += is->current_dts - is->last_dts - 1;
+        is->current_dts = is->last_dts + 1;
+    }
+    is->last_dts = is->current_dts;
+    is->distance++;
+    is->stts_sample++;
+    is->current_sample++;
+    if (is->stts_index + 1 < sc->stts_count && is->stts_sample == sc->stts_data[is->stts_index].count) {
+        is->stts_sample = 0;
+        is->stts_index++;
+    }
+    if (!--is->chunk_samples_left)
+        is->chunk++;
+    return ret;
+}
+
+/**
+ * Make room for more index entries. A lazy index grows along with the part
+ * of it being built, up to one entry per sample.
+ */
+static int mov_grow_index(AVStream *st, unsigned int nb_entries)
+{
+    MOVStreamContext *sc = st->priv_data;
+    unsigned int size = st->index_entries_allocated_size;
+    AVIndexEntry *entries;
+
+    nb_entries = FFMIN(FFMAX(nb_entries, 2U * st->nb_index_entries), sc->sample_count);
+    entries = av_fast_realloc(st->index_entries, &size, nb_entries * sizeof(*entries));
+    if (!entries)
+        return AVERROR(ENOMEM);
+    st->index_entries = entries;
+    st->index_entries_allocated_size = size;
+    return 0;
+}
+
+/**
+ * Add the index entries of the samples following the ones already indexed,
+ * until the index has at least nb_entries entries.
+ *
+ * @return 1 if chunks are left, 0 if the index is complete, <0 on error
+ */
+static int mov_build_index_chunks(MOVContext *mov, AVStream *st, unsigned int nb_entries)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVIndexState *is = &sc->index_state;
+    AVIndexEntry e;
+    int ret;
+
+    while (st->nb_index_entries < nb_entries) {
+        ret = mov_index_next_sample(mov, st, is, &e, 0);
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret <= 0) {
+            if (ret < 0)
+                return ret;
+            continue;
+        }
+        if (st->nb_index_entries >= st->index_entries_allocated_size / sizeof(*st->index_entries) &&
+            (ret = mov_grow_index(st, nb_entries)) < 0)
+            return ret;
+        st->index_entries[st->nb_index_entries++] = e;
+        av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
+                "size %u, distance %u, keyframe %d\n", st->index, is->current_sample - 1,
+                e.pos, e.timestamp, e.size, e.min_distance, !!(e.flags & AVINDEX_KEYFRAME));
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->nb_index_entries < 100)
+            ff_rfps_add_frame(mov->fc, st, e.timestamp);
+    }
+    return is->chunk < sc->chunk_count;
+}
+
+/**
+ * Iterate over the index of a track, continuing past the end of a lazily
+ * built index from the sample tables.
+ */
+typedef struct MOVIndexCursor {
+    AVStream *st;
+    int index;          ///< next entry of st->index_entries
+    MOVIndexState is;   ///< sample table walk following the built entries
+} MOVIndexCursor;
+
+static void mov_index_cursor_init(MOVIndexCursor *c, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    c->st    = st;
+    c->index = 0;
+    c->is    = sc->index_state;
+}
+
+/**
+ * @return 1 if e was set, 0 after the last entry, <0 on error
+ */
+static int mov_index_cursor_next(MOVContext *mov, MOVIndexCursor *c, AVIndexEntry *e)
+{
+    MOVStreamContext *sc = c->st->priv_data;
+    int ret;
+
+    if (c->index < c->st->nb_index_entries) {
+        *e = c->st->index_entries[c->index++];
+        return 1;
+    }
+    if (!sc->lazy_index)
+        return 0;
+    while (!(ret = mov_index_next_sample(mov, c->st, &c->is, e, 1)))
+        ;
+    return ret == AVERROR_EOF ? 0 : ret;
+}
+
+#define MAX_REORDER_DELAY 16
+static void mov_estimate_video_delay(MOVContext *c, AVStream* st) {
+    MOVStreamContext *msc = st->priv_data;
+    MOVIndexCursor cursor;
+    AVIndexEntry e;
+    int ctts_ind = 0;
+    int ctts_sample = 0;
+    int64_t pts_buf[MAX_REORDER_DELAY + 1]; // Circular buffer to sort pts.
+    int buf_start = 0;
+    int j, r, num_swaps;
+
+    for (j = 0; j < MAX_REORDER_DELAY + 1; j++)
+        pts_buf[j] = INT64_MIN;
+
+    if (st->codecpar->video_delay <= 0 && msc->ctts_data &&
+        st->codecpar->codec_id == AV_CODEC_ID_H264) {
+        st->codecpar->video_delay = 0;
+        mov_index_cursor_init(&cursor, st);
+        while (ctts_ind < msc->ctts_count &&
+               mov_index_cursor_next(c, &cursor, &e) > 0) {
+            // Point j to the last elem of the buffer and insert the current pts there.
+            j = buf_start;
+            buf_start = (buf_start + 1);
+            if (buf_start == MAX_REORDER_DELAY + 1)
+                buf_start = 0;
+
+            pts_buf[j] = e.timestamp + msc->ctts_data[ctts_ind].duration;
+
+            // The timestamps that are already in the sorted buffer, and are greater than the
+            // current pts, are exactly the timestamps that need to be buffered to output PTS
+            // in correct sorted order.
+            // Hence the video delay (which is the buffer size used to sort DTS and output PTS),
+            // can be computed as the maximum no. of swaps any particular timestamp needs to
+            // go through, to keep this buffer in sorted order.
+            num_swaps = 0;
+            while (j != buf_start) {
+                r = j - 1;
+                if (r < 0) r = MAX_REORDER_DELAY;
+                if (pts_buf[j] < pts_buf[r]) {
+                    FFSWAP(int64_t, pts_buf[j], pts_buf[r]);
+                    ++num_swaps;
+                } else {
+                    break;
+                }
+                j = r;
+            }
+            st->codecpar->video_delay = FFMAX(st->codecpar->video_delay, num_swaps);
+
+            ctts_sample++;
+            if (ctts_sample == msc->ctts_data[ctts_ind].count) {
+                ctts_ind++;
+                ctts_sample = 0;
+            }
+        }
+        av_log(c->fc, AV_LOG_DEBUG, "Setting codecpar->delay to %d for stream st: %d\n",
+               st->codecpar->video_delay, st->index);
+    }
+}
+
+static void mov_free_sample_tables(MOVStreamContext *sc)
+{
+    av_freep(&sc->chunk_offsets);
+    av_freep(&sc->sample_sizes);
+    av_freep(&sc->keyframes);
+    av_freep(&sc->stts_data);
+    av_freep(&sc->stps_data);
+    av_freep(&sc->rap_group);
+}
+
+static void mov_finish_lazy_index(MOVStreamContext *sc)
+{
+    sc->lazy_index = 0;
+    mov_free_sample_tables(sc);
+}
+
+/**
+ * Make sure a lazily built index has at least nb_entries entries, or all of
+ * them if the track has fewer samples.
+ */
+static void mov_extend_index(MOVContext *mov, AVStream *st, unsigned int nb_entries)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (sc->lazy_index && st->nb_index_entries < nb_entries &&
+        mov_build_index_chunks(mov, st, nb_entries) <= 0)
+        mov_finish_lazy_index(sc);
+}
+
+/**
+ * Extend a lazily built index past timestamp, so that a backward search
+ * gives the same result as on the complete index.
+ */
+static void mov_extend_index_past(MOVContext *mov, AVStream *st, int64_t timestamp)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    while (sc->lazy_index &&
+           (!st->nb_index_entries ||
+            st->index_entries[st->nb_index_entries - 1].timestamp <= timestamp))
+        mov_extend_index(mov, st, st->nb_index_entries + MOV_LAZY_INDEX_SIZE);
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
     int64_t current_offset;
     int64_t current_dts = 0;
-    unsigned int stts_index = 0;
     unsigned int stsc_index = 0;
-    unsigned int stss_index = 0;
-    unsigned int stps_index = 0;
     unsigned int i, j;
     uint64_t stream_size = 0;
     MOVStts *ctts_data_old = sc->ctts_data;
     unsigned int ctts_count_old = sc->ctts_count;
+    unsigned int nb_entries;
 
     if (sc->elst_count) {
         int i, edit_start_index = 0, multiple_edits = 0;
@@ -3807,31 +4083,29 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     /* only use old uncompressed audio chunk demuxing when stts specifies it */
     if (!(st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
           sc->stts_count == 1 && sc->stts_data[0].duration == 1)) {
-        unsigned int current_sample = 0;
-        unsigned int stts_sample = 0;
-        unsigned int sample_size;
-        unsigned int distance = 0;
-        unsigned int rap_group_index = 0;
-        unsigned int rap_group_sample = 0;
-        int64_t last_dts = 0;
-        int64_t dts_correction = 0;
-        int rap_group_present = sc->rap_group_count && sc->rap_group;
-        int key_off = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
+        MOVIndexState *is = &sc->index_state;
 
         current_dts -= sc->dts_shift;
-        last_dts     = current_dts;
 
         if (!sc->sample_count || st->nb_index_entries)
             return;
         if (sc->sample_count >= UINT_MAX / sizeof(*st->index_entries) - st->nb_index_entries)
             return;
-        if (av_reallocp_array(&st->index_entries,
-                              st->nb_index_entries + sc->sample_count,
+
+        /* mov_fix_index() needs the whole index */
+        sc->lazy_index = mov->lazy_index &&
+                         (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ||
+                          st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) &&
+                         (!sc->elst_count || mov->ignore_editlist || !mov->advanced_editlist);
+
+        /* A lazy index is grown along with the part of it being built. */
+        nb_entries = sc->lazy_index ? FFMIN(sc->sample_count, MOV_LAZY_INDEX_SIZE) : sc->sample_count;
+        if (av_reallocp_array(&st->index_entries, nb_entries,
                               sizeof(*st->index_entries)) < 0) {
             st->nb_index_entries = 0;
             return;
         }
-        st->index_entries_allocated_size = (st->nb_index_entries + sc->sample_count) * sizeof(*st->index_entries);
+        st->index_entries_allocated_size = nb_entries * sizeof(*st->index_entries);
 
         if (ctts_data_old) {
             // Expand ctts entries such that we have a 1-1 mapping with samples
@@ -3858,106 +4132,35 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             av_free(ctts_data_old);
         }
 
-        for (i = 0; i < sc->chunk_count; i++) {
-            int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
-            current_offset = sc->chunk_offsets[i];
-            while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
-                i + 1 == sc->stsc_data[stsc_index + 1].first)
-                stsc_index++;
+        memset(is, 0, sizeof(*is));
+        is->current_dts = is->last_dts = current_dts;
+        is->stsz_sample_size = sc->stsz_sample_size;
 
-            if (next_offset > current_offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
-                sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - current_offset) {
-                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
-                sc->stsz_sample_size = sc->sample_size;
-            }
-            if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size) {
-                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
-                sc->stsz_sample_size = sc->sample_size;
-            }
+        if (sc->lazy_index) {
+            int ret = mov_build_index_chunks(mov, st, MOV_LAZY_INDEX_SIZE);
+            if (ret > 0) {
+                /* walk the rest of the sample tables for the stream size */
+                MOVIndexCursor cursor;
+                AVIndexEntry e;
 
-            for (j = 0; j < sc->stsc_data[stsc_index].count; j++) {
-                int keyframe = 0;
-                if (current_sample >= sc->sample_count) {
-                    av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
+                mov_index_cursor_init(&cursor, st);
+                cursor.index = st->nb_index_entries;
+                while ((ret = mov_index_cursor_next(mov, &cursor, &e)) > 0)
+                    ;
+                if (ret < 0)
                     return;
-                }
-
-                if (!sc->keyframe_absent && (!sc->keyframe_count || current_sample+key_off == sc->keyframes[stss_index])) {
-                    keyframe = 1;
-                    if (stss_index + 1 < sc->keyframe_count)
-                        stss_index++;
-                } else if (sc->stps_count && current_sample+key_off == sc->stps_data[stps_index]) {
-                    keyframe = 1;
-                    if (stps_index + 1 < sc->stps_count)
-                        stps_index++;
-                }
-                if (rap_group_present && rap_group_index < sc->rap_group_count) {
-                    if (sc->rap_group[rap_group_index].index > 0)
-                        keyframe = 1;
-                    if (++rap_group_sample == sc->rap_group[rap_group_index].count) {
-                        rap_group_sample = 0;
-                        rap_group_index++;
-                    }
-                }
-                if (sc->keyframe_absent
-                    && !sc->stps_count
-                    && !rap_group_present
-                    && (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO || (i==0 && j==0)))
-                     keyframe = 1;
-                if (keyframe)
-                    distance = 0;
-                sample_size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[current_sample];
-                if (sc->pseudo_stream_id == -1 ||
-                   sc->stsc_data[stsc_index].id - 1 == sc->pseudo_stream_id) {
-                    AVIndexEntry *e;
-                    if (sample_size > 0x3FFFFFFF) {
-                        av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", sample_size);
-                        return;
-                    }
-                    e = &st->index_entries[st->nb_index_entries++];
-                    e->pos = current_offset;
-                    e->timestamp = current_dts;
-                    e->size = sample_size;
-                    e->min_distance = distance;
-                    e->flags = keyframe ? AVINDEX_KEYFRAME : 0;
-                    av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
-                            "size %u, distance %u, keyframe %d\n", st->index, current_sample,
-                            current_offset, current_dts, sample_size, distance, keyframe);
-                    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->nb_index_entries < 100)
-                        ff_rfps_add_frame(mov->fc, st, current_dts);
-                }
-
-                current_offset += sample_size;
-                stream_size += sample_size;
-
-                /* A negative sample duration is invalid based on the spec,
-                 * but some samples need it to correct the DTS. */
-                if (sc->stts_data[stts_index].duration < 0) {
-                    av_log(mov->fc, AV_LOG_WARNING,
-                           "Invalid SampleDelta %d in STTS, at %d st:%d\n",
-                           sc->stts_data[stts_index].duration, stts_index,
-                           st->index);
-                    dts_correction += sc->stts_data[stts_index].duration - 1;
-                    sc->stts_data[stts_index].duration = 1;
-                }
-                current_dts += sc->stts_data[stts_index].duration;
-                if (!dts_correction || current_dts + dts_correction > last_dts) {
-                    current_dts += dts_correction;
-                    dts_correction = 0;
-                } else {
-                    /* Avoid creating non-monotonous DTS */
-                    dts_correction += current_dts - last_dts - 1;
-                    current_dts = last_dts + 1;
-                }
-                last_dts = current_dts;
-                distance++;
-                stts_sample++;
-                current_sample++;
-                if (stts_index + 1 < sc->stts_count && stts_sample == sc->stts_data[stts_index].count) {
-                    stts_sample = 0;
-                    stts_index++;
-                }
+                stream_size = cursor.is.stream_size;
+            } else {
+                /* mov_read_trak() frees the tables */
+                sc->lazy_index = 0;
+                if (ret < 0)
+                    return;
+                stream_size = is->stream_size;
             }
+        } else {
+            if (mov_build_index_chunks(mov, st, UINT_MAX) < 0)
+                return;
+            stream_size = is->stream_size;
         }
         if (st->duration > 0)
             st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
@@ -4307,14 +4510,10 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             st->need_parsing = AVSTREAM_PARSE_FULL;
     }
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
+    /* Do not need those anymore, unless the index is still being built. */
+    if (!sc->lazy_index)
+        mov_free_sample_tables(sc);
     av_freep(&sc->elst_data);
-    av_freep(&sc->rap_group);
 
     return 0;
 }
@@ -4754,6 +4953,9 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
 
+    // Fragment samples follow the ones described in the moov.
+    mov_extend_index(c, st, UINT_MAX);
+
     // Find the next frag_index index that has a valid index_entry for
     // the current track_id.
     //
@@ -6658,6 +6860,9 @@ static int cenc_filter(MOVContext *mov, AVStream* st, MOVStreamContext *sc, AVPa
         }
 
         if (mov->decryption_key) {
+            /* the data may be shared with the I/O buffer */
+            if ((ret = av_packet_make_writable(pkt)) < 0)
+                return ret;
             return cenc_decrypt(mov, sc, encrypted_sample, pkt->data, pkt->size);
         } else {
             size_t size;
@@ -7455,6 +7660,84 @@ fail:
     return ret;
 }
 
+/**
+ * Same as ff_configure_buffers_for_index(), on the complete index of tracks
+ * whose index is built lazily.
+ */
+static void mov_configure_buffers(AVFormatContext *s, int64_t time_tolerance)
+{
+    MOVContext *mov = s->priv_data;
+    const char *proto = avio_find_protocol_name(s->url);
+    int64_t pos_delta = 0;
+    int64_t skip = 0;
+    int ist1, ist2;
+
+    for (ist1 = 0; ist1 < s->nb_streams; ist1++) {
+        MOVStreamContext *sc = s->streams[ist1]->priv_data;
+        if (sc->lazy_index)
+            break;
+    }
+    if (ist1 == s->nb_streams) {
+        ff_configure_buffers_for_index(s, time_tolerance);
+        return;
+    }
+
+    if (!proto) {
+        av_log(s, AV_LOG_INFO,
+               "Protocol name not provided, cannot determine if input is local or "
+               "a network protocol, buffers and access patterns cannot be configured "
+               "optimally without knowing the protocol\n");
+    }
+
+    if (proto && !(strcmp(proto, "file") && strcmp(proto, "pipe") && strcmp(proto, "cache")))
+        return;
+
+    for (ist1 = 0; ist1 < s->nb_streams; ist1++) {
+        AVStream *st1 = s->streams[ist1];
+        for (ist2 = 0; ist2 < s->nb_streams; ist2++) {
+            AVStream *st2 = s->streams[ist2];
+            MOVIndexCursor c1, c2;
+            AVIndexEntry e1, e2;
+            int ret2;
+
+            if (ist1 == ist2)
+                continue;
+
+            mov_index_cursor_init(&c1, st1);
+            mov_index_cursor_init(&c2, st2);
+            ret2 = mov_index_cursor_next(mov, &c2, &e2);
+            while (mov_index_cursor_next(mov, &c1, &e1) > 0) {
+                int64_t e1_pts = av_rescale_q(e1.timestamp, st1->time_base, AV_TIME_BASE_Q);
+
+                skip = FFMAX(skip, e1.size);
+                for (; ret2 > 0; ret2 = mov_index_cursor_next(mov, &c2, &e2)) {
+                    int64_t e2_pts = av_rescale_q(e2.timestamp, st2->time_base, AV_TIME_BASE_Q);
+                    if (e2_pts < e1_pts || e2_pts - (uint64_t)e1_pts < time_tolerance)
+                        continue;
+                    pos_delta = FFMAX(pos_delta, e1.pos - e2.pos);
+                    break;
+                }
+            }
+        }
+    }
+
+    pos_delta *= 2;
+    if (s->pb->buffer_size < pos_delta && pos_delta < (1<<24)) {
+        av_log(s, AV_LOG_VERBOSE, "Reconfiguring buffers to size %"PRId64"\n", pos_delta);
+
+        if (ffio_realloc_buf(s->pb, pos_delta)) {
+            av_log(s, AV_LOG_ERROR, "Realloc buffer fail.\n");
+            return;
+        }
+
+        s->pb->short_seek_threshold = FFMAX(s->pb->short_seek_threshold, pos_delta/2);
+    }
+
+    if (skip < (1<<23)) {
+        s->pb->short_seek_threshold = FFMAX(s->pb->short_seek_threshold, skip);
+    }
+}
+
 static int mov_read_header(AVFormatContext *s)
 {
     MOVContext *mov = s->priv_data;
@@ -7656,7 +7939,7 @@ static int mov_read_header(AVFormatContext *s)
             break;
         }
     }
-    ff_configure_buffers_for_index(s, AV_TIME_BASE);
+    mov_configure_buffers(s, AV_TIME_BASE);
 
     for (i = 0; i < mov->frag_index.nb_items; i++)
         if (mov->frag_index.item[i].moof_offset <= mov->fragment.moof_offset)
@@ -7667,12 +7950,15 @@ static int mov_read_header(AVFormatContext *s)
 
 static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
 {
+    MOVContext *mov = s->priv_data;
     AVIndexEntry *sample = NULL;
     int64_t best_dts = INT64_MAX;
     int i;
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
+        /* the packet duration is taken from the following sample */
+        mov_extend_index(mov, avst, msc->current_sample + 2);
         if (msc->pb && msc->current_sample < avst->nb_index_entries) {
             AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
@@ -7820,8 +8106,12 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         }
 #if CONFIG_DV_DEMUXER
         if (mov->dv_demux && sc->dv_audio_container) {
+            /* the data may point into the I/O buffer, release the reference
+             * rather than the data */
+            AVBufferRef *buf = pkt->buf;
+            pkt->buf = NULL;
             avpriv_dv_produce_packet(mov->dv_demux, pkt, pkt->data, pkt->size, pkt->pos);
-            av_freep(&pkt->data);
+            av_buffer_unref(&buf);
             pkt->size = 0;
             ret = avpriv_dv_get_packet(mov->dv_demux, pkt);
             if (ret < 0)
@@ -7885,8 +8175,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         }
     }
 
-    if (mov->aax_mode)
+    if (mov->aax_mode) {
+        if ((ret = av_packet_make_writable(pkt)) < 0)
+            return ret;
         aax_filter(pkt->data, pkt->size, mov);
+    }
 
     ret = cenc_filter(mov, st, sc, pkt, current_index);
     if (ret < 0) {
@@ -7917,6 +8210,7 @@ static int mov_seek_fragment(AVFormatContext *s, AVStream *st, int64_t timestamp
 
 static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp, int flags)
 {
+    MOVContext *mov = s->priv_data;
     MOVStreamContext *sc = st->priv_data;
     int sample, time_sample, ret;
     unsigned int i;
@@ -7929,7 +8223,13 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
+    mov_extend_index_past(mov, st, timestamp);
     sample = av_index_search_timestamp(st, timestamp, flags);
+    /* the next keyframe may not be indexed yet */
+    while (sample < 0 && sc->lazy_index && !(flags & AVSEEK_FLAG_BACKWARD)) {
+        mov_extend_index(mov, st, st->nb_index_entries + MOV_LAZY_INDEX_SIZE);
+        sample = av_index_search_timestamp(st, timestamp, flags);
+    }
     av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
     if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
         sample = 0;
@@ -8038,6 +8338,9 @@ static const AVOption mov_options[] = {
         "Modify the AVIndex according to the editlists. Use this option to decode in the order specified by the edits.",
         OFFSET(advanced_editlist), AV_OPT_TYPE_BOOL, {.i64 = 1},
         0, 1, FLAGS},
+    {"lazy_index", "Build the index of audio and video tracks while reading instead of when opening",
+        OFFSET(lazy_index), AV_OPT_TYPE_BOOL, {.i64 = 0},
+        0, 1, FLAGS},
     {"ignore_chapters", "", OFFSET(ignore_chapters), AV_OPT_TYPE_BOOL, {.i64 = 0},
         0, 1, FLAGS},
     {"use_mfra_for",
@@ -8087,4 +8390,5 @@ AVInputFormat ff_mov_demuxer = {
     .read_close     = mov_read_close,
     .read_seek      = mov_read_seek,
     .flags          = AVFMT_NO_BYTE_SEEK | AVFMT_SEEK_TO_PTS,
+    .flags_internal = FF_FMT_FLAG_ZERO_COPY,
 };
@@ -42,6 +42,8 @@
 #include "libavcodec/vc1_common.h"
 #include "libavcodec/raw.h"
 #include "internal.h"
+#include "os_support.h"
+#include "url.h"
 #include "libavutil/avstring.h"
 #include "libavutil/intfloat.h"
 #include "libavutil/mathematics.h"
@@ -5080,6 +5082,93 @@ static void mov_parse_truehd_frame(AVPacket *pkt, MOVTrack *trk)
     return;
 }
 
+static int64_t mov_frag_data_size(MOVTrack *track)
+{
+    return track->frag_data_size + (track->mdat_buf ? avio_tell(track->mdat_buf) : 0);
+}
+
+static int mov_frag_add_data(MOVTrack *track, AVBufferRef *buf, uint8_t *data, int size)
+{
+    MOVFragmentData *frag;
+
+    if (track->nb_frag_data >= track->frag_data_capacity) {
+        unsigned new_capacity = 2 * track->nb_frag_data + 16;
+        frag = av_realloc_array(track->frag_data, new_capacity, sizeof(*frag));
+        if (!frag) {
+            av_buffer_unref(&buf);
+            return AVERROR(ENOMEM);
+        }
+        track->frag_data          = frag;
+        track->frag_data_capacity = new_capacity;
+    }
+    frag = &track->frag_data[track->nb_frag_data++];
+    frag->buf  = buf;
+    frag->data = data;
+    frag->size = size;
+    track->frag_data_size += size;
+    return 0;
+}
+
+/* Keep a reference to the payload of a packet stored as is, instead of
+ * copying it into the fragment buffer. Data already written to the fragment
+ * buffer is moved behind the previous payloads to keep the samples in order. */
+static int mov_frag_ref_packet(MOVTrack *track, const AVPacket *pkt)
+{
+    AVBufferRef *buf;
+    uint8_t *data;
+    int ret;
+
+    if (track->mdat_buf && avio_tell(track->mdat_buf)) {
+        int size = avio_close_dyn_buf(track->mdat_buf, &data);
+        track->mdat_buf = NULL;
+        if (!(buf = av_buffer_create(data, size, av_buffer_default_free, NULL, 0))) {
+            av_free(data);
+            return AVERROR(ENOMEM);
+        }
+        if ((ret = mov_frag_add_data(track, buf, data, size)) < 0)
+            return ret;
+    }
+
+    if (pkt->buf) {
+        if (!(buf = av_buffer_ref(pkt->buf)))
+            return AVERROR(ENOMEM);
+        data = pkt->data;
+    } else {
+        if (!(buf = av_buffer_alloc(pkt->size)))
+            return AVERROR(ENOMEM);
+        data = buf->data;
+        memcpy(data, pkt->data, pkt->size);
+    }
+    return mov_frag_add_data(track, buf, data, pkt->size);
+}
+
+static void mov_frag_free_data(MOVTrack *track)
+{
+    int i;
+
+    for (i = 0; i < track->nb_frag_data; i++)
+        av_buffer_unref(&track->frag_data[i].buf);
+    track->nb_frag_data   = 0;
+    track->frag_data_size = 0;
+}
+
+static void mov_write_frag_data(AVIOContext *pb, MOVTrack *track)
+{
+    int i;
+
+    for (i = 0; i < track->nb_frag_data; i++)
+        avio_write(pb, track->frag_data[i].data, track->frag_data[i].size);
+    mov_frag_free_data(track);
+
+    if (track->mdat_buf) {
+        uint8_t *buf;
+        int buf_size = avio_close_dyn_buf(track->mdat_buf, &buf);
+        track->mdat_buf = NULL;
+        avio_write(pb, buf, buf_size);
+        av_free(buf);
+    }
+}
+
 static int mov_flush_fragment_interleaving(AVFormatContext *s, MOVTrack *track)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -5246,8 +5335,7 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         }
         if (!track->entry)
             continue;
-        if (track->mdat_buf)
-            mdat_size += avio_tell(track->mdat_buf);
+        mdat_size += mov_frag_data_size(track);
         if (first_track < 0)
             first_track = i;
     }
@@ -5269,9 +5357,9 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
             duration = track->start_dts + track->track_duration -
                        track->cluster[0].dts;
         if (mov->flags & FF_MOV_FLAG_SEPARATE_MOOF) {
-            if (!track->mdat_buf)
+            if (!track->mdat_buf && !track->nb_frag_data)
                 continue;
-            mdat_size = avio_tell(track->mdat_buf);
+            mdat_size = mov_frag_data_size(track);
             moof_tracks = i;
         } else {
             write_moof = i == first_track;
@@ -5293,19 +5381,13 @@ static int mov_flush_fragment(AVFormatContext *s, int force)
         track->entries_flushed = 0;
         track->end_reliable = 0;
         if (!mov->frag_interleave) {
-            if (!track->mdat_buf)
-                continue;
-            buf_size = avio_close_dyn_buf(track->mdat_buf, &buf);
-            track->mdat_buf = NULL;
-        } else {
-            if (!mov->mdat_buf)
-                continue;
+            mov_write_frag_data(s->pb, track);
+        } else if (mov->mdat_buf) {
             buf_size = avio_close_dyn_buf(mov->mdat_buf, &buf);
             mov->mdat_buf = NULL;
+            avio_write(s->pb, buf, buf_size);
+            av_free(buf);
         }
-
-        avio_write(s->pb, buf, buf_size);
-        av_free(buf);
     }
 
     mov->mdat_size = 0;
@@ -5375,7 +5457,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
     AVProducerReferenceTime *prft;
     unsigned int samples_in_chunk = 0;
     int size = pkt->size, ret = 0, offset = 0;
-    int prft_size;
+    int prft_size, ref_data = 0;
     uint8_t *reformatted_data = NULL;
 
     ret = check_pkt(s, pkt);
@@ -5391,6 +5473,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
                         return ret;
                 }
             }
+            ref_data = !mov->frag_interleave;
 
             if (!trk->mdat_buf) {
                 if ((ret = avio_open_dyn_buf(&trk->mdat_buf)) < 0)
@@ -5520,6 +5603,9 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
             if (ret) {
                 goto err;
             }
+        } else if (ref_data) {
+            if ((ret = mov_frag_ref_packet(trk, pkt)) < 0)
+                goto err;
         } else {
             avio_write(pb, pkt->data, size);
         }
@@ -5549,7 +5635,10 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
         trk->cluster_capacity = new_capacity;
     }
 
-    trk->cluster[trk->entry].pos              = avio_tell(pb) - size;
+    if (ref_data)
+        trk->cluster[trk->entry].pos          = mov_frag_data_size(trk) - size;
+    else
+        trk->cluster[trk->entry].pos          = avio_tell(pb) - size;
     trk->cluster[trk->entry].samples_in_chunk = samples_in_chunk;
     trk->cluster[trk->entry].chunkNum         = 0;
     trk->cluster[trk->entry].size             = size;
@@ -6103,6 +6192,9 @@ static void mov_free(AVFormatContext *s)
             av_freep(&mov->tracks[i].par);
         av_freep(&mov->tracks[i].cluster);
         av_freep(&mov->tracks[i].frag_info);
+        mov_frag_free_data(&mov->tracks[i]);
+        av_freep(&mov->tracks[i].frag_data);
+        ffio_free_dyn_buf(&mov->tracks[i].mdat_buf);
         av_packet_unref(&mov->tracks[i].cover_image);
 
         if (mov->tracks[i].eac3_priv) {
@@ -6239,7 +6331,9 @@ static int mov_init(AVFormatContext *s)
         mov->flags &= ~FF_MOV_FLAG_SKIP_SIDX;
     }
 
-    if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+    /* with moov_size, the moov is only moved if it does not fit */
+    if (mov->flags & FF_MOV_FLAG_FASTSTART &&
+        (mov->flags & FF_MOV_FLAG_FRAGMENT || mov->reserved_moov_size < 8)) {
         mov->reserved_moov_size = -1;
     }
 
@@ -6600,7 +6694,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->reserved_moov_size < 0)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -6798,6 +6892,84 @@ end:
     return ret;
 }
 
+/**
+ * Make room for the moov at reserved_header_pos by inserting a range into the
+ * output file, which the filesystem does without moving the data. The range
+ * starts at the block boundary before reserved_header_pos, so the start of the
+ * block is written again in front of the moov and the remainder of the range
+ * is covered by a free atom.
+ *
+ * @return the size of the free atom to write after the moov
+ */
+static int64_t insert_moov_space(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    URLContext *h = ffio_geturlcontext(s->pb);
+    int64_t pos = mov->reserved_header_pos, align, start, shift = 0, new_shift;
+    AVIOContext *read_pb;
+    uint8_t *head = NULL;
+    int i, fd, moov_size, head_size, ret;
+
+    /* the layout depends on the filesystem */
+    if (s->flags & AVFMT_FLAG_BITEXACT)
+        return AVERROR(ENOSYS);
+    if (!h || (fd = ffurl_get_file_handle(h)) < 0)
+        return AVERROR(ENOSYS);
+    if ((align = ff_insert_file_range_alignment(fd)) < 0)
+        return align;
+    start     = pos - pos % align;
+    head_size = pos - start;
+
+    /* offsets grow with the moov, which may then need 64 bit offsets */
+    moov_size = get_moov_size(s);
+    for (;;) {
+        if (moov_size < 0) {
+            ret = moov_size;
+            goto fail;
+        }
+        new_shift = FFALIGN(moov_size + 8, align);
+        if (new_shift <= shift)
+            break;
+        for (i = 0; i < mov->nb_streams; i++)
+            mov->tracks[i].data_offset += new_shift - shift;
+        shift     = new_shift;
+        moov_size = get_moov_size(s);
+    }
+
+    avio_flush(s->pb);
+    if (head_size) {
+        if (!(head = av_malloc(head_size))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        if ((ret = s->io_open(s, &read_pb, s->url, AVIO_FLAG_READ, NULL)) < 0)
+            goto fail;
+        if (avio_seek(read_pb, start, SEEK_SET) != start)
+            ret = AVERROR(EIO);
+        else
+            ret = avio_read(read_pb, head, head_size);
+        ff_format_io_close(s, &read_pb);
+        if (ret != head_size) {
+            ret = ret < 0 ? ret : AVERROR(EIO);
+            goto fail;
+        }
+    }
+
+    if ((ret = ff_insert_file_range(fd, start, shift)) < 0)
+        goto fail;
+
+    avio_seek(s->pb, start, SEEK_SET);
+    avio_write(s->pb, head, head_size);
+    av_free(head);
+    return shift - moov_size;
+
+fail:
+    av_free(head);
+    for (i = 0; i < mov->nb_streams; i++)
+        mov->tracks[i].data_offset -= shift;
+    return ret;
+}
+
 static int mov_write_trailer(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -6863,14 +7035,38 @@ static int mov_write_trailer(AVFormatContext *s)
         }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
-            av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
-            res = shift_data(s);
-            if (res < 0)
-                return res;
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size >= 8) {
+            int moov_size = get_moov_size(s);
+            if (moov_size < 0)
+                return moov_size;
+            if (mov->reserved_moov_size - moov_size < 8) {
+                av_log(s, AV_LOG_INFO, "reserved_moov_size is too small, needed %d additional\n",
+                       moov_size + 8 - mov->reserved_moov_size);
+                /* the reserved space is kept as a free atom after the moov */
+                avio_wb32(pb, mov->reserved_moov_size);
+                ffio_wfourcc(pb, "free");
+                mov->reserved_moov_size = -1;
+            }
+        }
+
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size <= 0) {
+            int64_t free_size = insert_moov_space(s);
+            if (free_size < 0) {
+                av_log(s, AV_LOG_VERBOSE, "Cannot insert space for the moov atom: %s\n",
+                       av_err2str(free_size));
+                av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
+                res = shift_data(s);
+                if (res < 0)
+                    return res;
+                free_size = 0;
+            }
             avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
                 return res;
+            if (free_size) {
+                avio_wb32(pb, free_size);
+                ffio_wfourcc(pb, "free");
+            }
         } else if (mov->reserved_moov_size > 0) {
             int64_t size;
             if ((res = mov_write_moov_tag(pb, mov, s)) < 0)
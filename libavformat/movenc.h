@@ -73,6 +73,12 @@ typedef struct HintSampleQueue {
     HintSample *samples;
 } HintSampleQueue;
 
+typedef struct MOVFragmentData {
+    AVBufferRef *buf;
+    uint8_t *data;
+    int size;
+} MOVFragmentData;
+
 typedef struct MOVFragmentInfo {
     int64_t offset;
     int64_t time;
@@ -137,6 +143,10 @@ typedef struct MOVTrack {
     AVPacket cover_image;
 
     AVIOContext *mdat_buf;
+    MOVFragmentData *frag_data;         ///< sample data of the current fragment, preceding mdat_buf
+    int         nb_frag_data;
+    unsigned    frag_data_capacity;
+    int64_t     frag_data_size;
     int64_t     data_offset;
     int64_t     frag_start;
     int         frag_discont;
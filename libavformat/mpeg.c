@@ -687,6 +687,7 @@ AVInputFormat ff_mpegps_demuxer = {
     .read_packet    = mpegps_read_packet,
     .read_timestamp = mpegps_read_dts,
     .flags          = AVFMT_SHOW_IDS | AVFMT_TS_DISCONT,
+    .flags_internal = FF_FMT_FLAG_SEEK_INDEX,
 };
 
 #if CONFIG_VOBSUB_DEMUXER
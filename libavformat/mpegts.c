@@ -2833,15 +2833,31 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
         return 0;
     }
 
-    for (i = 0; i < ts->resync_size; i++) {
-        c = avio_r8(pb);
-        if (avio_feof(pb))
-            return AVERROR_EOF;
-        if (c == 0x47) {
-            avio_seek(pb, -1, SEEK_CUR);
+    for (i = 0; i < ts->resync_size; ) {
+        const uint8_t *sync;
+        int len = FFMIN(pb->buf_end - pb->buf_ptr, ts->resync_size - i);
+
+        if (len <= 0) {
+            c = avio_r8(pb);
+            if (avio_feof(pb))
+                return AVERROR_EOF;
+            if (c == 0x47) {
+                avio_seek(pb, -1, SEEK_CUR);
+                reanalyze(s->priv_data);
+                return 0;
+            }
+            i++;
+            continue;
+        }
+        /* search what is buffered at once */
+        sync = memchr(pb->buf_ptr, 0x47, len);
+        if (sync) {
+            avio_skip(pb, sync - pb->buf_ptr);
             reanalyze(s->priv_data);
             return 0;
         }
+        avio_skip(pb, len);
+        i += len;
     }
     av_log(s, AV_LOG_ERROR,
            "max resync size reached, could not find sync byte\n");
@@ -2883,12 +2899,48 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+/**
+ * Skip the packets available in the I/O buffer which handle_packet() would
+ * drop right away: those of PIDs without a filter, and those of PIDs which
+ * are discarded along with their programs.
+ *
+ * @return number of packets skipped
+ */
+static int skip_discarded_packets(MpegTSContext *ts, int64_t max_packets)
+{
+    AVIOContext *pb = ts->stream->pb;
+    const uint8_t *p = pb->buf_ptr;
+    int64_t nb = FFMIN((pb->buf_end - p) / ts->raw_packet_size, max_packets);
+    int i;
+
+    for (i = 0; i < nb; i++, p += ts->raw_packet_size) {
+        int pid = AV_RB16(p + 1) & 0x1fff;
+        int is_start = p[1] & 0x40;
+        MpegTSFilter *tss = ts->pids[pid];
+
+        if (p[0] != 0x47)
+            break;
+        if (!tss) {
+            if (ts->auto_guess && is_start)
+                break;
+            continue;
+        }
+        if (is_start)
+            tss->discard = discard_pid(ts, pid);
+        if (!tss->discard)
+            break;
+    }
+    if (i)
+        avio_skip(pb, i * (int64_t)ts->raw_packet_size);
+    return i;
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
     uint8_t packet[TS_PACKET_SIZE + AV_INPUT_BUFFER_PADDING_SIZE];
     const uint8_t *data;
-    int64_t packet_num;
+    int64_t packet_num, skipped;
     int ret = 0;
 
     if (avio_tell(s->pb) != ts->last_pos) {
@@ -2924,6 +2976,12 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        skipped = skip_discarded_packets(ts, nb_packets ? nb_packets - packet_num : INT64_MAX);
+        if (skipped) {
+            packet_num += skipped - 1;
+            continue;
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
@@ -3347,6 +3405,7 @@ AVInputFormat ff_mpegts_demuxer = {
     .read_close     = mpegts_read_close,
     .read_timestamp = mpegts_get_dts,
     .flags          = AVFMT_SHOW_IDS | AVFMT_TS_DISCONT,
+    .flags_internal = FF_FMT_FLAG_SEEK_INDEX,
     .priv_class     = &mpegts_class,
 };
 
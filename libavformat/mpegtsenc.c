@@ -110,6 +110,11 @@ typedef struct MpegTSWrite {
     int64_t last_sdt_ts;
 
     int omit_video_pes_length;
+
+    int batch_packets;
+    uint8_t *batch;   ///< TS packets assembled but not yet written
+    int batch_len;
+    int batch_size;
 } MpegTSWrite;
 
 /* a PES packet header is generated every DEFAULT_PES_HEADER_FREQ packets */
@@ -717,13 +722,49 @@ invalid:
 
 static int64_t get_pcr(const MpegTSWrite *ts, AVIOContext *pb)
 {
-    return av_rescale(avio_tell(pb) + 11, 8 * PCR_TIME_BASE, ts->mux_rate) +
-           ts->first_pcr;
+    return av_rescale(avio_tell(pb) + ts->batch_len + 11, 8 * PCR_TIME_BASE,
+                      ts->mux_rate) + ts->first_pcr;
+}
+
+static void flush_batch(AVFormatContext *s)
+{
+    MpegTSWrite *ts = s->priv_data;
+
+    if (ts->batch_len) {
+        avio_write(s->pb, ts->batch, ts->batch_len);
+        ts->batch_len = 0;
+    }
+}
+
+/* Return where the next TS packet should be built: directly in the batch
+ * buffer if batching is enabled, in the caller's buffer otherwise. */
+static uint8_t *get_packet_buf(MpegTSWrite *ts, uint8_t *packet)
+{
+    if (!ts->batch)
+        return packet;
+    return ts->batch + ts->batch_len + (ts->m2ts_mode ? 4 : 0);
 }
 
 static void write_packet(AVFormatContext *s, const uint8_t *packet)
 {
     MpegTSWrite *ts = s->priv_data;
+
+    if (ts->batch) {
+        uint8_t *q = ts->batch + ts->batch_len;
+
+        if (ts->m2ts_mode) {
+            AV_WB32(q, get_pcr(ts, s->pb) % 0x3fffffff);
+            q += 4;
+        }
+        if (packet != q)
+            memcpy(q, packet, TS_PACKET_SIZE);
+        ts->batch_len = q + TS_PACKET_SIZE - ts->batch;
+        /* always keep room for one more packet */
+        if (ts->batch_len > ts->batch_size - TS_PACKET_SIZE - 4)
+            flush_batch(s);
+        return;
+    }
+
     if (ts->m2ts_mode) {
         int64_t pcr = get_pcr(s->priv_data, s->pb);
         uint32_t tp_extra_header = pcr % 0x3fffffff;
@@ -866,6 +907,12 @@ static int mpegts_init(AVFormatContext *s)
     // round up to a whole number of TS packets
     ts->pes_payload_size = (ts->pes_payload_size + 14 + 183) / 184 * 184 - 14;
 
+    if (ts->batch_packets) {
+        ts->batch_size = ts->batch_packets * (TS_PACKET_SIZE + 4);
+        if (!(ts->batch = av_malloc(ts->batch_size)))
+            return AVERROR(ENOMEM);
+    }
+
     ts->tsid = ts->transport_stream_id;
     ts->onid = ts->original_network_id;
     if (!s->nb_programs) {
@@ -1062,7 +1109,8 @@ static int write_pcr_bits(uint8_t *buf, int64_t pcr)
 static void mpegts_insert_null_packet(AVFormatContext *s)
 {
     uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t packet[TS_PACKET_SIZE];
+    uint8_t *buf = get_packet_buf(s->priv_data, packet);
 
     q    = buf;
     *q++ = 0x47;
@@ -1079,7 +1127,8 @@ static void mpegts_insert_pcr_only(AVFormatContext *s, AVStream *st)
     MpegTSWrite *ts = s->priv_data;
     MpegTSWriteStream *ts_st = st->priv_data;
     uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t packet[TS_PACKET_SIZE];
+    uint8_t *buf = get_packet_buf(ts, packet);
 
     q    = buf;
     *q++ = 0x47;
@@ -1159,7 +1208,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
 {
     MpegTSWriteStream *ts_st = st->priv_data;
     MpegTSWrite *ts = s->priv_data;
-    uint8_t buf[TS_PACKET_SIZE];
+    uint8_t packet[TS_PACKET_SIZE], *buf;
     uint8_t *q;
     int val, is_start, len, header_len, write_pcr, is_dvb_subtitle, is_dvb_teletext, flags;
     int afc_len, stuffing_len;
@@ -1167,7 +1216,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
     int force_pat = st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && key && !ts_st->prev_payload_key;
     int force_sdt = 0;
 
-    av_assert0(ts_st->payload != buf || st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO);
+    av_assert0(ts_st->payload != packet || st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO);
     if (ts->flags & MPEGTS_FLAG_PAT_PMT_AT_FRAMES && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
         force_pat = 1;
     }
@@ -1234,6 +1283,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
         }
 
         /* prepare packet header */
+        buf  = get_packet_buf(ts, packet);
         q    = buf;
         *q++ = 0x47;
         val  = ts_st->pid >> 8;
@@ -1444,6 +1494,7 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
         write_packet(s, buf);
     }
     ts_st->prev_payload_key = key;
+    flush_batch(s);
 }
 
 int ff_check_h264_startcode(AVFormatContext *s, const AVStream *st, const AVPacket *pkt)
@@ -1797,6 +1848,7 @@ static void mpegts_write_flush(AVFormatContext *s)
         while (packets++ < 32)
             mpegts_insert_null_packet(s);
     }
+    flush_batch(s);
 }
 
 static int mpegts_write_packet(AVFormatContext *s, AVPacket *pkt)
@@ -1840,6 +1892,7 @@ static void mpegts_deinit(AVFormatContext *s)
         av_freep(&service);
     }
     av_freep(&ts->services);
+    av_freep(&ts->batch);
 }
 
 static int mpegts_check_bitstream(struct AVFormatContext *s, const AVPacket *pkt)
@@ -1952,6 +2005,9 @@ static const AVOption options[] = {
     { "sdt_period", "SDT retransmission time limit in seconds",
       offsetof(MpegTSWrite, sdt_period_us), AV_OPT_TYPE_DURATION,
       { .i64 = SDT_RETRANS_TIME * 1000LL }, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM },
+    { "batch_packets", "Number of TS packets to assemble before writing them, 0 to write them one by one",
+      offsetof(MpegTSWrite, batch_packets), AV_OPT_TYPE_INT,
+      { .i64 = 0 }, 0, 65536, AV_OPT_FLAG_ENCODING_PARAM },
     { NULL },
 };
 
@@ -857,6 +857,7 @@ static int do_packet_auto_bsf(AVFormatContext *s, AVPacket *pkt) {
 
     for (i = 0; i < st->internal->nb_bsfcs; i++) {
         AVBSFContext *ctx = st->internal->bsfcs[i];
+        const AVBuffer *buf = pkt->buf ? pkt->buf->buffer : NULL;
         // TODO: when any bitstream filter requires flushing at EOF, we'll need to
         // flush each stream's BSF chain on write_trailer.
         if ((ret = av_bsf_send_packet(ctx, pkt)) < 0) {
@@ -878,6 +879,8 @@ static int do_packet_auto_bsf(AVFormatContext *s, AVPacket *pkt) {
                 return ret;
             return 0;
         }
+        if (pkt->buf && pkt->buf->buffer != buf)
+            s->copied_bytes += pkt->size;
     }
     return 1;
 }
@@ -938,6 +941,8 @@ int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
         av_assert0(pkt->size == UNCODED_FRAME_PACKET_SIZE);
         av_assert0(((AVFrame *)pkt->data)->buf);
     } else {
+        if (!pkt->buf)
+            s->copied_bytes += pkt->size;
         if ((ret = av_packet_make_refcounted(pkt)) < 0) {
             av_free(this_pktl);
             return ret;
@@ -59,6 +59,8 @@ static const AVOption avformat_options[] = {
 {"bitexact", "do not write random/volatile data", 0, AV_OPT_TYPE_CONST, { .i64 = AVFMT_FLAG_BITEXACT }, 0, 0, E, "fflags" },
 {"shortest", "stop muxing with the shortest stream", 0, AV_OPT_TYPE_CONST, { .i64 = AVFMT_FLAG_SHORTEST }, 0, 0, E, "fflags" },
 {"autobsf", "add needed bsfs automatically", 0, AV_OPT_TYPE_CONST, { .i64 = AVFMT_FLAG_AUTO_BSF }, 0, 0, E, "fflags" },
+{"zerocopy", "return packets pointing into the I/O buffer", 0, AV_OPT_TYPE_CONST, { .i64 = AVFMT_FLAG_ZERO_COPY }, 0, 0, D, "fflags" },
+{"fastprobe", "stop probing as soon as the parameters of all known streams are found", 0, AV_OPT_TYPE_CONST, { .i64 = AVFMT_FLAG_FAST_PROBE }, 0, 0, D, "fflags" },
 {"seek2any", "allow seeking to non-keyframes on demuxer level when supported", OFFSET(seek2any), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, D},
 {"analyzeduration", "specify how many microseconds are analyzed to probe the input", OFFSET(max_analyze_duration), AV_OPT_TYPE_INT64, {.i64 = 0 }, 0, INT64_MAX, D},
 {"cryptokey", "decryption key", OFFSET(key), AV_OPT_TYPE_BINARY, {.dbl = 0}, 0, 0, D},
@@ -112,6 +114,8 @@ static const AVOption avformat_options[] = {
 {"max_streams", "maximum number of streams", OFFSET(max_streams), AV_OPT_TYPE_INT, { .i64 = 1000 }, 0, INT_MAX, D },
 {"skip_estimate_duration_from_pts", "skip duration calculation in estimate_timings_from_pts", OFFSET(skip_estimate_duration_from_pts), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, D},
 {"max_probe_packets", "Maximum number of packets to probe a codec", OFFSET(max_probe_packets), AV_OPT_TYPE_INT, { .i64 = 2500 }, 0, INT_MAX, D },
+{"index_cache", "file caching the seek index across opens", OFFSET(index_cache), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+{"probe_threads", "number of threads decoding streams while probing", OFFSET(probe_threads), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, INT_MAX, D},
 {NULL},
 };
 
@@ -23,11 +23,44 @@
 /* needed by inet_aton() */
 #define _DEFAULT_SOURCE
 #define _SVID_SOURCE
+/* needed by fallocate() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 
 #include "config.h"
 #include "avformat.h"
 #include "os_support.h"
 
+#if HAVE_FALLOCATE
+#include <errno.h>
+#include <fcntl.h>
+#endif
+
+int64_t ff_insert_file_range_alignment(int fd)
+{
+#if HAVE_FALLOCATE && defined(FALLOC_FL_INSERT_RANGE)
+    struct stat st;
+
+    if (fstat(fd, &st) < 0)
+        return AVERROR(errno);
+    return st.st_blksize > 0 ? st.st_blksize : AVERROR(ENOSYS);
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int ff_insert_file_range(int fd, int64_t offset, int64_t size)
+{
+#if HAVE_FALLOCATE && defined(FALLOC_FL_INSERT_RANGE)
+    if (fallocate(fd, FALLOC_FL_INSERT_RANGE, offset, size) < 0)
+        return AVERROR(errno);
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
 #if CONFIG_NETWORK
 #include <fcntl.h>
 #if !HAVE_POLL_H
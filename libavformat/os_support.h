@@ -29,8 +29,28 @@
 
 #include "config.h"
 
+#include <stdint.h>
 #include <sys/stat.h>
 
+/**
+ * Get the granularity of ff_insert_file_range() for a file.
+ *
+ * @return the alignment of the offset and size, AVERROR(ENOSYS) if inserting
+ *         ranges is not supported on this system
+ */
+int64_t ff_insert_file_range_alignment(int fd);
+
+/**
+ * Insert a range of zeros into a file without rewriting the data following
+ * offset, if the filesystem supports it.
+ *
+ * @param offset position of the range, aligned as reported by
+ *               ff_insert_file_range_alignment(), before the end of the file
+ * @param size   size of the range, aligned the same way
+ * @return 0 on success, a negative AVERROR code otherwise
+ */
+int ff_insert_file_range(int fd, int64_t offset, int64_t size);
+
 #ifdef _WIN32
 #if HAVE_DIRECT_H
 #include <direct.h>
@@ -0,0 +1,402 @@
+/*
+ * Segment prefetching for segmenting demuxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "internal.h"
+#include "url.h"
+#include "prefetch.h"
+
+#define PREFETCH_CHUNK_SIZE 65536
+
+enum PrefetchState {
+    PREFETCH_IDLE,
+    PREFETCH_LOADING,
+    PREFETCH_DONE,
+};
+
+typedef struct PrefetchSlot {
+    Prefetch *p;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    enum PrefetchState state;
+    int cancel;
+    PrefetchSegment seg;    ///< copy, the playlist may be reloaded meanwhile
+    AVDictionary *avio_opts;
+    AVIOInterruptCB int_cb;
+    AVIOContext *input;
+    uint8_t *buf;
+    unsigned int buf_size;
+    int buf_len;
+    int ret;
+} PrefetchSlot;
+
+struct Prefetch {
+    AVFormatContext *s;
+    PrefetchSlot *slots;
+    int nb_slots;
+    int64_t max_len;        ///< bytes read into memory per segment
+    PrefetchOpenFunc open;
+    void *opaque;
+
+#if HAVE_THREADS
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+    int abort;
+};
+
+#if HAVE_THREADS
+static int slot_cancelled(PrefetchSlot *slot)
+{
+    Prefetch *p = slot->p;
+    int cancel;
+
+    pthread_mutex_lock(&p->mutex);
+    cancel = slot->cancel || p->abort;
+    pthread_mutex_unlock(&p->mutex);
+    return cancel;
+}
+
+static int slot_interrupt(void *opaque)
+{
+    PrefetchSlot *slot = opaque;
+
+    return slot_cancelled(slot) ||
+           ff_check_interrupt(&slot->p->s->interrupt_callback);
+}
+
+static int fetch_segment(Prefetch *p, PrefetchSlot *slot)
+{
+    int64_t max_len = p->max_len;
+    int64_t size;
+    int ret;
+
+    slot->buf_len = 0;
+    ret = p->open(p->opaque, &slot->seg, &slot->avio_opts, &slot->int_cb,
+                  &slot->input);
+    if (ret < 0)
+        return ret;
+
+    size = slot->seg.size >= 0 ? slot->seg.size : avio_size(slot->input);
+    if (size >= 0)
+        max_len = FFMIN(max_len, size);
+
+    while (slot->buf_len < max_len && !slot_cancelled(slot)) {
+        int len = FFMIN(max_len - slot->buf_len, PREFETCH_CHUNK_SIZE);
+        uint8_t *buf = av_fast_realloc(slot->buf, &slot->buf_size,
+                                       size >= 0 ? max_len : slot->buf_len + len);
+        if (!buf)
+            return AVERROR(ENOMEM);
+        slot->buf = buf;
+
+        ret = avio_read(slot->input, slot->buf + slot->buf_len, len);
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0)
+            return ret;
+        slot->buf_len += ret;
+    }
+    return 0;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    PrefetchSlot *slot = arg;
+    Prefetch *p = slot->p;
+    int ret;
+
+    pthread_mutex_lock(&p->mutex);
+    while (!p->abort) {
+        if (slot->state != PREFETCH_LOADING) {
+            pthread_cond_wait(&p->cond, &p->mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&p->mutex);
+        ret = fetch_segment(p, slot);
+        pthread_mutex_lock(&p->mutex);
+        slot->ret   = ret;
+        slot->state = PREFETCH_DONE;
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->mutex);
+    return NULL;
+}
+
+static void reset_slot(Prefetch *p, PrefetchSlot *slot)
+{
+    ff_format_io_close(p->s, &slot->input);
+    slot->buf_len = 0;
+    slot->cancel  = 0;
+    slot->state   = PREFETCH_IDLE;
+}
+
+static int slot_match(const PrefetchSlot *slot, const PrefetchSegment *seg)
+{
+    return slot->state != PREFETCH_IDLE && !slot->cancel &&
+           slot->seg.id == seg->id && !strcmp(slot->seg.url, seg->url) &&
+           slot->seg.url_offset == seg->url_offset && slot->seg.size == seg->size;
+}
+
+void ff_prefetch_free(Prefetch **pp)
+{
+    Prefetch *p = *pp;
+    int i;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->mutex);
+    p->abort = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+
+    for (i = 0; i < p->nb_slots; i++) {
+        PrefetchSlot *slot = &p->slots[i];
+
+        pthread_join(slot->thread, NULL);
+        ff_format_io_close(p->s, &slot->input);
+        av_freep(&slot->buf);
+        av_freep(&slot->seg.url);
+        av_dict_free(&slot->avio_opts);
+    }
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+    av_freep(&p->slots);
+    av_freep(pp);
+}
+
+int ff_prefetch_alloc(Prefetch **pp, AVFormatContext *s, int nb_workers,
+                      int64_t max_size, PrefetchOpenFunc open, void *opaque)
+{
+    Prefetch *p;
+    int i, ret;
+
+    *pp = NULL;
+    if (nb_workers <= 0)
+        return AVERROR(EINVAL);
+    if (!(p = av_mallocz(sizeof(*p))))
+        return AVERROR(ENOMEM);
+    p->slots = av_mallocz_array(nb_workers, sizeof(*p->slots));
+    if (!p->slots) {
+        av_free(p);
+        return AVERROR(ENOMEM);
+    }
+    p->s       = s;
+    p->max_len = FFMIN(max_size / nb_workers, INT_MAX);
+    p->open    = open;
+    p->opaque  = opaque;
+
+    if ((ret = pthread_mutex_init(&p->mutex, NULL))) {
+        av_free(p->slots);
+        av_free(p);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&p->cond, NULL))) {
+        pthread_mutex_destroy(&p->mutex);
+        av_free(p->slots);
+        av_free(p);
+        return AVERROR(ret);
+    }
+
+    for (i = 0; i < nb_workers; i++) {
+        PrefetchSlot *slot = &p->slots[i];
+
+        slot->p = p;
+        slot->int_cb.callback = slot_interrupt;
+        slot->int_cb.opaque   = slot;
+        if ((ret = pthread_create(&slot->thread, NULL, prefetch_thread, slot))) {
+            ff_prefetch_free(&p);
+            return AVERROR(ret);
+        }
+        p->nb_slots++;
+    }
+    *pp = p;
+    return 0;
+}
+
+void ff_prefetch_schedule(Prefetch *p, const PrefetchSegment *segs, int nb_segs,
+                          AVDictionary *avio_opts)
+{
+    int i, j;
+
+    pthread_mutex_lock(&p->mutex);
+
+    /* drop segments which are not needed anymore, e.g. after seeking */
+    for (i = 0; i < p->nb_slots; i++) {
+        PrefetchSlot *slot = &p->slots[i];
+
+        for (j = 0; j < nb_segs && !slot_match(slot, &segs[j]); j++)
+            ;
+        if (slot->state == PREFETCH_IDLE || j < nb_segs)
+            continue;
+        if (slot->state == PREFETCH_LOADING)
+            slot->cancel = 1;
+        else
+            reset_slot(p, slot);
+    }
+
+    for (j = 0; j < nb_segs; j++) {
+        PrefetchSlot *slot = NULL;
+
+        for (i = 0; i < p->nb_slots; i++) {
+            if (slot_match(&p->slots[i], &segs[j]))
+                break;
+            if (p->slots[i].state == PREFETCH_IDLE && !slot)
+                slot = &p->slots[i];
+        }
+        if (i < p->nb_slots)
+            continue;
+        if (!slot)
+            break;
+
+        av_freep(&slot->seg.url);
+        av_dict_free(&slot->avio_opts);
+        slot->seg     = segs[j];
+        slot->seg.url = av_strdup(segs[j].url);
+        if (!slot->seg.url || av_dict_copy(&slot->avio_opts, avio_opts, 0) < 0)
+            break;
+        slot->state = PREFETCH_LOADING;
+    }
+
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+}
+
+int ff_prefetch_take(Prefetch *p, const PrefetchSegment *seg, AVIOContext **pb,
+                     PrefetchBuffer *buf)
+{
+    PrefetchSlot *slot = NULL;
+    int i, ret = AVERROR(EAGAIN);
+
+    pthread_mutex_lock(&p->mutex);
+    for (i = 0; i < p->nb_slots; i++) {
+        if (slot_match(&p->slots[i], seg)) {
+            slot = &p->slots[i];
+            break;
+        }
+    }
+    if (slot) {
+        while (slot->state == PREFETCH_LOADING)
+            pthread_cond_wait(&p->cond, &p->mutex);
+
+        if (slot->ret >= 0) {
+            ff_format_io_close(p->s, pb);
+            *pb = slot->input;
+            slot->input = NULL;
+            FFSWAP(uint8_t *, buf->data, slot->buf);
+            FFSWAP(unsigned int, buf->size, slot->buf_size);
+            buf->len    = slot->buf_len;
+            buf->offset = 0;
+            buf->pos    = avio_tell(*pb) - buf->len;
+            ret = 0;
+        } else {
+            av_log(p->s, AV_LOG_VERBOSE, "Prefetching '%s' failed: %s\n",
+                   slot->seg.url, av_err2str(slot->ret));
+        }
+        reset_slot(p, slot);
+    }
+    pthread_mutex_unlock(&p->mutex);
+    return ret;
+}
+#else
+int ff_prefetch_alloc(Prefetch **pp, AVFormatContext *s, int nb_workers,
+                      int64_t max_size, PrefetchOpenFunc open, void *opaque)
+{
+    *pp = NULL;
+    return AVERROR(ENOSYS);
+}
+
+void ff_prefetch_schedule(Prefetch *p, const PrefetchSegment *segs, int nb_segs,
+                          AVDictionary *avio_opts)
+{
+}
+
+int ff_prefetch_take(Prefetch *p, const PrefetchSegment *seg, AVIOContext **pb,
+                     PrefetchBuffer *buf)
+{
+    return AVERROR(EAGAIN);
+}
+
+void ff_prefetch_free(Prefetch **pp)
+{
+}
+#endif
+
+int ff_prefetch_buffer_read(PrefetchBuffer *buf, AVIOContext *pb,
+                            uint8_t *dst, int size)
+{
+    int ret, ret2;
+
+    if (buf->offset >= buf->len)
+        return avio_read(pb, dst, size);
+
+    ret = FFMIN(size, buf->len - buf->offset);
+    memcpy(dst, buf->data + buf->offset, ret);
+    buf->offset += ret;
+    /* continue with the part of the segment that was not prefetched */
+    if (ret < size) {
+        ret2 = avio_read(pb, dst + ret, size - ret);
+        if (ret2 > 0)
+            ret += ret2;
+    }
+    return ret;
+}
+
+int64_t ff_prefetch_buffer_seek(PrefetchBuffer *buf, AVIOContext *pb,
+                                int64_t offset, int whence)
+{
+    int64_t ret;
+
+    if (!buf->len || whence == AVSEEK_SIZE)
+        return avio_seek(pb, offset, whence);
+
+    if (whence == SEEK_CUR) {
+        offset += buf->offset < buf->len ? buf->pos + buf->offset : avio_tell(pb);
+        whence  = SEEK_SET;
+    }
+    /* the input is positioned after the buffered data, keep it there */
+    if (whence == SEEK_SET && offset >= buf->pos && offset < buf->pos + buf->len) {
+        if ((ret = avio_seek(pb, buf->pos + buf->len, SEEK_SET)) < 0)
+            return ret;
+        buf->offset = offset - buf->pos;
+        return offset;
+    }
+
+    ff_prefetch_buffer_reset(buf);
+    return avio_seek(pb, offset, whence);
+}
+
+void ff_prefetch_buffer_reset(PrefetchBuffer *buf)
+{
+    buf->len = buf->offset = 0;
+}
+
+void ff_prefetch_buffer_free(PrefetchBuffer *buf)
+{
+    av_freep(&buf->data);
+    buf->size = 0;
+    ff_prefetch_buffer_reset(buf);
+}
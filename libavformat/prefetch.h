@@ -0,0 +1,123 @@
+/*
+ * Segment prefetching for segmenting demuxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PREFETCH_H
+#define AVFORMAT_PREFETCH_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "avformat.h"
+#include "avio.h"
+
+/**
+ * Segments following the one being demuxed, downloaded by worker threads,
+ * each using its own connection. A worker reads its segment into memory up
+ * to a size limit and leaves the rest to be read from its still open input.
+ */
+typedef struct Prefetch Prefetch;
+
+typedef struct PrefetchSegment {
+    char *url;          ///< absolute URL
+    int64_t url_offset; ///< start of the byte range
+    int64_t size;       ///< size of the byte range, -1 for the whole resource
+    int64_t id;         ///< matched along with the URL and range, e.g. a sequence number
+} PrefetchSegment;
+
+/**
+ * Data of the current segment read ahead, read before the rest of the
+ * segment from its input.
+ */
+typedef struct PrefetchBuffer {
+    uint8_t *data;
+    unsigned int size;
+    int len;
+    int offset;         ///< bytes of data already read
+    int64_t pos;        ///< position of data in the input
+} PrefetchBuffer;
+
+/**
+ * Open a segment, called from the worker threads.
+ *
+ * @param avio_opts options to open the segment with, private to the worker
+ * @param int_cb    interrupt callback of the worker, which also fires once
+ *                  the segment is not wanted anymore
+ */
+typedef int (*PrefetchOpenFunc)(void *opaque, const PrefetchSegment *seg,
+                                AVDictionary **avio_opts,
+                                const AVIOInterruptCB *int_cb, AVIOContext **pb);
+
+/**
+ * Start the worker threads.
+ *
+ * @param s          the demuxer, used for io_close(), interrupts and logging
+ * @param nb_workers number of segments downloaded ahead
+ * @param max_size   number of bytes held in memory, split evenly between
+ *                   the workers
+ * @return 0 on success, AVERROR(ENOSYS) if threads are not available, a
+ *         negative error code otherwise
+ */
+int ff_prefetch_alloc(Prefetch **p, AVFormatContext *s, int nb_workers,
+                      int64_t max_size, PrefetchOpenFunc open, void *opaque);
+
+/**
+ * Have the workers download the segments following the current one, in
+ * order. Segments being downloaded which are not listed are dropped, e.g.
+ * after seeking.
+ *
+ * @param avio_opts options copied for each new download
+ */
+void ff_prefetch_schedule(Prefetch *p, const PrefetchSegment *segs, int nb_segs,
+                          AVDictionary *avio_opts);
+
+/**
+ * Take the prefetched copy of seg, if any. The input in *pb is closed and
+ * replaced with the one of the copy, positioned after the data read into buf.
+ *
+ * @return 0 on success, AVERROR(EAGAIN) if seg has to be opened directly
+ */
+int ff_prefetch_take(Prefetch *p, const PrefetchSegment *seg, AVIOContext **pb,
+                     PrefetchBuffer *buf);
+
+/**
+ * Stop the worker threads and free everything.
+ */
+void ff_prefetch_free(Prefetch **p);
+
+/**
+ * Read from buf, then from pb once buf is exhausted.
+ */
+int ff_prefetch_buffer_read(PrefetchBuffer *buf, AVIOContext *pb,
+                            uint8_t *dst, int size);
+
+/**
+ * Seek pb, within buf if the target is in it, and drop buf otherwise.
+ */
+int64_t ff_prefetch_buffer_seek(PrefetchBuffer *buf, AVIOContext *pb,
+                                int64_t offset, int whence);
+
+/**
+ * Drop the data of buf, e.g. when opening the next segment directly.
+ */
+void ff_prefetch_buffer_reset(PrefetchBuffer *buf);
+
+void ff_prefetch_buffer_free(PrefetchBuffer *buf);
+
+#endif /* AVFORMAT_PREFETCH_H */
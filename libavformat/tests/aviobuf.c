@@ -0,0 +1,195 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Reads, seeks and skips at random positions of a synthetic resource with
+ * and without read-ahead, checking the data and position after each step.
+ * The callbacks fail the test if they are entered while a read is in
+ * flight on the read-ahead thread.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+#include "libavformat/avio.h"
+
+#define RESOURCE_SIZE (1 << 20)
+#define BUFFER_SIZE   4096
+#define SHORT_SEEK    (64 << 10)
+#define NB_STEPS      1000
+
+typedef struct Resource {
+    int64_t pos;
+    atomic_int in_read;
+    atomic_int overlaps;
+} Resource;
+
+static uint8_t byte_at(int64_t pos)
+{
+    return pos * 31 + (pos >> 8);
+}
+
+static void enter(Resource *r)
+{
+    if (atomic_fetch_add(&r->in_read, 1))
+        atomic_fetch_add(&r->overlaps, 1);
+}
+
+static void leave(Resource *r)
+{
+    atomic_fetch_sub(&r->in_read, 1);
+}
+
+static int read_packet(void *opaque, uint8_t *buf, int size)
+{
+    Resource *r = opaque;
+    int i;
+
+    enter(r);
+    /* give callers a chance to race with the read */
+    av_usleep(100);
+    size = FFMIN(size, RESOURCE_SIZE - r->pos);
+    for (i = 0; i < size; i++)
+        buf[i] = byte_at(r->pos + i);
+    r->pos += size;
+    leave(r);
+    return size ? size : AVERROR_EOF;
+}
+
+static int64_t seek(void *opaque, int64_t offset, int whence)
+{
+    Resource *r = opaque;
+    int64_t ret = AVERROR(EINVAL);
+
+    enter(r);
+    if (whence == AVSEEK_SIZE)
+        ret = RESOURCE_SIZE;
+    else if (whence == SEEK_SET && offset >= 0)
+        ret = r->pos = offset;
+    leave(r);
+    return ret;
+}
+
+static int short_seek_get(void *opaque)
+{
+    Resource *r = opaque;
+
+    enter(r);
+    leave(r);
+    return SHORT_SEEK;
+}
+
+static int check(AVIOContext *pb, AVLFG *lfg, uint8_t *buf)
+{
+    int64_t pos = 0;
+    int step, i;
+
+    for (step = 0; step < NB_STEPS; step++) {
+        unsigned rnd = av_lfg_get(lfg);
+        unsigned dist = av_lfg_get(lfg);
+        int64_t target;
+        int len;
+
+        switch (rnd % 4) {
+        case 0: /* far seek */
+            target = dist % RESOURCE_SIZE;
+            break;
+        case 1: /* short seek forward */
+            target = FFMIN(pos + dist % (BUFFER_SIZE + SHORT_SEEK), RESOURCE_SIZE);
+            break;
+        case 2: /* seek back within the buffer */
+            target = FFMAX(pos - dist % BUFFER_SIZE, 0);
+            break;
+        default:
+            target = pos;
+        }
+        if (target != pos) {
+            int64_t ret = rnd & 4 ? avio_skip(pb, target - pos)
+                                  : avio_seek(pb, target, SEEK_SET);
+            if (ret != target) {
+                printf("step %d: seeking from %"PRId64" to %"PRId64" returned %"PRId64"\n",
+                       step, pos, target, ret);
+                return 1;
+            }
+            pos = target;
+        }
+
+        len = av_lfg_get(lfg) % (3 * BUFFER_SIZE);
+        len = avio_read(pb, buf, len);
+        if (len < 0 && pos < RESOURCE_SIZE) {
+            printf("step %d: read at %"PRId64" failed\n", step, pos);
+            return 1;
+        }
+        for (i = 0; i < len; i++) {
+            if (buf[i] != byte_at(pos + i)) {
+                printf("step %d: mismatch at %"PRId64"\n", step, pos + i);
+                return 1;
+            }
+        }
+        pos += FFMAX(len, 0);
+        if (avio_tell(pb) != pos) {
+            printf("step %d: position %"PRId64" instead of %"PRId64"\n",
+                   step, avio_tell(pb), pos);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int test(int async_read)
+{
+    Resource r = { 0 };
+    AVIOContext *pb;
+    AVLFG lfg;
+    uint8_t *buffer = av_malloc(BUFFER_SIZE);
+    uint8_t *buf    = av_malloc(3 * BUFFER_SIZE);
+    int ret = 1;
+
+    if (!buffer || !buf)
+        goto end;
+    pb = avio_alloc_context(buffer, BUFFER_SIZE, 0, &r, read_packet, NULL, seek);
+    if (!pb)
+        goto end;
+    buffer = NULL;
+    pb->short_seek_get = short_seek_get;
+    pb->async_read     = async_read;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+    ret = check(pb, &lfg, buf);
+    if (atomic_load(&r.overlaps)) {
+        printf("callbacks entered %d times during a read\n",
+               atomic_load(&r.overlaps));
+        ret = 1;
+    }
+    printf("async_read=%d: %s\n", async_read, ret ? "failed" : "ok");
+
+    av_freep(&pb->buffer);
+    avio_context_free(&pb);
+end:
+    av_free(buffer);
+    av_free(buf);
+    return ret;
+}
+
+int main(void)
+{
+    return test(0) || test(1);
+}
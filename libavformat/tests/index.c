@@ -0,0 +1,159 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Builds the index of a synthetic MP4-like file with a 25 fps video track
+ * using 10 second GOPs and a 48 kHz AAC track, then checks lookups against
+ * a linear search. Some entries are only added after the rest, as when
+ * timestamp searches discover them. With -b, a 24 hour file is indexed and
+ * the time taken by each step is printed.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/lfg.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+#define GOP_SIZE   250
+#define LATE_EVERY 997
+
+static int64_t timestamp(int i, int step)
+{
+    return (int64_t)i * step;
+}
+
+static int ref_search(const AVStream *st, int64_t wanted, int flags)
+{
+    const AVIndexEntry *e = st->index_entries;
+    int n = st->nb_index_entries, m;
+
+    if (flags & AVSEEK_FLAG_BACKWARD) {
+        for (m = n - 1; m >= 0 && e[m].timestamp > wanted; m--);
+        if (!(flags & AVSEEK_FLAG_ANY))
+            while (m >= 0 && !(e[m].flags & AVINDEX_KEYFRAME))
+                m--;
+    } else {
+        for (m = 0; m < n && e[m].timestamp < wanted; m++);
+        if (!(flags & AVSEEK_FLAG_ANY))
+            while (m < n && !(e[m].flags & AVINDEX_KEYFRAME))
+                m++;
+    }
+    return m == n ? -1 : m;
+}
+
+static int add_entries(AVStream *st, int nb, int step, int gop, int late)
+{
+    int i;
+
+    for (i = 0; i < nb; i++) {
+        if ((i % LATE_EVERY == 0) != late)
+            continue;
+        if (av_add_index_entry(st, 1000LL * i, timestamp(i, step), 1000,
+                               0, i % gop ? 0 : AVINDEX_KEYFRAME) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int check(AVStream *st, AVLFG *lfg, int nb, int step, int nb_searches,
+                 int verify)
+{
+    static const int flags[] = { 0, AVSEEK_FLAG_BACKWARD, AVSEEK_FLAG_ANY,
+                                 AVSEEK_FLAG_ANY | AVSEEK_FLAG_BACKWARD };
+    int i;
+
+    if (st->nb_index_entries != nb)
+        return -1;
+    for (i = 1; i < nb; i++)
+        if (st->index_entries[i].timestamp <= st->index_entries[i - 1].timestamp)
+            return -1;
+
+    for (i = 0; i < nb_searches; i++) {
+        int64_t wanted = av_lfg_get(lfg) % (timestamp(nb, step) + step);
+        int f = flags[i & 3];
+        int ret = av_index_search_timestamp(st, wanted, f);
+
+        if (verify && ret != ref_search(st, wanted, f)) {
+            fprintf(stderr, "search %"PRId64" flags %d: got %d, expected %d\n",
+                    wanted, f, ret, ref_search(st, wanted, f));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        int rate, step, gop;
+    } tracks[] = {
+        { "video", 25,    1,    GOP_SIZE },
+        { "audio", 48000, 1024, 1        },
+    };
+    int bench = argc > 1 && !strcmp(argv[1], "-b");
+    int seconds = bench ? 24 * 3600 : 600;
+    AVFormatContext *s = avformat_alloc_context();
+    AVLFG lfg;
+    int i, ret = 0;
+
+    if (!s)
+        return 1;
+    av_lfg_init(&lfg, 0xdeadbeef);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(tracks); i++) {
+        AVStream *st = avformat_new_stream(s, NULL);
+        int nb = (int64_t)seconds * tracks[i].rate / tracks[i].step;
+        int64_t t0, t1, t2, t3;
+
+        if (!st) {
+            ret = 1;
+            break;
+        }
+        st->time_base = (AVRational){ 1, tracks[i].rate };
+
+        t0 = av_gettime_relative();
+        if (add_entries(st, nb, tracks[i].step, tracks[i].gop, 0) < 0) {
+            ret = 1;
+            break;
+        }
+        t1 = av_gettime_relative();
+        if (add_entries(st, nb, tracks[i].step, tracks[i].gop, 1) < 0) {
+            ret = 1;
+            break;
+        }
+        t2 = av_gettime_relative();
+        if (check(st, &lfg, nb, tracks[i].step, bench ? 1000000 : 2000, !bench) < 0) {
+            fprintf(stderr, "%s: index check failed\n", tracks[i].name);
+            ret = 1;
+            break;
+        }
+        t3 = av_gettime_relative();
+
+        printf("%s: %d entries\n", tracks[i].name, st->nb_index_entries);
+        if (bench)
+            printf("  append %"PRId64" us, late insert %"PRId64" us, "
+                   "1000000 searches %"PRId64" us\n", t1 - t0, t2 - t1, t3 - t2);
+    }
+
+    avformat_free_context(s);
+    return ret;
+}
@@ -0,0 +1,185 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Muxes synthetic MPEG-2 video and MP2 audio packets into MPEG-TS with and
+ * without batched packet writing and checks that the output is identical.
+ * With -b, 50 streams at a constant 400 Mbit/s are muxed and the time taken
+ * in each mode is printed.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/crc.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+typedef struct Output {
+    uint32_t crc;
+    int64_t size;
+    int writes;
+} Output;
+
+static int benchmark;
+
+static int io_write(void *opaque, uint8_t *buf, int size)
+{
+    Output *out = opaque;
+
+    if (!benchmark)
+        out->crc = av_crc(av_crc_get_table(AV_CRC_32_IEEE), out->crc, buf, size);
+    out->size += size;
+    out->writes++;
+    return size;
+}
+
+static int mux(Output *out, const char *opts_str, int nb_video, int nb_audio,
+               int seconds, int video_size)
+{
+    static uint8_t data[1 << 20];
+    AVFormatContext *s = NULL;
+    AVDictionary *opts = NULL;
+    uint8_t *iobuf = av_malloc(32768);
+    int i, ret, frames = seconds * 25;
+
+    memset(out, 0, sizeof(*out));
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = i * 13 + (i >> 11);
+
+    if (!iobuf)
+        return AVERROR(ENOMEM);
+    if ((ret = avformat_alloc_output_context2(&s, NULL, "mpegts", NULL)) < 0) {
+        av_free(iobuf);
+        return ret;
+    }
+    s->max_delay = 700000;
+    s->pb = avio_alloc_context(iobuf, 32768, 1, out, NULL, io_write, NULL);
+    if (!s->pb) {
+        av_free(iobuf);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    for (i = 0; i < nb_video + nb_audio; i++) {
+        AVStream *st = avformat_new_stream(s, NULL);
+        if (!st) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if (i < nb_video) {
+            st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+            st->codecpar->codec_id   = AV_CODEC_ID_MPEG2VIDEO;
+            st->codecpar->width      = 1920;
+            st->codecpar->height     = 1080;
+        } else {
+            st->codecpar->codec_type  = AVMEDIA_TYPE_AUDIO;
+            st->codecpar->codec_id    = AV_CODEC_ID_MP2;
+            st->codecpar->sample_rate = 48000;
+            st->codecpar->channels    = 2;
+        }
+    }
+
+    /* the muxer uses a 90 kHz time base for all streams */
+    if ((ret = av_dict_parse_string(&opts, opts_str, "=", ":", 0)) < 0 ||
+        (ret = avformat_write_header(s, &opts)) < 0)
+        goto end;
+
+    for (i = 0; i < frames && ret >= 0; i++) {
+        int j;
+
+        for (j = 0; j < nb_video + nb_audio && ret >= 0; j++) {
+            AVPacket pkt;
+
+            av_init_packet(&pkt);
+            pkt.stream_index = j;
+            if (j < nb_video) {
+                pkt.data  = data + i % 64 * 1024;
+                pkt.size  = i % 12 ? video_size : 4 * video_size;
+                pkt.pts   = pkt.dts = i * 3600LL;
+                pkt.flags = i % 12 ? 0 : AV_PKT_FLAG_KEY;
+            } else {
+                /* 40 ms of 128 kbit/s audio per video frame */
+                pkt.data  = data + (i + j) % 256 * 64;
+                pkt.size  = 640;
+                pkt.pts   = pkt.dts = i * 3600LL;
+                pkt.flags = AV_PKT_FLAG_KEY;
+            }
+            ret = av_write_frame(s, &pkt);
+        }
+    }
+    if (ret >= 0)
+        ret = av_write_trailer(s);
+
+end:
+    av_dict_free(&opts);
+    if (s && s->pb) {
+        avio_flush(s->pb);
+        av_freep(&s->pb->buffer);
+        avio_context_free(&s->pb);
+    }
+    avformat_free_context(s);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const modes[] = {
+        "",
+        "muxrate=20000000",
+        "muxrate=20000000:mpegts_m2ts_mode=1",
+    };
+    Output plain, batched;
+    int i;
+
+    if (argc > 1 && !strcmp(argv[1], "-b")) {
+        benchmark = 1;
+        for (i = 0; i < 2; i++) {
+            const char *opts = i ? "muxrate=400000000:batch_packets=64"
+                                 : "muxrate=400000000";
+            int64_t t0 = av_gettime_relative(), t1;
+
+            if (mux(&plain, opts, 10, 40, 60, 35000) < 0)
+                return 1;
+            t1 = av_gettime_relative();
+            printf("%-40s %"PRId64" bytes, %d writes, %"PRId64" us\n",
+                   opts, plain.size, plain.writes, t1 - t0);
+        }
+        return 0;
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(modes); i++) {
+        char opts[128];
+
+        snprintf(opts, sizeof(opts), "%s%sbatch_packets=64",
+                 modes[i], *modes[i] ? ":" : "");
+        if (mux(&plain,   modes[i], 2, 4, 4, 20000) < 0 ||
+            mux(&batched, opts,     2, 4, 4, 20000) < 0) {
+            fprintf(stderr, "%s: muxing failed\n", opts);
+            return 1;
+        }
+        if (plain.crc != batched.crc || plain.size != batched.size) {
+            fprintf(stderr, "%s: output differs\n", opts);
+            return 1;
+        }
+        printf("%s: %"PRId64" bytes, crc %08"PRIx32"\n",
+               *modes[i] ? modes[i] : "vbr", plain.size, plain.crc);
+    }
+    return 0;
+}
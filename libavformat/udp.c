@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -61,6 +62,10 @@
 #define IPPROTO_UDPLITE                                  136
 #endif
 
+#if HAVE_NETINET_UDP_H
+#include <netinet/udp.h>
+#endif
+
 #if HAVE_PTHREAD_CANCEL
 #include <pthread.h>
 #endif
@@ -74,6 +79,32 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_CONTROL_SIZE 128
+#define UDP_MAX_GSO_SIZE 65507
+#define UDP_MAX_SEGMENTS 64
+
+typedef struct UDPStats {
+    int64_t packets;
+    int64_t bytes;
+    int64_t overruns;
+    int64_t kernel_drops;
+} UDPStats;
+
+/* a datagram received or sent by the circular buffer thread */
+typedef struct UDPMessage {
+    uint8_t *data;
+    int len;
+    int segment_size;           ///< size of the coalesced datagrams, with gro
+    int64_t time;
+    struct sockaddr_storage addr;
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    struct iovec iov;
+    union {
+        struct cmsghdr hdr;
+        uint8_t buf[UDP_CONTROL_SIZE];
+    } control;
+#endif
+} UDPMessage;
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -104,7 +135,23 @@ typedef struct UDPContext {
     pthread_cond_t cond;
     int thread_started;
 #endif
-    uint8_t tmp[UDP_MAX_PKT_SIZE+4];
+    int batch_size;
+    UDPMessage *msgs;
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    struct mmsghdr *mmsgs;
+#endif
+    uint8_t *batch_buf;
+    int batch_buf_size;
+    int timestamps;
+    int64_t packet_time;
+    UDPStats stats;             ///< exported through the AVOptions
+    UDPStats thread_stats;      ///< updated by the circular buffer thread
+    int64_t kernel_drops;
+    int gso;
+    int gro;
+    uint8_t *gso_buf;           ///< datagrams waiting to be sent by udp_write()
+    int gso_len;
+    int gso_max_len;
     int remaining_in_dg;
     char *localaddr;
     int timeout;
@@ -117,6 +164,7 @@ typedef struct UDPContext {
 #define OFFSET(x) offsetof(UDPContext, x)
 #define D AV_OPT_FLAG_DECODING_PARAM
 #define E AV_OPT_FLAG_ENCODING_PARAM
+#define X (AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY)
 static const AVOption options[] = {
     { "buffer_size",    "System data size (in bytes)",                     OFFSET(buffer_size),    AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, .flags = D|E },
     { "bitrate",        "Bits to send per second",                         OFFSET(bitrate),        AV_OPT_TYPE_INT64,  { .i64 = 0  },     0, INT64_MAX, .flags = E },
@@ -136,6 +184,15 @@ static const AVOption options[] = {
     { "timeout",        "set raise error timeout (only in read mode)",     OFFSET(timeout),        AV_OPT_TYPE_INT,    { .i64 = 0 },      0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "batch_size",     "Max number of datagrams received or sent per system call by the circular buffer thread", OFFSET(batch_size), AV_OPT_TYPE_INT, { .i64 = 32 }, 1, 1024, .flags = D|E },
+    { "timestamps",     "Report the receive time of datagrams",            OFFSET(timestamps),     AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       D },
+    { "gso",            "Send datagrams by batches using UDP segmentation offload", OFFSET(gso), AV_OPT_TYPE_BOOL, { .i64 = 0 },  0, 1,       E },
+    { "gro",            "Receive datagrams coalesced by UDP receive offload", OFFSET(gro),     AV_OPT_TYPE_BOOL,   { .i64 = 0 },      0, 1,       D },
+    { "packet_time",    "Receive time of the last datagram read, in microseconds since the epoch", OFFSET(packet_time), AV_OPT_TYPE_INT64, { .i64 = AV_NOPTS_VALUE }, INT64_MIN, INT64_MAX, .flags = D|X },
+    { "packets",        "Number of datagrams received or sent",            OFFSET(stats.packets),  AV_OPT_TYPE_INT64,  { .i64 = 0 },      0, INT64_MAX, .flags = D|E|X },
+    { "bytes",          "Number of bytes received or sent",                OFFSET(stats.bytes),    AV_OPT_TYPE_INT64,  { .i64 = 0 },      0, INT64_MAX, .flags = D|E|X },
+    { "overruns",       "Number of datagrams dropped on circular buffer overrun", OFFSET(stats.overruns), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, .flags = D|X },
+    { "kernel_drops",   "Number of datagrams dropped by the system on socket buffer overrun", OFFSET(stats.kernel_drops), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, .flags = D|X },
     { NULL }
 };
 
@@ -454,11 +511,303 @@ static int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+#ifdef UDP_SEGMENT
+/**
+ * Send len bytes as datagrams of segment_size bytes, the last one possibly
+ * shorter, with a single system call.
+ */
+static int udp_send_segments(UDPContext *s, const uint8_t *buf, int len, int segment_size)
+{
+    struct iovec iov = { .iov_base = (void *)buf, .iov_len = len };
+    union {
+        struct cmsghdr hdr;
+        uint8_t buf[CMSG_SPACE(sizeof(uint16_t))];
+    } control;
+    struct msghdr msg = { 0 };
+    uint16_t size = segment_size;
+
+    if (!s->is_connected) {
+        msg.msg_name    = &s->dest_addr;
+        msg.msg_namelen = s->dest_addr_len;
+    }
+    msg.msg_iov    = &iov;
+    msg.msg_iovlen = 1;
+    if (len > segment_size) {
+        struct cmsghdr *cmsg;
+
+        memset(&control, 0, sizeof(control));
+        msg.msg_control    = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        cmsg               = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level   = IPPROTO_UDP;
+        cmsg->cmsg_type    = UDP_SEGMENT;
+        cmsg->cmsg_len     = CMSG_LEN(sizeof(size));
+        memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+    }
+    while (sendmsg(s->udp_fd, &msg, 0) < 0) {
+        int ret = ff_neterrno();
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+            return ret;
+    }
+    return 0;
+}
+
+/**
+ * Same as udp_send_segments(), sending the datagrams one by one if the
+ * system cannot segment them.
+ */
+static int udp_send_gso(UDPContext *s, const uint8_t *buf, int len, int segment_size)
+{
+    int ret, pos;
+
+    if (s->gso && len > segment_size) {
+        ret = udp_send_segments(s, buf, len, segment_size);
+        if (ret != AVERROR(EIO) && ret != AVERROR(EINVAL))
+            return ret;
+        av_log(s, AV_LOG_WARNING, "UDP segmentation offload failed, disabling it\n");
+        s->gso = 0;
+    }
+    pos = 0;
+    do {
+        int size = FFMIN(segment_size, len - pos);
+        if ((ret = udp_send_segments(s, buf + pos, size, segment_size)) < 0)
+            return ret;
+        pos += size;
+    } while (pos < len);
+    return 0;
+}
+#endif
+
+static int udp_flush_gso(URLContext *h)
+{
+#ifdef UDP_SEGMENT
+    UDPContext *s = h->priv_data;
+    int ret, len = s->gso_len;
+
+    if (!len)
+        return 0;
+    s->gso_len = 0;
+    ret = ff_network_wait_fd_timeout(s->udp_fd, 1, h->rw_timeout, &h->interrupt_callback);
+    if (ret < 0)
+        return ret;
+    ret = udp_send_gso(s, s->gso_buf, len, h->max_packet_size);
+    if (ret < 0)
+        return ret;
+    s->stats.packets += (len + h->max_packet_size - 1) / h->max_packet_size;
+    s->stats.bytes   += len;
+#endif
+    return 0;
+}
+
 #if HAVE_PTHREAD_CANCEL
+static int udp_alloc_messages(URLContext *h, int is_output)
+{
+    UDPContext *s = h->priv_data;
+    int i, slot_size;
+
+    if (is_output ? !HAVE_SENDMMSG : !HAVE_RECVMMSG)
+        s->batch_size = 1;
+    /* received datagrams get a slot of the maximum size each, datagrams to
+     * send are packed back to back */
+    slot_size         = is_output ? 0 : UDP_MAX_PKT_SIZE;
+    s->batch_buf_size = is_output ? FFMAX(s->batch_size * h->max_packet_size, UDP_MAX_PKT_SIZE + 4)
+                                  : s->batch_size * slot_size;
+
+    s->msgs      = av_mallocz_array(s->batch_size, sizeof(*s->msgs));
+    s->batch_buf = av_malloc(s->batch_buf_size);
+    if (!s->msgs || !s->batch_buf)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < s->batch_size; i++)
+        s->msgs[i].data = s->batch_buf + i * slot_size;
+
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    if (is_output ? HAVE_SENDMMSG : HAVE_RECVMMSG) {
+        s->mmsgs = av_mallocz_array(s->batch_size, sizeof(*s->mmsgs));
+        if (!s->mmsgs)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < s->batch_size; i++) {
+            struct msghdr *hdr = &s->mmsgs[i].msg_hdr;
+            hdr->msg_iov    = &s->msgs[i].iov;
+            hdr->msg_iovlen = 1;
+            if (!is_output) {
+                s->msgs[i].iov.iov_base = s->msgs[i].data;
+                s->msgs[i].iov.iov_len  = slot_size;
+                hdr->msg_name           = &s->msgs[i].addr;
+                hdr->msg_control        = s->msgs[i].control.buf;
+            }
+        }
+    }
+#endif
+    return 0;
+}
+
+static void udp_free_messages(UDPContext *s)
+{
+    av_freep(&s->msgs);
+    av_freep(&s->batch_buf);
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    av_freep(&s->mmsgs);
+#endif
+}
+
+#if HAVE_RECVMMSG
+static void udp_parse_control(UDPContext *s, struct msghdr *hdr, UDPMessage *msg)
+{
+    struct cmsghdr *cmsg;
+
+    for (cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+#ifdef UDP_GRO
+        if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+            /* unlike UDP_SEGMENT on send, the gro size is passed as an int */
+            int size;
+            memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            if (size > 0)
+                msg->segment_size = size;
+        }
+#endif
+        if (cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+#ifdef SCM_TIMESTAMP
+        if (cmsg->cmsg_type == SCM_TIMESTAMP) {
+            struct timeval tv;
+            memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+            msg->time = tv.tv_sec * INT64_C(1000000) + tv.tv_usec;
+        }
+#endif
+#ifdef SO_RXQ_OVFL
+        if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+            uint32_t drops;
+            memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+            s->kernel_drops = drops;
+        }
+#endif
+    }
+}
+#endif
+
+/**
+ * Receive up to batch_size datagrams into s->msgs.
+ * @return the number of datagrams received or a negative error code
+ */
+static int udp_receive(UDPContext *s)
+{
+    socklen_t addr_len = sizeof(s->msgs[0].addr);
+    int n;
+
+#if HAVE_RECVMMSG
+    if (s->mmsgs) {
+        int64_t time;
+        int i;
+
+        for (i = 0; i < s->batch_size; i++) {
+            struct msghdr *hdr = &s->mmsgs[i].msg_hdr;
+            hdr->msg_namelen    = sizeof(s->msgs[i].addr);
+            hdr->msg_controllen = sizeof(s->msgs[i].control);
+            hdr->msg_flags      = 0;
+        }
+        /* block for the first datagram only */
+        n = recvmmsg(s->udp_fd, s->mmsgs, s->batch_size, MSG_WAITFORONE, NULL);
+        if (n < 0)
+            return ff_neterrno();
+        time = s->timestamps ? av_gettime() : AV_NOPTS_VALUE;
+        for (i = 0; i < n; i++) {
+            s->msgs[i].len          = s->mmsgs[i].msg_len;
+            s->msgs[i].segment_size = 0;
+            s->msgs[i].time         = time;
+            udp_parse_control(s, &s->mmsgs[i].msg_hdr, &s->msgs[i]);
+        }
+        return n;
+    }
+#endif
+    n = recvfrom(s->udp_fd, s->msgs[0].data, UDP_MAX_PKT_SIZE, 0,
+                 (struct sockaddr *)&s->msgs[0].addr, &addr_len);
+    if (n < 0)
+        return ff_neterrno();
+    s->msgs[0].len          = n;
+    s->msgs[0].segment_size = 0;
+    s->msgs[0].time         = s->timestamps ? av_gettime() : AV_NOPTS_VALUE;
+    return 1;
+}
+
+/**
+ * Send the first n datagrams of s->msgs.
+ * @return 0 on success or a negative error code
+ */
+static int udp_send(UDPContext *s, int n)
+{
+    int i = 0, ret;
+
+#ifdef UDP_SEGMENT
+    if (s->gso) {
+        int j;
+
+        /* the datagrams are contiguous in the batch buffer, send them by
+         * runs of the same size, the last one possibly shorter */
+        for (i = 0; i < n; i = j) {
+            int size = s->msgs[i].len, len = size;
+
+            for (j = i + 1; j < n && j - i < UDP_MAX_SEGMENTS && size > 0 &&
+                            s->msgs[j - 1].len == size && s->msgs[j].len <= size &&
+                            len + s->msgs[j].len <= UDP_MAX_GSO_SIZE; j++)
+                len += s->msgs[j].len;
+            if ((ret = udp_send_gso(s, s->msgs[i].data, len, size)) < 0)
+                return ret;
+        }
+        return 0;
+    }
+#endif
+
+#if HAVE_SENDMMSG
+    if (s->mmsgs) {
+        for (i = 0; i < n; i++) {
+            struct msghdr *hdr = &s->mmsgs[i].msg_hdr;
+            hdr->msg_name           = s->is_connected ? NULL : &s->dest_addr;
+            hdr->msg_namelen        = s->is_connected ? 0    : s->dest_addr_len;
+            s->msgs[i].iov.iov_base = s->msgs[i].data;
+            s->msgs[i].iov.iov_len  = s->msgs[i].len;
+        }
+        for (i = 0; i < n; i += ret) {
+            ret = sendmmsg(s->udp_fd, s->mmsgs + i, n - i, 0);
+            if (ret < 0) {
+                ret = ff_neterrno();
+                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                    return ret;
+                ret = 0;
+            }
+        }
+        return 0;
+    }
+#endif
+    for (i = 0; i < n; i++) {
+        const uint8_t *p = s->msgs[i].data;
+        int len = s->msgs[i].len;
+
+        while (len) {
+            av_assert0(len > 0);
+            if (!s->is_connected) {
+                ret = sendto (s->udp_fd, p, len, 0,
+                            (struct sockaddr *) &s->dest_addr,
+                            s->dest_addr_len);
+            } else
+                ret = send(s->udp_fd, p, len, 0);
+            if (ret >= 0) {
+                len -= ret;
+                p   += ret;
+            } else {
+                ret = ff_neterrno();
+                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                    return ret;
+            }
+        }
+    }
+    return 0;
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
     UDPContext *s = h->priv_data;
+    int header_size = s->timestamps ? 12 : 4;
     int old_cancelstate;
 
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
@@ -469,44 +818,60 @@ static void *circular_buffer_task_rx( void *_URLContext)
         goto end;
     }
     while(1) {
-        int len;
-        struct sockaddr_storage addr;
-        socklen_t addr_len = sizeof(addr);
+        int i, n;
 
         pthread_mutex_unlock(&s->mutex);
         /* Blocking operations are always cancellation points;
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+        n = udp_receive(s);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
-        if (len < 0) {
-            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = ff_neterrno();
+        if (n < 0) {
+            if (n != AVERROR(EAGAIN) && n != AVERROR(EINTR)) {
+                s->circular_buffer_error = n;
                 goto end;
             }
             continue;
         }
-        if (ff_ip_check_source_lists(&addr, &s->filters))
-            continue;
-        AV_WL32(s->tmp, len);
+        for (i = 0; i < n; i++) {
+            UDPMessage *msg = &s->msgs[i];
+            int pos, segment_size = msg->segment_size ? msg->segment_size : msg->len;
 
-        if(av_fifo_space(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
+            if (ff_ip_check_source_lists(&msg->addr, &s->filters))
                 continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
-            }
+
+            /* split the datagrams coalesced with gro */
+            pos = 0;
+            do {
+                int len = FFMIN(segment_size, msg->len - pos);
+                uint8_t header[12];
+
+                if(av_fifo_space(s->fifo) >= len + header_size) {
+                    AV_WL32(header, len);
+                    if (s->timestamps)
+                        AV_WL64(header + 4, msg->time);
+                    av_fifo_generic_write(s->fifo, header, header_size, NULL);
+                    av_fifo_generic_write(s->fifo, msg->data + pos, len, NULL);
+                    s->thread_stats.packets++;
+                    s->thread_stats.bytes += len;
+                } else if (s->overrun_nonfatal) {
+                    /* No Space left */
+                    av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                            "Surviving due to overrun_nonfatal option\n");
+                    s->thread_stats.overruns++;
+                } else {
+                    av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                            "To avoid, increase fifo_size URL option. "
+                            "To survive in such case, use overrun_nonfatal option\n");
+                    s->circular_buffer_error = AVERROR(EIO);
+                    goto end;
+                }
+                pos += len;
+            } while (pos < msg->len);
         }
-        av_fifo_generic_write(s->fifo, s->tmp, len+4, NULL);
+        s->thread_stats.kernel_drops = s->kernel_drops;
         pthread_cond_signal(&s->cond);
     }
 
@@ -535,8 +900,7 @@ static void *circular_buffer_task_tx( void *_URLContext)
     }
 
     for(;;) {
-        int len;
-        const uint8_t *p;
+        int len, n, size, ret, i;
         uint8_t tmp[4];
         int64_t timestamp;
 
@@ -555,9 +919,12 @@ static void *circular_buffer_task_tx( void *_URLContext)
         len=AV_RL32(tmp);
 
         av_assert0(len >= 0);
-        av_assert0(len <= sizeof(s->tmp));
+        av_assert0(len <= s->batch_buf_size);
 
-        av_fifo_generic_read(s->fifo, s->tmp, len, NULL);
+        av_fifo_generic_read(s->fifo, s->msgs[0].data, len, NULL);
+        s->msgs[0].len = len;
+        size = len;
+        n    = 1;
 
         pthread_mutex_unlock(&s->mutex);
 
@@ -581,31 +948,43 @@ static void *circular_buffer_task_tx( void *_URLContext)
             target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
-        p = s->tmp;
-        while (len) {
-            int ret;
-            av_assert0(len > 0);
-            if (!s->is_connected) {
-                ret = sendto (s->udp_fd, p, len, 0,
-                            (struct sockaddr *) &s->dest_addr,
-                            s->dest_addr_len);
-            } else
-                ret = send(s->udp_fd, p, len, 0);
-            if (ret >= 0) {
-                len -= ret;
-                p   += ret;
-            } else {
-                ret = ff_neterrno();
-                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
-                    pthread_mutex_lock(&s->mutex);
-                    s->circular_buffer_error = ret;
-                    pthread_mutex_unlock(&s->mutex);
-                    return NULL;
+        /* send the following packets along, as long as they are due */
+        pthread_mutex_lock(&s->mutex);
+        while (n < s->batch_size && av_fifo_size(s->fifo) >= 4) {
+            av_fifo_generic_peek(s->fifo, tmp, 4, NULL);
+            len = AV_RL32(tmp);
+            if (size + len > s->batch_buf_size)
+                break;
+            if (s->bitrate) {
+                timestamp = av_gettime_relative();
+                if (timestamp < target_timestamp)
+                    break;
+                if (timestamp - burst_interval > target_timestamp) {
+                    start_timestamp = timestamp - burst_interval;
+                    sent_bits = 0;
                 }
+                sent_bits += len * 8;
+                target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
             }
+            av_fifo_drain(s->fifo, 4);
+            s->msgs[n].data = s->batch_buf + size;
+            s->msgs[n].len  = len;
+            av_fifo_generic_read(s->fifo, s->msgs[n].data, len, NULL);
+            size += len;
+            n++;
         }
+        pthread_mutex_unlock(&s->mutex);
+
+        ret = udp_send(s, n);
 
         pthread_mutex_lock(&s->mutex);
+        if (ret < 0) {
+            s->circular_buffer_error = ret;
+            goto end;
+        }
+        s->thread_stats.packets += n;
+        for (i = 0; i < n; i++)
+            s->thread_stats.bytes += s->msgs[i].len;
     }
 
 end:
@@ -630,6 +1009,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     socklen_t len;
 
     h->is_streamed = 1;
+    s->packet_time = AV_NOPTS_VALUE;
 
     is_output = !(flags & AVIO_FLAG_READ);
     if (s->buffer_size < 0)
@@ -706,6 +1086,30 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "burst_bits", p)) {
             s->burst_bits = strtoll(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "batch_size", p)) {
+            s->batch_size = av_clip(strtol(buf, NULL, 10), 1, 1024);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "gso", p)) {
+            char *endptr = NULL;
+            s->gso = strtol(buf, &endptr, 10);
+            /* assume if no digits were found it is a request to enable it */
+            if (buf == endptr)
+                s->gso = 1;
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "gro", p)) {
+            char *endptr = NULL;
+            s->gro = strtol(buf, &endptr, 10);
+            /* assume if no digits were found it is a request to enable it */
+            if (buf == endptr)
+                s->gro = 1;
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "timestamps", p)) {
+            char *endptr = NULL;
+            s->timestamps = strtol(buf, &endptr, 10);
+            /* assume if no digits were found it is a request to enable it */
+            if (buf == endptr)
+                s->timestamps = 1;
+        }
         if (av_find_info_tag(buf, sizeof(buf), "localaddr", p)) {
             av_strlcpy(localaddr, buf, sizeof(localaddr));
         }
@@ -846,6 +1250,20 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             ff_log_net_error(h, AV_LOG_ERROR, "setsockopt(SO_SNDBUF)");
             goto fail;
         }
+
+        if (s->gso) {
+#ifdef UDP_SEGMENT
+            len = sizeof(tmp);
+            if (getsockopt(udp_fd, IPPROTO_UDP, UDP_SEGMENT, &tmp, &len) < 0) {
+                ff_log_net_error(h, AV_LOG_WARNING, "getsockopt(UDP_SEGMENT)");
+                s->gso = 0;
+            }
+#else
+            av_log(h, AV_LOG_WARNING,
+                   "'gso' option was set but it is not supported on this build\n");
+            s->gso = 0;
+#endif
+        }
     } else {
         /* set udp recv buffer size to the requested value (default 64K) */
         tmp = s->buffer_size;
@@ -861,6 +1279,38 @@ static int udp_open(URLContext *h, const char *uri, int flags)
                 av_log(h, AV_LOG_WARNING, "attempted to set receive buffer to size %d but it only ended up set as %d\n", s->buffer_size, tmp);
         }
 
+#ifdef SO_TIMESTAMP
+        if (s->timestamps && HAVE_RECVMMSG && HAVE_PTHREAD_CANCEL && s->circular_buffer_size) {
+            tmp = 1;
+            if (setsockopt(udp_fd, SOL_SOCKET, SO_TIMESTAMP, &tmp, sizeof(tmp)) < 0)
+                ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(SO_TIMESTAMP)");
+        }
+#endif
+        if (s->gro) {
+#ifdef UDP_GRO
+            tmp = 1;
+            if (!HAVE_RECVMMSG || !HAVE_PTHREAD_CANCEL || !s->circular_buffer_size) {
+                av_log(h, AV_LOG_WARNING,
+                       "'gro' option requires the circular buffer and recvmmsg()\n");
+                s->gro = 0;
+            } else if (setsockopt(udp_fd, IPPROTO_UDP, UDP_GRO, &tmp, sizeof(tmp)) < 0) {
+                ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(UDP_GRO)");
+                s->gro = 0;
+            }
+#else
+            av_log(h, AV_LOG_WARNING,
+                   "'gro' option was set but it is not supported on this build\n");
+            s->gro = 0;
+#endif
+        }
+#ifdef SO_RXQ_OVFL
+        if (HAVE_RECVMMSG && HAVE_PTHREAD_CANCEL && s->circular_buffer_size) {
+            tmp = 1;
+            if (setsockopt(udp_fd, SOL_SOCKET, SO_RXQ_OVFL, &tmp, sizeof(tmp)) < 0)
+                ff_log_net_error(h, AV_LOG_DEBUG, "setsockopt(SO_RXQ_OVFL)");
+        }
+#endif
+
         /* make the socket non-blocking */
         ff_socket_nonblock(udp_fd, 1);
     }
@@ -873,6 +1323,18 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     s->udp_fd = udp_fd;
 
+    /* without the circular buffer thread, udp_write() sends by batches */
+    if (is_output && s->gso && h->max_packet_size > 0 &&
+        !(s->bitrate && s->circular_buffer_size && HAVE_PTHREAD_CANCEL)) {
+        int segments = FFMIN3(s->batch_size, UDP_MAX_SEGMENTS,
+                              UDP_MAX_GSO_SIZE / h->max_packet_size);
+        if (segments > 1) {
+            s->gso_max_len = segments * h->max_packet_size;
+            if (!(s->gso_buf = av_malloc(s->gso_max_len)))
+                goto fail;
+        }
+    }
+
 #if HAVE_PTHREAD_CANCEL
     /*
       Create thread in case of:
@@ -890,6 +1352,8 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
         /* start the task going */
         s->fifo = av_fifo_alloc(s->circular_buffer_size);
+        if (!s->fifo || udp_alloc_messages(h, is_output) < 0)
+            goto fail;
         ret = pthread_mutex_init(&s->mutex, NULL);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", strerror(ret));
@@ -920,6 +1384,10 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep(&s->fifo);
+#if HAVE_PTHREAD_CANCEL
+    udp_free_messages(s);
+#endif
+    av_freep(&s->gso_buf);
     ff_ip_reset_filters(&s->filters);
     return AVERROR(EIO);
 }
@@ -947,11 +1415,17 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
         pthread_mutex_lock(&s->mutex);
         do {
             avail = av_fifo_size(s->fifo);
+            s->stats = s->thread_stats;
             if (avail) { // >=size) {
                 uint8_t tmp[4];
 
                 av_fifo_generic_read(s->fifo, tmp, 4, NULL);
                 avail= AV_RL32(tmp);
+                if (s->timestamps) {
+                    uint8_t time[8];
+                    av_fifo_generic_read(s->fifo, time, 8, NULL);
+                    s->packet_time = AV_RL64(time);
+                }
                 if(avail > size){
                     av_log(h, AV_LOG_WARNING, "Part of datagram lost due to insufficient buffer size\n");
                     avail= size;
@@ -996,6 +1470,10 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
         return ff_neterrno();
     if (ff_ip_check_source_lists(&addr, &s->filters))
         return AVERROR(EINTR);
+    if (s->timestamps)
+        s->packet_time = av_gettime();
+    s->stats.packets++;
+    s->stats.bytes += ret;
     return ret;
 }
 
@@ -1014,6 +1492,7 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
           Return error if last tx failed.
           Here we can't know on which packet error was, but it needs to know that error exists.
         */
+        s->stats = s->thread_stats;
         if (s->circular_buffer_error<0) {
             int err=s->circular_buffer_error;
             pthread_mutex_unlock(&s->mutex);
@@ -1033,6 +1512,21 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
         return size;
     }
 #endif
+    if (s->gso_buf && !(h->flags & AVIO_FLAG_NONBLOCK)) {
+        /* append datagrams of pkt_size bytes, sending them when the buffer
+         * is full or a shorter one ends the run */
+        if (size <= h->max_packet_size) {
+            memcpy(s->gso_buf + s->gso_len, buf, size);
+            s->gso_len += size;
+            if (size == h->max_packet_size && s->gso_len + size <= s->gso_max_len)
+                return size;
+            ret = udp_flush_gso(h);
+            return ret < 0 ? ret : size;
+        }
+        if ((ret = udp_flush_gso(h)) < 0)
+            return ret;
+    }
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 1);
         if (ret < 0)
@@ -1046,13 +1540,20 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
     } else
         ret = send(s->udp_fd, buf, size, 0);
 
-    return ret < 0 ? ff_neterrno() : ret;
+    if (ret < 0)
+        return ff_neterrno();
+    s->stats.packets++;
+    s->stats.bytes += ret;
+    return ret;
 }
 
 static int udp_close(URLContext *h)
 {
     UDPContext *s = h->priv_data;
 
+    if (s->gso_len && udp_flush_gso(h) < 0)
+        av_log(h, AV_LOG_ERROR, "Failed to send the last datagrams\n");
+
 #if HAVE_PTHREAD_CANCEL
     // Request close once writing is finished
     if (s->thread_started && !(h->flags & AVIO_FLAG_READ)) {
@@ -1089,6 +1590,10 @@ static int udp_close(URLContext *h)
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep(&s->fifo);
+#if HAVE_PTHREAD_CANCEL
+    udp_free_messages(s);
+#endif
+    av_freep(&s->gso_buf);
     ff_ip_reset_filters(&s->filters);
     return 0;
 }
@@ -0,0 +1,398 @@
+/*
+ * Background upload queue for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/avassert.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "avio_internal.h"
+#if CONFIG_HTTP_PROTOCOL
+#include "http.h"
+#endif
+#include "internal.h"
+#include "uploadqueue.h"
+
+typedef struct UploadJob {
+    AVIOContext *pb;        ///< memory buffer while the file is being written
+    char *url;
+    AVDictionary *options;
+    uint8_t *data;
+    int size;
+    int ordered;
+    int delete;
+    struct UploadJob *next;
+} UploadJob;
+
+typedef struct UploadWorker {
+    UploadQueue *q;
+#if HAVE_THREADS
+    pthread_t thread;
+#endif
+    AVIOContext *out;       ///< kept open between files for persistent HTTP
+} UploadWorker;
+
+struct UploadQueue {
+    AVFormatContext *s;
+    UploadWorker *workers;
+    int nb_workers;
+    int64_t max_size;
+    int persistent;
+
+#if HAVE_THREADS
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+    UploadJob *open;        ///< files being written by the muxer
+    UploadJob *head;        ///< files waiting for upload, in queue order
+    UploadJob **tail;
+    int64_t size;           ///< bytes of queued and running uploads
+    int running;
+    int abort;
+    int error;
+};
+
+#if HAVE_THREADS
+static void free_job(UploadJob **job)
+{
+    if (!*job)
+        return;
+    ffio_free_dyn_buf(&(*job)->pb);
+    av_freep(&(*job)->url);
+    av_dict_free(&(*job)->options);
+    av_freep(&(*job)->data);
+    av_freep(job);
+}
+
+static UploadJob *alloc_job(const char *url, AVDictionary **options)
+{
+    UploadJob *job = av_mallocz(sizeof(*job));
+
+    if (!job)
+        return NULL;
+    job->url = av_strdup(url);
+    if (!job->url || (options && av_dict_copy(&job->options, *options, 0) < 0))
+        free_job(&job);
+    return job;
+}
+
+static int upload_open(UploadWorker *w, UploadJob *job, int reuse)
+{
+    AVFormatContext *s = w->q->s;
+    AVDictionary *options = NULL;
+    int ret;
+
+#if CONFIG_HTTP_PROTOCOL
+    if (w->out && reuse) {
+        URLContext *http_url_context = ffio_geturlcontext(w->out);
+        av_assert0(http_url_context);
+        if ((ret = ff_http_do_new_request(http_url_context, job->url)) >= 0)
+            return ret;
+    }
+#endif
+    ff_format_io_close(s, &w->out);
+    if ((ret = av_dict_copy(&options, job->options, 0)) >= 0)
+        ret = s->io_open(s, &w->out, job->url, AVIO_FLAG_WRITE, &options);
+    av_dict_free(&options);
+    return ret;
+}
+
+static int upload_close(UploadWorker *w, UploadJob *job, int reuse)
+{
+    int ret;
+
+    avio_flush(w->out);
+    ret = w->out->error;
+#if CONFIG_HTTP_PROTOCOL
+    /* wait for the reply, so that errors are reported and later requests
+     * are not processed by the server before this one */
+    if (ff_is_http_proto(job->url)) {
+        URLContext *http_url_context = ffio_geturlcontext(w->out);
+        av_assert0(http_url_context);
+        ffurl_shutdown(http_url_context, AVIO_FLAG_WRITE);
+        if (ret >= 0)
+            ret = ff_http_get_shutdown_status(http_url_context);
+    }
+#endif
+    if (ret < 0 || !reuse)
+        ff_format_io_close(w->q->s, &w->out);
+    return ret;
+}
+
+static int upload(UploadWorker *w, UploadJob *job)
+{
+    int reuse = w->q->persistent && !job->delete && ff_is_http_proto(job->url);
+    int ret, retry;
+
+    /* a persistent connection may have been closed by the server meanwhile,
+     * so retry once with a new one, as the muxers do */
+    for (retry = 0; retry < 2; retry++) {
+        if ((ret = upload_open(w, job, reuse && !retry)) < 0)
+            continue;
+        avio_write(w->out, job->data, job->size);
+        if ((ret = upload_close(w, job, reuse)) >= 0)
+            break;
+    }
+    return ret;
+}
+
+static void *upload_thread(void *arg)
+{
+    UploadWorker *w = arg;
+    UploadQueue *q = w->q;
+
+    pthread_mutex_lock(&q->mutex);
+    for (;;) {
+        UploadJob *job = q->head;
+        int ret;
+
+        if (q->abort)
+            break;
+        /* jobs start in queue order, ordered ones once nothing else runs */
+        if (!job || (job->ordered && q->running)) {
+            pthread_cond_wait(&q->cond, &q->mutex);
+            continue;
+        }
+        q->head = job->next;
+        if (!q->head)
+            q->tail = &q->head;
+        q->running++;
+        pthread_mutex_unlock(&q->mutex);
+
+        ret = upload(w, job);
+        if (ret < 0)
+            av_log(q->s, AV_LOG_ERROR, "Failed to %s '%s': %s\n",
+                   job->delete ? "delete" : "upload", job->url, av_err2str(ret));
+
+        pthread_mutex_lock(&q->mutex);
+        if (ret < 0 && !q->error)
+            q->error = ret;
+        q->size -= job->size;
+        q->running--;
+        free_job(&job);
+        pthread_cond_broadcast(&q->cond);
+    }
+    pthread_mutex_unlock(&q->mutex);
+
+    ff_format_io_close(q->s, &w->out);
+    return NULL;
+}
+
+int ff_upload_queue_alloc(UploadQueue **pq, AVFormatContext *s, int nb_workers,
+                          int64_t max_size, int persistent)
+{
+    UploadQueue *q;
+    int i, ret;
+
+    if (!(q = av_mallocz(sizeof(*q))))
+        return AVERROR(ENOMEM);
+    q->s          = s;
+    q->max_size   = max_size;
+    q->persistent = persistent;
+    q->tail       = &q->head;
+    if (!(q->workers = av_mallocz_array(nb_workers, sizeof(*q->workers)))) {
+        av_free(q);
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = pthread_mutex_init(&q->mutex, NULL))) {
+        av_free(q->workers);
+        av_free(q);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&q->cond, NULL))) {
+        pthread_mutex_destroy(&q->mutex);
+        av_free(q->workers);
+        av_free(q);
+        return AVERROR(ret);
+    }
+
+    for (i = 0; i < nb_workers; i++) {
+        q->workers[i].q = q;
+        if ((ret = pthread_create(&q->workers[i].thread, NULL, upload_thread, &q->workers[i]))) {
+            ff_upload_queue_free(&q);
+            return AVERROR(ret);
+        }
+        q->nb_workers++;
+    }
+
+    *pq = q;
+    return 0;
+}
+
+int ff_upload_queue_open(UploadQueue *q, AVIOContext **pb, const char *url,
+                         AVDictionary **options)
+{
+    UploadJob *job = alloc_job(url, options);
+    int ret;
+
+    if (!job)
+        return AVERROR(ENOMEM);
+    if ((ret = avio_open_dyn_buf(&job->pb)) < 0) {
+        free_job(&job);
+        return ret;
+    }
+    /* only used by the muxing thread */
+    job->next = q->open;
+    q->open   = job;
+    *pb       = job->pb;
+    return 0;
+}
+
+int ff_upload_queue_owns(UploadQueue *q, AVIOContext *pb)
+{
+    UploadJob *job;
+
+    if (!q)
+        return 0;
+    for (job = q->open; job; job = job->next)
+        if (pb && job->pb == pb)
+            return 1;
+    return 0;
+}
+
+static void queue_job(UploadQueue *q, UploadJob *job)
+{
+    pthread_mutex_lock(&q->mutex);
+    q->size += job->size;
+    *q->tail = job;
+    q->tail  = &job->next;
+    pthread_cond_broadcast(&q->cond);
+
+    /* only block the muxer when too much data is waiting */
+    while (q->size > q->max_size && q->running + !!q->head > 0 &&
+           !ff_check_interrupt(&q->s->interrupt_callback))
+        pthread_cond_wait(&q->cond, &q->mutex);
+    pthread_mutex_unlock(&q->mutex);
+}
+
+int ff_upload_queue_close(UploadQueue *q, AVIOContext **pb, int ordered)
+{
+    UploadJob **p, *job;
+    int size;
+
+    for (p = &q->open; *p && (*p)->pb != *pb; p = &(*p)->next)
+        ;
+    if (!(job = *p))
+        return AVERROR(EINVAL);
+    *p   = job->next;
+    *pb  = NULL;
+
+    size = avio_close_dyn_buf(job->pb, &job->data);
+    job->pb = NULL;
+    if (size < 0 || !job->data) {
+        free_job(&job);
+        return size < 0 ? size : AVERROR(ENOMEM);
+    }
+    job->size    = size;
+    job->ordered = ordered;
+    job->next    = NULL;
+    queue_job(q, job);
+    return 0;
+}
+
+int ff_upload_queue_delete(UploadQueue *q, const char *url, AVDictionary **options)
+{
+    UploadJob *job = alloc_job(url, options);
+
+    if (!job)
+        return AVERROR(ENOMEM);
+    job->ordered = job->delete = 1;
+    queue_job(q, job);
+    return 0;
+}
+
+int ff_upload_queue_flush(UploadQueue *q)
+{
+    int ret;
+
+    pthread_mutex_lock(&q->mutex);
+    while (q->head || q->running)
+        pthread_cond_wait(&q->cond, &q->mutex);
+    ret = q->error;
+    pthread_mutex_unlock(&q->mutex);
+    return ret;
+}
+
+void ff_upload_queue_free(UploadQueue **pq)
+{
+    UploadQueue *q = *pq;
+    UploadJob *job;
+    int i;
+
+    if (!q)
+        return;
+
+    pthread_mutex_lock(&q->mutex);
+    q->abort = 1;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->mutex);
+    for (i = 0; i < q->nb_workers; i++)
+        pthread_join(q->workers[i].thread, NULL);
+
+    while ((job = q->head)) {
+        q->head = job->next;
+        free_job(&job);
+    }
+    while ((job = q->open)) {
+        q->open = job->next;
+        free_job(&job);
+    }
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->mutex);
+    av_freep(&q->workers);
+    av_freep(pq);
+}
+#else
+int ff_upload_queue_alloc(UploadQueue **q, AVFormatContext *s, int nb_workers,
+                          int64_t max_size, int persistent)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_upload_queue_open(UploadQueue *q, AVIOContext **pb, const char *url,
+                         AVDictionary **options)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_upload_queue_owns(UploadQueue *q, AVIOContext *pb)
+{
+    return 0;
+}
+
+int ff_upload_queue_close(UploadQueue *q, AVIOContext **pb, int ordered)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_upload_queue_delete(UploadQueue *q, const char *url, AVDictionary **options)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_upload_queue_flush(UploadQueue *q)
+{
+    return 0;
+}
+
+void ff_upload_queue_free(UploadQueue **q)
+{
+}
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Background upload queue for segmenting muxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_UPLOADQUEUE_H
+#define AVFORMAT_UPLOADQUEUE_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "avformat.h"
+#include "avio.h"
+
+/**
+ * Files written by a muxer into memory and uploaded by worker threads,
+ * each using its own connection, through the io_open() callback of the
+ * muxer.
+ */
+typedef struct UploadQueue UploadQueue;
+
+/**
+ * Create an upload queue.
+ *
+ * @param s          the muxer, used for io_open(), io_close() and logging
+ * @param nb_workers number of files uploaded concurrently
+ * @param max_size   number of queued bytes above which
+ *                   ff_upload_queue_close() waits for uploads to complete
+ * @param persistent reuse the HTTP connection of a worker for its next file
+ * @return 0 on success, AVERROR(ENOSYS) if threads are not available, a
+ *         negative error code otherwise
+ */
+int ff_upload_queue_alloc(UploadQueue **q, AVFormatContext *s, int nb_workers,
+                          int64_t max_size, int persistent);
+
+/**
+ * Open a memory buffer for the content of url. It is uploaded once it is
+ * closed with ff_upload_queue_close().
+ *
+ * @param options options passed to io_open() when uploading, not consumed
+ */
+int ff_upload_queue_open(UploadQueue *q, AVIOContext **pb, const char *url,
+                         AVDictionary **options);
+
+/**
+ * @return 1 if pb was opened with ff_upload_queue_open() on q, 0 otherwise
+ *         or if q is NULL
+ */
+int ff_upload_queue_owns(UploadQueue *q, AVIOContext *pb);
+
+/**
+ * Queue the content written to pb for upload and set *pb to NULL.
+ *
+ * @param ordered start the upload only once all files queued before have
+ *                been uploaded, e.g. for a playlist referencing them
+ */
+int ff_upload_queue_close(UploadQueue *q, AVIOContext **pb, int ordered);
+
+/**
+ * Queue an HTTP DELETE request for url, ordered after all files queued
+ * before.
+ */
+int ff_upload_queue_delete(UploadQueue *q, const char *url, AVDictionary **options);
+
+/**
+ * Wait for all queued uploads to complete.
+ *
+ * @return the first error of an upload since the queue was created
+ */
+int ff_upload_queue_flush(UploadQueue *q);
+
+/**
+ * Drop the uploads which have not been started, wait for the others to
+ * complete and free the queue.
+ */
+void ff_upload_queue_free(UploadQueue **q);
+
+#endif /* AVFORMAT_UPLOADQUEUE_H */
@@ -27,6 +27,7 @@
 #include "avio.h"
 #include "libavformat/version.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -86,6 +87,7 @@ typedef struct URLProtocol {
     int (*url_get_multi_file_handle)(URLContext *h, int **handles,
                                      int *numhandles);
     int (*url_get_short_seek)(URLContext *h);
+    int (*url_get_mapping)(URLContext *h, AVBufferRef **buf);
     int (*url_shutdown)(URLContext *h, int flags);
     int priv_data_size;
     const AVClass *priv_data_class;
@@ -257,6 +259,19 @@ int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles);
  */
 int ffurl_get_short_seek(URLContext *h);
 
+/**
+ * Return a mapping of the whole resource, if the protocol was asked to map
+ * it. The data is followed by AV_INPUT_BUFFER_PADDING_SIZE zero bytes that
+ * are not included in the size of buf. The mapping must be writable without
+ * affecting the resource, since packets pointing into it may be modified in
+ * place; protocols which cannot provide that must not return a mapping.
+ *
+ * @param buf set to a new reference to the mapping on success
+ * @return 0 on success, AVERROR(ENOSYS) if there is no mapping or another
+ * negative value on error
+ */
+int ffurl_get_mapping(URLContext *h, AVBufferRef **buf);
+
 /**
  * Signal the URLContext that we are done reading or writing the stream.
  *
@@ -32,6 +32,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/time_internal.h"
@@ -312,6 +313,12 @@ int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
     pkt->size = 0;
     pkt->pos  = avio_tell(s);
 
+    if (size <= SANE_CHUNK_SIZE/10) {
+        int ret = ffio_read_ref(s, pkt, size);
+        if (ret)
+            return ret;
+    }
+
     return append_packet_chunked(s, pkt, size);
 }
 
@@ -596,6 +603,12 @@ FF_ENABLE_DEPRECATION_WARNINGS
         goto fail;
     }
 
+    if (s->pb && ((s->flags & AVFMT_FLAG_ZERO_COPY) || s->pb->mapped) &&
+        (s->iformat->flags_internal & FF_FMT_FLAG_ZERO_COPY) &&
+        !(s->flags & AVFMT_FLAG_CUSTOM_IO) &&
+        (ret = ffio_enable_buffer_refs(s->pb)) < 0)
+        goto fail;
+
     avio_skip(s->pb, s->skip_initial_bytes);
 
     /* Check filename in case an image number is expected. */
@@ -873,6 +886,9 @@ int ff_read_packet(AVFormatContext *s, AVPacket *pkt)
             continue;
         }
 
+        if (!s->pb || !ffio_is_buffer_ref(s->pb, pkt->buf))
+            s->copied_bytes += pkt->size;
+
         err = av_packet_make_refcounted(pkt);
         if (err < 0) {
             av_packet_unref(pkt);
@@ -2058,7 +2074,7 @@ int av_add_index_entry(AVStream *st, int64_t pos, int64_t timestamp,
 int ff_index_search_timestamp(const AVIndexEntry *entries, int nb_entries,
                               int64_t wanted_timestamp, int flags)
 {
-    int a, b, m;
+    int a, b, m, last = INT_MAX;
     int64_t timestamp;
 
     a = -1;
@@ -2069,7 +2085,19 @@ int ff_index_search_timestamp(const AVIndexEntry *entries, int nb_entries,
         a = b - 1;
 
     while (b - a > 1) {
-        m         = (a + b) >> 1;
+        /* Timestamps usually grow almost linearly with the index, so guess
+         * the position by interpolation, which touches far fewer cache lines
+         * than bisecting a large index. Bisect whenever a guess did not halve
+         * the range, to keep the worst case logarithmic. */
+        int interp = a >= 0 && b < nb_entries && 2 * (b - a) <= last;
+        last = b - a;
+        if (interp) {
+            double span = (double)entries[b].timestamp - entries[a].timestamp;
+            double off  = (double)wanted_timestamp - entries[a].timestamp;
+            m = a + (int)(off / span * (b - a));
+            m = av_clip(m, a + 1, b - 1);
+        } else
+            m = (a + b) >> 1;
 
         // Search for the next non-discarded packet.
         while ((entries[m].flags & AVINDEX_DISCARD_FRAME) && m < b && m < nb_entries - 1) {
@@ -2526,6 +2554,8 @@ int av_seek_frame(AVFormatContext *s, int stream_index,
 {
     int ret;
 
+    ff_index_cache_load(s);
+
     if (s->iformat->read_seek2 && !s->iformat->read_seek) {
         int64_t min_ts = INT64_MIN, max_ts = INT64_MAX;
         if ((flags & AVSEEK_FLAG_BACKWARD))
@@ -2552,6 +2582,8 @@ int avformat_seek_file(AVFormatContext *s, int stream_index, int64_t min_ts,
     if (stream_index < -1 || stream_index >= (int)s->nb_streams)
         return AVERROR(EINVAL);
 
+    ff_index_cache_load(s);
+
     if (s->seek2any>0)
         flags |= AVSEEK_FLAG_ANY;
     flags &= ~AVSEEK_FLAG_BACKWARD;
@@ -3599,6 +3631,156 @@ static int extract_extradata(AVStream *st, const AVPacket *pkt)
     return 0;
 }
 
+/**
+ * Probe decoding on a thread pool: the packets read while analyzing the
+ * streams are collected and then decoded by one job per stream, while the
+ * demuxer waits, so no codec context is ever used by two threads.
+ */
+typedef struct ProbeDecode {
+    AVPacket pkt;
+    int nb_frames;  ///< codec_info_nb_frames when the packet was read
+} ProbeDecode;
+
+typedef struct ProbeThreadContext {
+    AVSliceThread *thread;
+    int nb_threads;
+    AVFormatContext *ic;
+    AVDictionary **options;
+    int orig_nb_streams;
+    ProbeDecode *pending;
+    unsigned int pending_size;
+    int nb_pending;
+    int *jobs;      ///< stream decoded by each job
+    int drain;      ///< flush the decoders instead of decoding packets
+} ProbeThreadContext;
+
+static void probe_decode_worker(void *priv, int jobnr, int threadnr,
+                                int nb_jobs, int nb_threads)
+{
+    ProbeThreadContext *pt = priv;
+    AVStream *st = pt->ic->streams[pt->jobs[jobnr]];
+    AVDictionary **opts = pt->options && st->index < pt->orig_nb_streams ?
+                          &pt->options[st->index] : NULL;
+    int nb_frames = st->codec_info_nb_frames;
+    int i, err;
+
+    if (pt->drain) {
+        AVPacket empty_pkt = { 0 };
+        av_init_packet(&empty_pkt);
+
+        do {
+            err = try_decode_frame(pt->ic, st, &empty_pkt, opts);
+        } while (err > 0 && !has_codec_parameters(st, NULL));
+
+        if (err < 0)
+            av_log(pt->ic, AV_LOG_INFO,
+                   "decoding for stream %d failed\n", st->index);
+        return;
+    }
+
+    for (i = 0; i < pt->nb_pending; i++) {
+        ProbeDecode *pd = &pt->pending[i];
+
+        if (pd->pkt.stream_index != st->index)
+            continue;
+        /* decode as if the packet had just been read */
+        st->codec_info_nb_frames = pd->nb_frames;
+        try_decode_frame(pt->ic, st, &pd->pkt, opts);
+    }
+    st->codec_info_nb_frames = nb_frames;
+}
+
+static int probe_threads_init(ProbeThreadContext *pt, AVFormatContext *ic,
+                              AVDictionary **options, int orig_nb_streams)
+{
+    int ret;
+
+    if (ic->probe_threads <= 1)
+        return 0;
+
+    ret = avpriv_slicethread_create(&pt->thread, pt, probe_decode_worker,
+                                    NULL, ic->probe_threads);
+    if (ret <= 1) {
+        avpriv_slicethread_free(&pt->thread);
+        return ret == AVERROR(ENOMEM) ? ret : 0;
+    }
+    pt->nb_threads      = ret;
+    pt->ic              = ic;
+    pt->options         = options;
+    pt->orig_nb_streams = orig_nb_streams;
+    return 0;
+}
+
+static int probe_threads_run(ProbeThreadContext *pt, int drain)
+{
+    AVFormatContext *ic = pt->ic;
+    int i, j, nb_jobs = 0;
+
+    if (av_reallocp_array(&pt->jobs, ic->nb_streams, sizeof(*pt->jobs)) < 0)
+        return AVERROR(ENOMEM);
+
+    if (drain) {
+        for (i = 0; i < ic->nb_streams; i++)
+            if (ic->streams[i]->info->found_decoder == 1)
+                pt->jobs[nb_jobs++] = i;
+    } else {
+        for (i = 0; i < pt->nb_pending; i++) {
+            int stream_index = pt->pending[i].pkt.stream_index;
+
+            for (j = 0; j < nb_jobs && pt->jobs[j] != stream_index; j++);
+            if (j == nb_jobs)
+                pt->jobs[nb_jobs++] = stream_index;
+        }
+    }
+
+    pt->drain = drain;
+    if (nb_jobs)
+        avpriv_slicethread_execute(pt->thread, nb_jobs, 0);
+
+    for (i = 0; i < pt->nb_pending; i++)
+        av_packet_unref(&pt->pending[i].pkt);
+    pt->nb_pending = 0;
+    return 0;
+}
+
+/**
+ * Queue a packet for probe decoding; the queue is decoded once it holds
+ * enough packets to keep the threads busy.
+ */
+static int probe_threads_decode(ProbeThreadContext *pt, AVStream *st,
+                                const AVPacket *pkt)
+{
+    ProbeDecode *pending;
+    int ret;
+
+    pending = av_fast_realloc(pt->pending, &pt->pending_size,
+                              (pt->nb_pending + 1) * sizeof(*pending));
+    if (!pending)
+        return AVERROR(ENOMEM);
+    pt->pending = pending;
+
+    pending += pt->nb_pending;
+    if ((ret = av_packet_ref(&pending->pkt, pkt)) < 0)
+        return ret;
+    pending->nb_frames = st->codec_info_nb_frames;
+    pt->nb_pending++;
+
+    if (pt->nb_pending >= 8 * pt->nb_threads)
+        return probe_threads_run(pt, 0);
+    return 0;
+}
+
+static void probe_threads_free(ProbeThreadContext *pt)
+{
+    int i;
+
+    for (i = 0; i < pt->nb_pending; i++)
+        av_packet_unref(&pt->pending[i].pkt);
+    av_freep(&pt->pending);
+    av_freep(&pt->jobs);
+    avpriv_slicethread_free(&pt->thread);
+}
+
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 {
     int i, count = 0, ret = 0, j;
@@ -3616,6 +3798,7 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t probesize = ic->probesize;
     int eof_reached = 0;
     int *missing_streams = av_opt_ptr(ic->iformat->priv_class, ic->priv_data, "missing_streams");
+    ProbeThreadContext pt = { 0 };
 
     flush_codecs = probesize > 0;
 
@@ -3722,6 +3905,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
         ic->streams[i]->info->fps_last_dts  = AV_NOPTS_VALUE;
     }
 
+    ret = probe_threads_init(&pt, ic, options, orig_nb_streams);
+    if (ret < 0)
+        goto find_stream_info_err;
+
     read_size = 0;
     for (;;) {
         const AVPacket *pkt;
@@ -3745,7 +3932,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
              * the correct fps. */
             if (av_q2d(st->time_base) > 0.0005)
                 fps_analyze_framecount *= 2;
-            if (!tb_unreliable(st->internal->avctx))
+            if (!tb_unreliable(st->internal->avctx) ||
+                (ic->flags & AVFMT_FLAG_FAST_PROBE))
                 fps_analyze_framecount = 0;
             if (ic->fps_probe_size >= 0)
                 fps_analyze_framecount = ic->fps_probe_size;
@@ -3781,8 +3969,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
             if (i == ic->nb_streams) {
                 analyzed_all_streams = 1;
                 /* NOTE: If the format has no header, then we need to read some
-                 * packets to get most of the streams, so we cannot stop here. */
-                if (!(ic->ctx_flags & AVFMTCTX_NOHEADER)) {
+                 * packets to get most of the streams, so we cannot stop here,
+                 * unless asked to stop as soon as the known streams are done. */
+                if (!(ic->ctx_flags & AVFMTCTX_NOHEADER) ||
+                    ((ic->flags & AVFMT_FLAG_FAST_PROBE) && ic->nb_streams)) {
                     /* If we found the info for all the codecs, we can stop. */
                     ret = count;
                     av_log(ic, AV_LOG_DEBUG, "All info found\n");
@@ -3938,8 +4128,13 @@ FF_ENABLE_DEPRECATION_WARNINGS
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        if (pt.thread) {
+            ret = probe_threads_decode(&pt, st, pkt);
+            if (ret < 0)
+                goto unref_then_goto_end;
+        } else
+            try_decode_frame(ic, st, pkt,
+                             (options && i < orig_nb_streams) ? &options[i] : NULL);
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(&pkt1);
@@ -3948,6 +4143,14 @@ FF_ENABLE_DEPRECATION_WARNINGS
         count++;
     }
 
+    if (pt.thread) {
+        int err = probe_threads_run(&pt, 0);
+        if (err < 0) {
+            ret = err;
+            goto find_stream_info_err;
+        }
+    }
+
     if (eof_reached) {
         int stream_index;
         for (stream_index = 0; stream_index < ic->nb_streams; stream_index++) {
@@ -3974,7 +4177,13 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
     }
 
-    if (flush_codecs) {
+    if (flush_codecs && pt.thread) {
+        int err = probe_threads_run(&pt, 1);
+        if (err < 0) {
+            ret = err;
+            goto find_stream_info_err;
+        }
+    } else if (flush_codecs) {
         AVPacket empty_pkt = { 0 };
         int err = 0;
         av_init_packet(&empty_pkt);
@@ -4189,6 +4398,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     }
 
 find_stream_info_err:
+    probe_threads_free(&pt);
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
         if (st->info)
@@ -4492,9 +4702,11 @@ void avformat_close_input(AVFormatContext **ps)
 
     flush_packet_queue(s);
 
-    if (s->iformat)
+    if (s->iformat) {
+        ff_index_cache_save(s);
         if (s->iformat->read_close)
             s->iformat->read_close(s);
+    }
 
     avformat_free_context(s);
 
@@ -216,6 +216,48 @@ int av_buffer_realloc(AVBufferRef **pbuf, int size)
     return 0;
 }
 
+/* number of per-thread caches of each pool */
+#define POOL_CACHES     16
+/* maximum number of entries in a cache, half of them are moved at once
+ * from or to the shared list */
+#define POOL_CACHE_SIZE 8
+
+#if HAVE_THREADS && HAVE_THREAD_LOCAL
+static atomic_uint next_thread_index = ATOMIC_VAR_INIT(0);
+static _Thread_local unsigned thread_index;
+
+static BufferPoolCache *pool_cache(AVBufferPool *pool)
+{
+    if (!pool->caches)
+        return NULL;
+    if (!thread_index)
+        thread_index = atomic_fetch_add_explicit(&next_thread_index, 1,
+                                                 memory_order_relaxed) + 1;
+    return &pool->caches[(thread_index - 1) % POOL_CACHES];
+}
+
+static void pool_init_caches(AVBufferPool *pool)
+{
+    int i;
+
+    /* the pool works without caches, so ignore allocation failures */
+    pool->caches = av_mallocz_array(POOL_CACHES, sizeof(*pool->caches));
+    if (!pool->caches)
+        return;
+    for (i = 0; i < POOL_CACHES; i++)
+        ff_mutex_init(&pool->caches[i].mutex, NULL);
+}
+#else
+static BufferPoolCache *pool_cache(AVBufferPool *pool)
+{
+    return NULL;
+}
+
+static void pool_init_caches(AVBufferPool *pool)
+{
+}
+#endif
+
 AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
                                    AVBufferRef* (*alloc)(void *opaque, int size),
                                    void (*pool_free)(void *opaque))
@@ -225,6 +267,7 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
         return NULL;
 
     ff_mutex_init(&pool->mutex, NULL);
+    pool_init_caches(pool);
 
     pool->size      = size;
     pool->opaque    = opaque;
@@ -248,6 +291,7 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
 
     atomic_init(&pool->refcount, 1);
+    pool_init_caches(pool);
 
     return pool;
 }
@@ -258,6 +302,21 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
+    int i;
+
+    for (i = 0; pool->caches && i < POOL_CACHES; i++) {
+        BufferPoolCache *cache = &pool->caches[i];
+        while (cache->entries) {
+            BufferPoolEntry *buf = cache->entries;
+            cache->entries = buf->next;
+
+            buf->free(buf->opaque, buf->data);
+            av_freep(&buf);
+        }
+        ff_mutex_destroy(&cache->mutex);
+    }
+    av_freep(&pool->caches);
+
     while (pool->pool) {
         BufferPoolEntry *buf = pool->pool;
         pool->pool = buf->next;
@@ -291,13 +350,37 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     BufferPoolEntry *buf = opaque;
     AVBufferPool *pool = buf->pool;
 
+    BufferPoolCache *cache = pool_cache(pool);
+
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    if (cache) {
+        ff_mutex_lock(&cache->mutex);
+        buf->next = cache->entries;
+        cache->entries = buf;
+        if (++cache->nb_entries > POOL_CACHE_SIZE) {
+            int i;
+
+            ff_mutex_lock(&pool->mutex);
+            for (i = 0; i < POOL_CACHE_SIZE / 2; i++) {
+                buf = cache->entries;
+                cache->entries = buf->next;
+                buf->next = pool->pool;
+                pool->pool = buf;
+            }
+            ff_mutex_unlock(&pool->mutex);
+            cache->nb_entries -= POOL_CACHE_SIZE / 2;
+        }
+        ff_mutex_unlock(&cache->mutex);
+    } else {
+        ff_mutex_lock(&pool->mutex);
+        buf->next = pool->pool;
+        pool->pool = buf;
+        ff_mutex_unlock(&pool->mutex);
+    }
+
+    atomic_fetch_sub_explicit(&pool->outstanding, 1, memory_order_relaxed);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -332,7 +415,8 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
     return ret;
 }
 
-AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
+/* take a buffer from the shared list, or allocate a new one */
+static AVBufferRef *pool_get_shared(AVBufferPool *pool)
 {
     AVBufferRef *ret;
     BufferPoolEntry *buf;
@@ -345,18 +429,127 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
         if (ret) {
             pool->pool = buf->next;
             buf->next = NULL;
+            pool->hits++;
         }
     } else {
         ret = pool_alloc_buffer(pool);
+        if (ret)
+            pool->misses++;
     }
     ff_mutex_unlock(&pool->mutex);
 
-    if (ret)
+    return ret;
+}
+
+/* take the first entry of a cache, called with its mutex locked */
+static AVBufferRef *pool_take_cached(AVBufferPool *pool, BufferPoolCache *cache)
+{
+    BufferPoolEntry *buf = cache->entries;
+    AVBufferRef *ret;
+
+    ret = av_buffer_create(buf->data, pool->size, pool_release_buffer, buf, 0);
+    if (ret) {
+        cache->entries = buf->next;
+        cache->nb_entries--;
+        cache->hits++;
+        buf->next = NULL;
+    }
+    return ret;
+}
+
+static AVBufferRef *pool_get_cached(AVBufferPool *pool, BufferPoolCache *cache)
+{
+    AVBufferRef *ret;
+    BufferPoolEntry *buf;
+    int i;
+
+    ff_mutex_lock(&cache->mutex);
+    if (!cache->entries) {
+        ff_mutex_lock(&pool->mutex);
+        for (i = 0; i < POOL_CACHE_SIZE / 2 && pool->pool; i++) {
+            buf = pool->pool;
+            pool->pool = buf->next;
+            buf->next = cache->entries;
+            cache->entries = buf;
+        }
+        cache->nb_entries = i;
+        ff_mutex_unlock(&pool->mutex);
+    }
+    if (cache->entries) {
+        ret = pool_take_cached(pool, cache);
+        ff_mutex_unlock(&cache->mutex);
+        return ret;
+    }
+    ff_mutex_unlock(&cache->mutex);
+
+    /* Free buffers may still sit in the caches of other threads. Use them
+     * before allocating, as pools with a fixed number of buffers (e.g. of
+     * hardware surfaces) fail to allocate more. Only one cache mutex is
+     * held at a time, so this cannot deadlock with another thread doing
+     * the same. */
+    for (i = 0; i < POOL_CACHES; i++) {
+        BufferPoolCache *other = &pool->caches[i];
+
+        if (other == cache)
+            continue;
+        ff_mutex_lock(&other->mutex);
+        ret = other->entries ? pool_take_cached(pool, other) : NULL;
+        ff_mutex_unlock(&other->mutex);
+        if (ret)
+            return ret;
+    }
+
+    return pool_get_shared(pool);
+}
+
+AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
+{
+    AVBufferRef *ret;
+    BufferPoolCache *cache = pool_cache(pool);
+
+    if (cache) {
+        ret = pool_get_cached(pool, cache);
+    } else {
+        ret = pool_get_shared(pool);
+    }
+
+    if (ret) {
+        int outstanding = atomic_fetch_add_explicit(&pool->outstanding, 1,
+                                                    memory_order_relaxed) + 1;
+        int peak = atomic_load_explicit(&pool->peak_outstanding,
+                                        memory_order_relaxed);
+        while (outstanding > peak &&
+               !atomic_compare_exchange_weak_explicit(&pool->peak_outstanding,
+                                                      &peak, outstanding,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            ;
+
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
+    }
 
     return ret;
 }
 
+void av_buffer_pool_get_stats(AVBufferPool *pool, AVBufferPoolStats *stats)
+{
+    int i;
+
+    ff_mutex_lock(&pool->mutex);
+    stats->hits   = pool->hits;
+    stats->misses = pool->misses;
+    ff_mutex_unlock(&pool->mutex);
+
+    for (i = 0; pool->caches && i < POOL_CACHES; i++) {
+        ff_mutex_lock(&pool->caches[i].mutex);
+        stats->hits += pool->caches[i].hits;
+        ff_mutex_unlock(&pool->caches[i].mutex);
+    }
+
+    stats->outstanding      = atomic_load(&pool->outstanding);
+    stats->peak_outstanding = atomic_load(&pool->peak_outstanding);
+}
+
 void *av_buffer_pool_buffer_get_opaque(AVBufferRef *ref)
 {
     BufferPoolEntry *buf = ref->buffer->opaque;
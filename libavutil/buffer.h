@@ -228,6 +228,11 @@ int av_buffer_realloc(AVBufferRef **buf, int size);
  * Allocating and releasing buffers with this API is thread-safe as long as
  * either the default alloc callback is used, or the user-supplied one is
  * thread-safe.
+ *
+ * Where supported, released buffers are first kept in a small per-thread
+ * cache of the pool, which is exchanged with the shared list of free buffers
+ * in batches, so that threads allocating from the same pool concurrently
+ * rarely contend on it.
  */
 
 /**
@@ -297,6 +302,43 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool);
  */
 void *av_buffer_pool_buffer_get_opaque(AVBufferRef *ref);
 
+/**
+ * Usage statistics of a buffer pool, as returned by
+ * av_buffer_pool_get_stats().
+ */
+typedef struct AVBufferPoolStats {
+    /**
+     * Number of buffers returned by av_buffer_pool_get() which were reused
+     * from the pool.
+     */
+    uint64_t hits;
+    /**
+     * Number of buffers returned by av_buffer_pool_get() which had to be
+     * newly allocated.
+     */
+    uint64_t misses;
+    /**
+     * Number of buffers currently in use, i.e. not yet returned to the pool.
+     */
+    int outstanding;
+    /**
+     * Largest number of buffers in use at the same time since the pool was
+     * created.
+     */
+    int peak_outstanding;
+} AVBufferPoolStats;
+
+/**
+ * Retrieve usage statistics of a buffer pool.
+ *
+ * This function may be called concurrently with the other functions using
+ * the pool, the values are then only a snapshot.
+ *
+ * @param pool  the buffer pool
+ * @param stats the statistics are written here
+ */
+void av_buffer_pool_get_stats(AVBufferPool *pool, AVBufferPoolStats *stats);
+
 /**
  * @}
  */
@@ -73,10 +73,25 @@ typedef struct BufferPoolEntry {
     struct BufferPoolEntry *next;
 } BufferPoolEntry;
 
+/**
+ * Per-thread cache of free pool entries. Each thread uses one of the
+ * caches of a pool, so its mutex is normally uncontended. Entries are moved
+ * from and to the shared list in batches.
+ */
+typedef struct BufferPoolCache {
+    AVMutex mutex;
+    BufferPoolEntry *entries;
+    int nb_entries;
+    uint64_t hits;
+} BufferPoolCache;
+
 struct AVBufferPool {
     AVMutex mutex;
     BufferPoolEntry *pool;
 
+    /* NULL if per-thread caches are not supported */
+    BufferPoolCache *caches;
+
     /*
      * This is used to track when the pool is to be freed.
      * The pointer to the pool itself held by the caller is considered to
@@ -88,6 +103,12 @@ struct AVBufferPool {
      */
     atomic_uint refcount;
 
+    /* statistics, hits and misses are protected by the mutex */
+    uint64_t hits;
+    uint64_t misses;
+    atomic_int outstanding;
+    atomic_int peak_outstanding;
+
     int size;
     void *opaque;
     AVBufferRef* (*alloc)(int size);
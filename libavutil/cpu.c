@@ -48,6 +48,7 @@
 #endif
 
 static atomic_int cpu_flags = ATOMIC_VAR_INIT(-1);
+static atomic_int thread_budget = ATOMIC_VAR_INIT(0);
 
 static int get_cpu_flags(void)
 {
@@ -306,6 +307,17 @@ int av_cpu_count(void)
     return nb_cpus;
 }
 
+void av_set_thread_budget(int nb_threads)
+{
+    atomic_store_explicit(&thread_budget, FFMAX(nb_threads, 0), memory_order_relaxed);
+}
+
+int av_get_thread_budget(void)
+{
+    int nb_threads = atomic_load_explicit(&thread_budget, memory_order_relaxed);
+    return nb_threads ? nb_threads : av_cpu_count();
+}
+
 size_t av_cpu_max_align(void)
 {
     if (ARCH_AARCH64)
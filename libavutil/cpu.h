@@ -116,6 +116,25 @@ int av_parse_cpu_caps(unsigned *flags, const char *s);
  */
 int av_cpu_count(void);
 
+/**
+ * Set the maximum number of worker threads shared by the slice threading
+ * contexts of all libraries in the process.
+ *
+ * The threads calling into the libraries take part in the work in addition
+ * to the worker threads. A new budget is applied when the next slice
+ * threading context is created.
+ *
+ * @param nb_threads maximum number of worker threads, 0 to use the number of
+ *                   logical CPU cores
+ */
+void av_set_thread_budget(int nb_threads);
+
+/**
+ * @return the maximum number of shared worker threads, as set with
+ *         av_set_thread_budget() or the number of logical CPU cores
+ */
+int av_get_thread_budget(void);
+
 /**
  * Get the maximum data alignment that may be required by FFmpeg.
  *
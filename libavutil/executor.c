@@ -0,0 +1,62 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "buffer.h"
+#include "error.h"
+#include "executor.h"
+#include "mem.h"
+#include "slicethread.h"
+
+static void executor_free(void *opaque, uint8_t *data)
+{
+    AVExecutorContext *exec = (AVExecutorContext*)data;
+
+    ff_executor_uninit(exec);
+    av_freep(&exec->affinity);
+    av_freep(&exec);
+}
+
+AVBufferRef *av_executor_alloc(void)
+{
+    AVExecutorContext *exec;
+    AVBufferRef *ref;
+
+    exec = av_mallocz(sizeof(*exec));
+    if (!exec)
+        return NULL;
+
+    ref = av_buffer_create((uint8_t*)exec, sizeof(*exec), executor_free, NULL,
+                           AV_BUFFER_FLAG_READONLY);
+    if (!ref) {
+        av_freep(&exec);
+        return NULL;
+    }
+    return ref;
+}
+
+int av_executor_init(AVBufferRef *ref)
+{
+    AVExecutorContext *exec = (AVExecutorContext*)ref->data;
+
+    if (exec->internal)
+        return AVERROR(EINVAL);
+    if (exec->nb_threads < 0 || exec->priority < -20 || exec->priority > 19)
+        return AVERROR(EINVAL);
+
+    return ff_executor_init(exec);
+}
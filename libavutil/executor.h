@@ -0,0 +1,102 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_EXECUTOR_H
+#define AVUTIL_EXECUTOR_H
+
+#include "buffer.h"
+
+/**
+ * @defgroup lavu_executor Executor
+ * @ingroup lavu_misc
+ *
+ * @{
+ * An executor is a pool of worker threads shared by codec contexts and
+ * filter graphs.
+ *
+ * By default, the slice threading of all codec contexts and filter graphs in
+ * the process runs on one pool, whose size is set by av_set_thread_budget().
+ * An executor is a separate pool with its own size, scheduling priority and
+ * CPU affinity, which can e.g. be used to give the renditions of a transcode
+ * different priorities.
+ *
+ * An executor is allocated with av_executor_alloc(), configured by setting
+ * the fields of AVExecutorContext and started with av_executor_init(). It is
+ * attached to a codec context or a filter graph by setting
+ * AVCodecContext.executor or AVFilterGraph.executor to a new reference to it
+ * before the context is opened or configured. The threads are stopped once
+ * the last reference is released.
+ */
+
+typedef struct AVExecutorInternal AVExecutorInternal;
+
+typedef struct AVExecutorContext {
+    /**
+     * Number of worker threads, 0 to use av_get_thread_budget().
+     */
+    int nb_threads;
+
+    /**
+     * Scheduling priority of the worker threads as a nice value, from -20
+     * (highest) to 19 (lowest). 0 keeps the priority of the thread calling
+     * av_executor_init(). Raising the priority usually requires privileges.
+     *
+     * Only supported on Linux, ignored elsewhere.
+     */
+    int priority;
+
+    /**
+     * CPUs the worker threads may run on, as a comma separated list of CPU
+     * numbers and ranges, e.g. "0-3,8". NULL to not restrict them.
+     * Must be allocated with av_malloc() or av_strdup() and is freed along
+     * with the executor.
+     *
+     * Only supported on Linux, ignored elsewhere.
+     */
+    char *affinity;
+
+    /**
+     * Private data used internally by libavutil. Must not be accessed in any
+     * way by the caller.
+     */
+    AVExecutorInternal *internal;
+} AVExecutorContext;
+
+/**
+ * Allocate an AVExecutorContext.
+ *
+ * @return a reference to the newly created AVExecutorContext on success or
+ *         NULL on failure.
+ */
+AVBufferRef *av_executor_alloc(void);
+
+/**
+ * Start the worker threads of an executor. This function must be called once
+ * the fields of the AVExecutorContext have been set.
+ *
+ * @param ref a reference to the AVExecutorContext
+ * @return 0 on success, a negative AVERROR code on failure, in particular
+ *         AVERROR(ENOSYS) if libavutil was built without thread support
+ */
+int av_executor_init(AVBufferRef *ref);
+
+/**
+ * @}
+ */
+
+#endif /* AVUTIL_EXECUTOR_H */
@@ -16,79 +16,580 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdatomic.h>
+#include <stdlib.h>
 #include "slicethread.h"
+#include "common.h"
+#include "cpu.h"
+#include "executor.h"
+#include "log.h"
 #include "mem.h"
 #include "thread.h"
 #include "avassert.h"
 
 #if HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS
 
+#ifdef __linux__
+#include <sched.h>
+#include <sys/resource.h>
+#endif
+
+/*
+ * All slice threading contexts of the process share one pool of worker
+ * threads, whose size is limited by av_get_thread_budget().
+ *
+ * Each avpriv_slicethread_execute() call hands out tickets, each allowing one
+ * more worker to take part in running its jobs. Tickets are pushed to the
+ * per-worker deques; a worker takes the newest ticket from its own deque, or
+ * steals the oldest one from another worker's deque. The calling thread
+ * always runs jobs itself, so that every call completes even if all workers
+ * are busy, and withdraws the tickets which were not taken before returning.
+ *
+ * Contexts attached to an AVExecutorContext use the pool of the executor
+ * instead, which has its own size, priority and affinity.
+ */
+
+/* number of times an idle thread checks for work before sleeping */
+#define SPIN_COUNT  1000
+#define MAX_WORKERS 1024
+#define MAX_CPUS    1024
+
+typedef struct ThreadPool ThreadPool;
+
 typedef struct WorkerContext {
-    AVSliceThread   *ctx;
-    pthread_mutex_t mutex;
-    pthread_cond_t  cond;
+    ThreadPool      *pool;
+    int             index;
     pthread_t       thread;
-    int             done;
+    int             joinable;       // thread was created and not joined yet
+    int             running;        // protected by pool->lock
+
+    pthread_mutex_t lock;           // protects the deque
+    AVSliceThread   **tickets;
+    unsigned        head, tail;
+    unsigned        size;           // power of 2
 } WorkerContext;
 
+struct ThreadPool {
+    WorkerContext   **workers;
+    atomic_int      nb_workers;     // number of allocated workers
+    atomic_int      nb_active;      // workers with index >= nb_active exit
+    atomic_uint     next_worker;
+    int             refcount;       // protected by pool_mutex
+    int             spin_count;
+
+    /* settings of an executor pool */
+    int             nb_threads;     // 0 to follow the thread budget
+    int             priority;
+    int             has_affinity;
+    uint64_t        affinity[MAX_CPUS / 64];
+
+    atomic_int      nb_queued;      // number of tickets in all deques
+    atomic_int      nb_sleeping;
+    atomic_int      nb_busy;        // workers running the jobs of a context
+    atomic_int      finished;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+};
+
+struct AVExecutorInternal {
+    ThreadPool      *pool;
+};
+
 struct AVSliceThread {
-    WorkerContext   *workers;
+    ThreadPool      *pool;
+    AVBufferRef     *executor;
     int             nb_threads;
-    int             nb_active_threads;
-    int             nb_jobs;
 
-    atomic_uint     first_job;
+    /* state of the current avpriv_slicethread_execute() call */
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int             nb_jobs;
+    int             nb_active_threads;
+    int             nb_joined;      // number of thread numbers handed out
+    int             nb_tickets;     // number of tickets not consumed yet
+    atomic_int      nb_running;     // threads running jobs
     atomic_uint     current_job;
-    pthread_mutex_t done_mutex;
-    pthread_cond_t  done_cond;
-    int             done;
-    int             finished;
 
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
 };
 
-static int run_jobs(AVSliceThread *ctx)
+static AVMutex pool_mutex = AV_MUTEX_INITIALIZER;
+static ThreadPool *global_pool;
+
+static int deque_push(WorkerContext *w, AVSliceThread *ctx)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->tail - w->head == w->size) {
+        unsigned size = w->size ? 2 * w->size : 16, i;
+        AVSliceThread **tickets = av_malloc_array(size, sizeof(*tickets));
+        if (!tickets) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        for (i = 0; i < w->tail - w->head; i++)
+            tickets[i] = w->tickets[(w->head + i) & (w->size - 1)];
+        av_free(w->tickets);
+        w->tickets = tickets;
+        w->tail   -= w->head;
+        w->head    = 0;
+        w->size    = size;
+    }
+    w->tickets[w->tail++ & (w->size - 1)] = ctx;
+end:
+    pthread_mutex_unlock(&w->lock);
+    return ret;
+}
+
+static AVSliceThread *deque_pop(WorkerContext *w, int steal)
+{
+    AVSliceThread *ctx = NULL;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->tail != w->head)
+        ctx = steal ? w->tickets[w->head++ & (w->size - 1)]
+                    : w->tickets[--w->tail & (w->size - 1)];
+    pthread_mutex_unlock(&w->lock);
+    return ctx;
+}
+
+/* remove all tickets of ctx from the deque, return their number */
+static int deque_remove(WorkerContext *w, AVSliceThread *ctx)
+{
+    unsigned i, nb;
+
+    pthread_mutex_lock(&w->lock);
+    nb = w->head;
+    for (i = w->head; i != w->tail; i++) {
+        AVSliceThread *t = w->tickets[i & (w->size - 1)];
+        if (t != ctx)
+            w->tickets[nb++ & (w->size - 1)] = t;
+    }
+    i      = w->tail - nb;
+    w->tail = nb;
+    pthread_mutex_unlock(&w->lock);
+    return i;
+}
+
+static AVSliceThread *pool_get_ticket(ThreadPool *pool, WorkerContext *w)
+{
+    AVSliceThread *ctx;
+    int i, nb_workers;
+
+    if (atomic_load_explicit(&pool->nb_queued, memory_order_relaxed) <= 0)
+        return NULL;
+
+    ctx = deque_pop(w, 0);
+    nb_workers = atomic_load_explicit(&pool->nb_workers, memory_order_acquire);
+    for (i = 1; !ctx && i < nb_workers; i++)
+        ctx = deque_pop(pool->workers[(w->index + i) % nb_workers], 1);
+    if (ctx)
+        atomic_fetch_sub_explicit(&pool->nb_queued, 1, memory_order_relaxed);
+    return ctx;
+}
+
+/* Hand out nb_tickets tickets for ctx and wake up sleeping workers.
+ * Return the number of tickets actually queued. */
+static int pool_push_tickets(ThreadPool *pool, AVSliceThread *ctx, int nb_tickets)
+{
+    int nb_active = atomic_load_explicit(&pool->nb_active, memory_order_relaxed);
+    int nb_workers = atomic_load_explicit(&pool->nb_workers, memory_order_acquire);
+    int i, nb_queued = 0;
+
+    nb_active = FFMIN(nb_active, nb_workers);
+    for (i = 0; i < nb_tickets && nb_active > 0; i++) {
+        unsigned idx = atomic_fetch_add_explicit(&pool->next_worker, 1,
+                                                 memory_order_relaxed);
+        atomic_fetch_add_explicit(&pool->nb_queued, 1, memory_order_relaxed);
+        if (deque_push(pool->workers[idx % nb_active], ctx) < 0) {
+            atomic_fetch_sub_explicit(&pool->nb_queued, 1, memory_order_relaxed);
+            break;
+        }
+        nb_queued++;
+    }
+
+    /* pairs with the fence in worker_sleep() */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (nb_queued && atomic_load_explicit(&pool->nb_sleeping, memory_order_relaxed)) {
+        pthread_mutex_lock(&pool->lock);
+        for (i = 0; i < nb_queued; i++)
+            pthread_cond_signal(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return nb_queued;
+}
+
+/* must be called with ctx->lock held, return the thread number or -1 */
+static int join_jobs(AVSliceThread *ctx)
+{
+    if (ctx->nb_joined >= ctx->nb_active_threads ||
+        atomic_load_explicit(&ctx->current_job, memory_order_relaxed) >= ctx->nb_jobs)
+        return -1;
+    atomic_fetch_add_explicit(&ctx->nb_running, 1, memory_order_relaxed);
+    return ctx->nb_joined++;
+}
+
+static void run_jobs(AVSliceThread *ctx, int threadnr)
+{
+    unsigned nb_jobs = ctx->nb_jobs;
+    unsigned current_job;
+
+    while ((current_job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs)
+        ctx->worker_func(ctx->priv, current_job, threadnr, nb_jobs, ctx->nb_active_threads);
+}
+
+/* run jobs on the calling thread, if any are left to hand out */
+static void caller_run_jobs(AVSliceThread *ctx)
+{
+    int threadnr;
+
+    pthread_mutex_lock(&ctx->lock);
+    threadnr = join_jobs(ctx);
+    pthread_mutex_unlock(&ctx->lock);
+    if (threadnr >= 0) {
+        run_jobs(ctx, threadnr);
+        atomic_fetch_sub_explicit(&ctx->nb_running, 1, memory_order_acq_rel);
+    }
+}
+
+/* remove the tickets of ctx no worker has taken yet,
+ * must be called with ctx->lock held */
+static void withdraw_tickets(AVSliceThread *ctx)
+{
+    ThreadPool *pool = ctx->pool;
+    int i, nb_workers = atomic_load_explicit(&pool->nb_workers, memory_order_acquire);
+
+    for (i = 0; i < nb_workers && ctx->nb_tickets; i++) {
+        int nb_removed = deque_remove(pool->workers[i], ctx);
+        ctx->nb_tickets -= nb_removed;
+        atomic_fetch_sub_explicit(&pool->nb_queued, nb_removed, memory_order_relaxed);
+    }
+}
+
+/*
+ * main_func may wait for the jobs to progress, e.g. vp9 filters the rows
+ * decoded by the jobs, so a thread must be running them before it is
+ * called. If no ticket could be queued, or if all workers are busy with
+ * the jobs of other contexts, the calling thread runs the jobs first.
+ * Otherwise idle workers have been woken up and take the tickets.
+ */
+static void ensure_progress(AVSliceThread *ctx, int nb_queued)
 {
-    unsigned nb_jobs    = ctx->nb_jobs;
-    unsigned nb_active_threads = ctx->nb_active_threads;
-    unsigned first_job    = atomic_fetch_add_explicit(&ctx->first_job, 1, memory_order_acq_rel);
-    unsigned current_job  = first_job;
+    ThreadPool *pool = ctx->pool;
+    int run = 1;
+
+    if (nb_queued) {
+        int nb_active  = atomic_load_explicit(&pool->nb_active, memory_order_relaxed);
+        int nb_workers = atomic_load_explicit(&pool->nb_workers, memory_order_relaxed);
+
+        if (atomic_load_explicit(&pool->nb_busy, memory_order_relaxed) <
+            FFMIN(nb_active, nb_workers))
+            return;
+
+        pthread_mutex_lock(&ctx->lock);
+        if (!ctx->nb_joined)
+            withdraw_tickets(ctx);
+        /* a worker which took a ticket joins as soon as it consumes it */
+        run = !ctx->nb_joined && !ctx->nb_tickets;
+        pthread_mutex_unlock(&ctx->lock);
+    }
+    if (run)
+        caller_run_jobs(ctx);
+}
 
-    do {
-        ctx->worker_func(ctx->priv, current_job, first_job, nb_jobs, nb_active_threads);
-    } while ((current_job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs);
+static void consume_ticket(AVSliceThread *ctx)
+{
+    int threadnr;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->nb_tickets--;
+    threadnr = join_jobs(ctx);
+    if (threadnr >= 0) {
+        pthread_mutex_unlock(&ctx->lock);
+        run_jobs(ctx, threadnr);
+        pthread_mutex_lock(&ctx->lock);
+        atomic_fetch_sub_explicit(&ctx->nb_running, 1, memory_order_acq_rel);
+    }
+    /* ctx must not be touched after unlocking, the caller of
+     * avpriv_slicethread_execute() may return as soon as it is signaled */
+    if (!ctx->nb_tickets || !atomic_load_explicit(&ctx->nb_running, memory_order_relaxed))
+        pthread_cond_signal(&ctx->cond);
+    pthread_mutex_unlock(&ctx->lock);
+}
 
-    return current_job == nb_jobs + nb_active_threads - 1;
+/* return 1 if the worker must exit */
+static int worker_sleep(ThreadPool *pool, WorkerContext *w)
+{
+    int exit;
+
+    pthread_mutex_lock(&pool->lock);
+    exit = atomic_load(&pool->finished) ||
+           w->index >= atomic_load_explicit(&pool->nb_active, memory_order_relaxed);
+    if (!exit) {
+        atomic_fetch_add_explicit(&pool->nb_sleeping, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&pool->nb_queued, memory_order_relaxed) <= 0)
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        atomic_fetch_sub_explicit(&pool->nb_sleeping, 1, memory_order_relaxed);
+    } else {
+        w->running = 0;
+        /* pass on a wakeup which may have been meant for another worker */
+        if (atomic_load(&pool->nb_queued) > 0)
+            pthread_cond_signal(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return exit;
+}
+
+static void thread_setup(const ThreadPool *pool)
+{
+#ifdef __linux__
+    /* nice values and the CPU affinity are per thread on Linux */
+    if (pool->priority && setpriority(PRIO_PROCESS, 0, pool->priority) < 0)
+        av_log(NULL, AV_LOG_WARNING, "Could not set thread priority %d\n",
+               pool->priority);
+
+    if (pool->has_affinity) {
+        cpu_set_t set;
+        int i;
+
+        CPU_ZERO(&set);
+        for (i = 0; i < FFMIN(MAX_CPUS, CPU_SETSIZE); i++)
+            if (pool->affinity[i >> 6] & (1ULL << (i & 63)))
+                CPU_SET(i, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0)
+            av_log(NULL, AV_LOG_WARNING, "Could not set thread affinity\n");
+    }
+#endif
 }
 
 static void *attribute_align_arg thread_worker(void *v)
 {
     WorkerContext *w = v;
-    AVSliceThread *ctx = w->ctx;
+    ThreadPool *pool = w->pool;
 
-    pthread_mutex_lock(&w->mutex);
-    pthread_cond_signal(&w->cond);
+    thread_setup(pool);
 
     while (1) {
-        w->done = 1;
-        while (w->done)
-            pthread_cond_wait(&w->cond, &w->mutex);
+        AVSliceThread *ctx = NULL;
+        int i;
 
-        if (ctx->finished) {
-            pthread_mutex_unlock(&w->mutex);
+        for (i = 0; !ctx && i <= pool->spin_count; i++)
+            ctx = pool_get_ticket(pool, w);
+
+        if (ctx) {
+            atomic_fetch_add_explicit(&pool->nb_busy, 1, memory_order_relaxed);
+            consume_ticket(ctx);
+            atomic_fetch_sub_explicit(&pool->nb_busy, 1, memory_order_relaxed);
+        } else if (worker_sleep(pool, w))
             return NULL;
+    }
+}
+
+static WorkerContext *pool_get_worker(ThreadPool *pool, int index)
+{
+    WorkerContext *w;
+
+    if (index < atomic_load_explicit(&pool->nb_workers, memory_order_relaxed))
+        return pool->workers[index];
+
+    w = av_mallocz(sizeof(*w));
+    if (!w)
+        return NULL;
+    w->pool  = pool;
+    w->index = index;
+    pthread_mutex_init(&w->lock, NULL);
+    pool->workers[index] = w;
+    atomic_store_explicit(&pool->nb_workers, index + 1, memory_order_release);
+    return w;
+}
+
+/* Start or stop workers according to the thread budget,
+ * must be called with pool_mutex held. */
+static void pool_update(ThreadPool *pool)
+{
+    int nb_active = FFMIN(pool->nb_threads ? pool->nb_threads :
+                          av_get_thread_budget(), MAX_WORKERS);
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    atomic_store_explicit(&pool->nb_active, nb_active, memory_order_relaxed);
+    pthread_cond_broadcast(&pool->cond);
+
+    for (i = 0; i < nb_active; i++) {
+        WorkerContext *w = pool_get_worker(pool, i);
+        if (!w)
+            break;
+        if (w->running)
+            continue;
+        if (w->joinable) {
+            pthread_join(w->thread, NULL);
+            w->joinable = 0;
         }
+        if (pthread_create(&w->thread, NULL, thread_worker, w))
+            break;
+        w->joinable = 1;
+        w->running  = 1;
+    }
+    /* run without the workers which could not be started */
+    atomic_store_explicit(&pool->nb_active, i, memory_order_relaxed);
+    pthread_mutex_unlock(&pool->lock);
+}
 
-        if (run_jobs(ctx)) {
-            pthread_mutex_lock(&ctx->done_mutex);
-            ctx->done = 1;
-            pthread_cond_signal(&ctx->done_cond);
-            pthread_mutex_unlock(&ctx->done_mutex);
+static void pool_free(ThreadPool *pool)
+{
+    int i, nb_workers = atomic_load(&pool->nb_workers);
+
+    pthread_mutex_lock(&pool->lock);
+    atomic_store(&pool->finished, 1);
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < nb_workers; i++) {
+        WorkerContext *w = pool->workers[i];
+        if (w->joinable)
+            pthread_join(w->thread, NULL);
+        pthread_mutex_destroy(&w->lock);
+        av_freep(&w->tickets);
+        av_freep(&pool->workers[i]);
+    }
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    av_freep(&pool->workers);
+    av_freep(&pool);
+}
+
+static ThreadPool *pool_alloc(void)
+{
+    ThreadPool *pool = av_mallocz(sizeof(*pool));
+
+    if (!pool || !(pool->workers = av_calloc(MAX_WORKERS, sizeof(*pool->workers)))) {
+        av_freep(&pool);
+        return NULL;
+    }
+    atomic_init(&pool->nb_workers, 0);
+    atomic_init(&pool->nb_active, 0);
+    atomic_init(&pool->next_worker, 0);
+    atomic_init(&pool->nb_queued, 0);
+    atomic_init(&pool->nb_sleeping, 0);
+    atomic_init(&pool->nb_busy, 0);
+    atomic_init(&pool->finished, 0);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    pool->spin_count = av_cpu_count() > 1 ? SPIN_COUNT : 0;
+    return pool;
+}
+
+static ThreadPool *pool_ref(void)
+{
+    ThreadPool *pool;
+
+    ff_mutex_lock(&pool_mutex);
+    pool = global_pool;
+    if (!pool) {
+        if (!(pool = pool_alloc()))
+            goto end;
+        global_pool = pool;
+    }
+    pool->refcount++;
+    pool_update(pool);
+end:
+    ff_mutex_unlock(&pool_mutex);
+    return pool;
+}
+
+static void pool_unref(ThreadPool **ppool)
+{
+    ThreadPool *pool = *ppool;
+
+    if (!pool)
+        return;
+    *ppool = NULL;
+
+    ff_mutex_lock(&pool_mutex);
+    if (--pool->refcount) {
+        pool = NULL;
+    } else {
+        global_pool = NULL;
+    }
+    ff_mutex_unlock(&pool_mutex);
+
+    if (pool)
+        pool_free(pool);
+}
+
+static int parse_affinity(ThreadPool *pool, const char *str)
+{
+    while (*str) {
+        char *end;
+        long first, last, i;
+
+        first = last = strtol(str, &end, 10);
+        if (end != str && *end == '-') {
+            str  = end + 1;
+            last = strtol(str, &end, 10);
         }
+        if (end == str || first < 0 || last < first || last >= MAX_CPUS ||
+            (*end && *end != ','))
+            return AVERROR(EINVAL);
+
+        for (i = first; i <= last; i++)
+            pool->affinity[i >> 6] |= 1ULL << (i & 63);
+        pool->has_affinity = 1;
+        str = *end ? end + 1 : end;
     }
+    return 0;
+}
+
+int ff_executor_init(AVExecutorContext *exec)
+{
+    ThreadPool *pool;
+    int ret;
+
+    if (!(exec->internal = av_mallocz(sizeof(*exec->internal))))
+        return AVERROR(ENOMEM);
+    if (!(pool = pool_alloc())) {
+        av_freep(&exec->internal);
+        return AVERROR(ENOMEM);
+    }
+    pool->nb_threads = exec->nb_threads;
+    pool->priority   = exec->priority;
+    if (exec->affinity && (ret = parse_affinity(pool, exec->affinity)) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Invalid CPU list '%s'\n", exec->affinity);
+        pool_free(pool);
+        av_freep(&exec->internal);
+        return ret;
+    }
+
+    ff_mutex_lock(&pool_mutex);
+    pool_update(pool);
+    ff_mutex_unlock(&pool_mutex);
+
+    exec->internal->pool = pool;
+    return 0;
+}
+
+void ff_executor_uninit(AVExecutorContext *exec)
+{
+    if (exec->internal)
+        pool_free(exec->internal->pool);
+    av_freep(&exec->internal);
+}
+
+void avpriv_executor_setup_thread(AVBufferRef *executor)
+{
+    AVExecutorContext *exec = executor ? (AVExecutorContext*)executor->data : NULL;
+
+    if (exec && exec->internal)
+        thread_setup(exec->internal->pool);
 }
 
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
@@ -96,8 +597,17 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*main_func)(void *priv),
                               int nb_threads)
 {
+    return avpriv_slicethread_create2(pctx, priv, worker_func, main_func,
+                                      nb_threads, NULL);
+}
+
+int avpriv_slicethread_create2(AVSliceThread **pctx, void *priv,
+                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                               void (*main_func)(void *priv),
+                               int nb_threads, AVBufferRef *executor)
+{
+    AVExecutorContext *exec = executor ? (AVExecutorContext*)executor->data : NULL;
     AVSliceThread *ctx;
-    int nb_workers, i;
 
     av_assert0(nb_threads >= 0);
     if (!nb_threads) {
@@ -108,15 +618,21 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
             nb_threads = 1;
     }
 
-    nb_workers = nb_threads;
-    if (!main_func)
-        nb_workers--;
-
     *pctx = ctx = av_mallocz(sizeof(*ctx));
     if (!ctx)
         return AVERROR(ENOMEM);
 
-    if (nb_workers && !(ctx->workers = av_calloc(nb_workers, sizeof(*ctx->workers)))) {
+    if (exec) {
+        if (!exec->internal) {
+            av_freep(pctx);
+            return AVERROR(EINVAL);
+        }
+        if (!(ctx->executor = av_buffer_ref(executor))) {
+            av_freep(pctx);
+            return AVERROR(ENOMEM);
+        }
+        ctx->pool = exec->internal->pool;
+    } else if (!(ctx->pool = pool_ref())) {
         av_freep(pctx);
         return AVERROR(ENOMEM);
     }
@@ -125,114 +641,95 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     ctx->worker_func = worker_func;
     ctx->main_func   = main_func;
     ctx->nb_threads  = nb_threads;
-    ctx->nb_active_threads = 0;
-    ctx->nb_jobs     = 0;
-    ctx->finished    = 0;
 
-    atomic_init(&ctx->first_job, 0);
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->cond, NULL);
+    atomic_init(&ctx->nb_running, 0);
     atomic_init(&ctx->current_job, 0);
-    pthread_mutex_init(&ctx->done_mutex, NULL);
-    pthread_cond_init(&ctx->done_cond, NULL);
-    ctx->done        = 0;
-
-    for (i = 0; i < nb_workers; i++) {
-        WorkerContext *w = &ctx->workers[i];
-        int ret;
-        w->ctx = ctx;
-        pthread_mutex_init(&w->mutex, NULL);
-        pthread_cond_init(&w->cond, NULL);
-        pthread_mutex_lock(&w->mutex);
-        w->done = 0;
-
-        if (ret = pthread_create(&w->thread, NULL, thread_worker, w)) {
-            ctx->nb_threads = main_func ? i : i + 1;
-            pthread_mutex_unlock(&w->mutex);
-            pthread_cond_destroy(&w->cond);
-            pthread_mutex_destroy(&w->mutex);
-            avpriv_slicethread_free(pctx);
-            return AVERROR(ret);
-        }
-
-        while (!w->done)
-            pthread_cond_wait(&w->cond, &w->mutex);
-        pthread_mutex_unlock(&w->mutex);
-    }
 
     return nb_threads;
 }
 
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
 {
-    int nb_workers, i, is_last = 0;
+    ThreadPool *pool = ctx->pool;
+    int nb_tickets, nb_queued, i;
 
     av_assert0(nb_jobs > 0);
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
-    atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
-    atomic_store_explicit(&ctx->current_job, ctx->nb_active_threads, memory_order_relaxed);
-    nb_workers             = ctx->nb_active_threads;
-    if (!ctx->main_func || !execute_main)
-        nb_workers--;
+    ctx->nb_joined         = 0;
+    atomic_store_explicit(&ctx->current_job, 0, memory_order_relaxed);
 
-    for (i = 0; i < nb_workers; i++) {
-        WorkerContext *w = &ctx->workers[i];
-        pthread_mutex_lock(&w->mutex);
-        w->done = 0;
-        pthread_cond_signal(&w->cond);
-        pthread_mutex_unlock(&w->mutex);
+    nb_tickets = ctx->nb_active_threads;
+    if (!ctx->main_func || !execute_main)
+        nb_tickets--;
+    ctx->nb_tickets = nb_tickets;
+    nb_queued = pool_push_tickets(pool, ctx, nb_tickets);
+    if (nb_tickets > nb_queued) {
+        pthread_mutex_lock(&ctx->lock);
+        ctx->nb_tickets -= nb_tickets - nb_queued;
+        pthread_mutex_unlock(&ctx->lock);
     }
 
-    if (ctx->main_func && execute_main)
+    if (ctx->main_func && execute_main) {
+        ensure_progress(ctx, nb_queued);
         ctx->main_func(ctx->priv);
-    else
-        is_last = run_jobs(ctx);
-
-    if (!is_last) {
-        pthread_mutex_lock(&ctx->done_mutex);
-        while (!ctx->done)
-            pthread_cond_wait(&ctx->done_cond, &ctx->done_mutex);
-        ctx->done = 0;
-        pthread_mutex_unlock(&ctx->done_mutex);
     }
+
+    /* take part in running the jobs, this also guarantees progress when
+     * all workers are busy */
+    caller_run_jobs(ctx);
+
+    for (i = 0; i < pool->spin_count &&
+                atomic_load_explicit(&ctx->nb_running, memory_order_acquire); i++)
+        ;
+
+    pthread_mutex_lock(&ctx->lock);
+    while (atomic_load_explicit(&ctx->nb_running, memory_order_acquire))
+        pthread_cond_wait(&ctx->cond, &ctx->lock);
+
+    /* all jobs are done, withdraw the tickets no worker has taken */
+    withdraw_tickets(ctx);
+    /* wait for the workers which took a ticket but did not use it yet */
+    while (ctx->nb_tickets)
+        pthread_cond_wait(&ctx->cond, &ctx->lock);
+    pthread_mutex_unlock(&ctx->lock);
 }
 
 void avpriv_slicethread_free(AVSliceThread **pctx)
 {
     AVSliceThread *ctx;
-    int nb_workers, i;
 
     if (!pctx || !*pctx)
         return;
 
     ctx = *pctx;
-    nb_workers = ctx->nb_threads;
-    if (!ctx->main_func)
-        nb_workers--;
-
-    ctx->finished = 1;
-    for (i = 0; i < nb_workers; i++) {
-        WorkerContext *w = &ctx->workers[i];
-        pthread_mutex_lock(&w->mutex);
-        w->done = 0;
-        pthread_cond_signal(&w->cond);
-        pthread_mutex_unlock(&w->mutex);
-    }
-
-    for (i = 0; i < nb_workers; i++) {
-        WorkerContext *w = &ctx->workers[i];
-        pthread_join(w->thread, NULL);
-        pthread_cond_destroy(&w->cond);
-        pthread_mutex_destroy(&w->mutex);
-    }
+    if (ctx->executor)
+        av_buffer_unref(&ctx->executor);
+    else
+        pool_unref(&ctx->pool);
 
-    pthread_cond_destroy(&ctx->done_cond);
-    pthread_mutex_destroy(&ctx->done_mutex);
-    av_freep(&ctx->workers);
+    pthread_cond_destroy(&ctx->cond);
+    pthread_mutex_destroy(&ctx->lock);
     av_freep(pctx);
 }
 
 #else /* HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS32THREADS */
 
+int ff_executor_init(AVExecutorContext *exec)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_executor_uninit(AVExecutorContext *exec)
+{
+}
+
+void avpriv_executor_setup_thread(AVBufferRef *executor)
+{
+}
+
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
                               void (*main_func)(void *priv),
@@ -242,6 +739,15 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     return AVERROR(EINVAL);
 }
 
+int avpriv_slicethread_create2(AVSliceThread **pctx, void *priv,
+                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                               void (*main_func)(void *priv),
+                               int nb_threads, AVBufferRef *executor)
+{
+    *pctx = NULL;
+    return AVERROR(EINVAL);
+}
+
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
 {
     av_assert0(0);
@@ -19,15 +19,23 @@
 #ifndef AVUTIL_SLICETHREAD_H
 #define AVUTIL_SLICETHREAD_H
 
+#include "buffer.h"
+#include "executor.h"
+
 typedef struct AVSliceThread AVSliceThread;
 
 /**
  * Create slice threading context.
+ *
+ * The jobs are run by the calling thread and by workers of a thread pool
+ * shared by all contexts of the process, see av_set_thread_budget().
+ *
  * @param pctx slice threading context returned here
  * @param priv private pointer to be passed to callback function
  * @param worker_func callback function to be executed
  * @param main_func special callback function, called from main thread, may be NULL
- * @param nb_threads number of threads, 0 for automatic, must be >= 0
+ * @param nb_threads maximum number of threads running jobs at the same time,
+ *                   0 for automatic, must be >= 0
  * @return return number of threads or negative AVERROR on failure
  */
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
@@ -35,6 +43,19 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*main_func)(void *priv),
                               int nb_threads);
 
+/**
+ * Create slice threading context running its jobs on the given executor.
+ *
+ * @param executor a reference to an initialized AVExecutorContext, NULL to
+ *                 use the pool shared by the process; a new reference is
+ *                 created by this function
+ * @see avpriv_slicethread_create()
+ */
+int avpriv_slicethread_create2(AVSliceThread **pctx, void *priv,
+                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                               void (*main_func)(void *priv),
+                               int nb_threads, AVBufferRef *executor);
+
 /**
  * Execute slice threading.
  * @param ctx slice threading context
@@ -49,4 +70,18 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
  */
 void avpriv_slicethread_free(AVSliceThread **pctx);
 
+/**
+ * Apply the priority and CPU affinity of an executor to the calling thread,
+ * for threads which cannot run as tasks of the executor.
+ *
+ * @param executor a reference to an AVExecutorContext, may be NULL
+ */
+void avpriv_executor_setup_thread(AVBufferRef *executor);
+
+/**
+ * Start and stop the worker threads of an executor, for executor.c.
+ */
+int ff_executor_init(AVExecutorContext *exec);
+void ff_executor_uninit(AVExecutorContext *exec);
+
 #endif
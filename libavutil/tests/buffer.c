@@ -0,0 +1,167 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/common.h"
+#include "libavutil/thread.h"
+
+#define NB_THREADS 4
+#define NB_ITERS   10000
+#define NB_FIXED   4
+
+static void print_stats(AVBufferPool *pool)
+{
+    AVBufferPoolStats stats;
+
+    av_buffer_pool_get_stats(pool, &stats);
+    printf("hits %"PRIu64" misses %"PRIu64" outstanding %d peak %d\n",
+           stats.hits, stats.misses, stats.outstanding, stats.peak_outstanding);
+}
+
+#if HAVE_THREADS
+static void *thread_main(void *arg)
+{
+    AVBufferPool *pool = arg;
+    AVBufferRef *bufs[3];
+    int i, j;
+
+    for (i = 0; i < NB_ITERS; i++) {
+        for (j = 0; j < FF_ARRAY_ELEMS(bufs); j++) {
+            if (!(bufs[j] = av_buffer_pool_get(pool)))
+                return pool;
+            bufs[j]->data[0] = j;
+        }
+        for (j = 0; j < FF_ARRAY_ELEMS(bufs); j++) {
+            if (bufs[j]->data[0] != j)
+                return pool;
+            av_buffer_unref(&bufs[j]);
+        }
+    }
+    return NULL;
+}
+
+static int nb_fixed_allocated;
+
+/* like the pools of hardware surfaces, which cannot grow */
+static AVBufferRef *alloc_fixed(int size)
+{
+    if (nb_fixed_allocated == NB_FIXED)
+        return NULL;
+    nb_fixed_allocated++;
+    return av_buffer_alloc(size);
+}
+
+/* leave all the buffers of the pool free in the cache of this thread */
+static void *fixed_thread_main(void *arg)
+{
+    AVBufferPool *pool = arg;
+    AVBufferRef *bufs[NB_FIXED];
+    int i;
+
+    for (i = 0; i < NB_FIXED; i++)
+        if (!(bufs[i] = av_buffer_pool_get(pool)))
+            return pool;
+    for (i = 0; i < NB_FIXED; i++)
+        av_buffer_unref(&bufs[i]);
+    return NULL;
+}
+
+static int test_fixed_pool(void)
+{
+    AVBufferPool *pool = av_buffer_pool_init(1024, alloc_fixed);
+    AVBufferRef *bufs[NB_FIXED];
+    pthread_t thread;
+    void *ret;
+    int i;
+
+    if (!pool)
+        return 1;
+    if (pthread_create(&thread, NULL, fixed_thread_main, pool))
+        return 1;
+    pthread_join(thread, &ret);
+    if (ret)
+        return 1;
+
+    for (i = 0; i < NB_FIXED; i++)
+        if (!(bufs[i] = av_buffer_pool_get(pool)))
+            return 1;
+    for (i = 0; i < NB_FIXED; i++)
+        av_buffer_unref(&bufs[i]);
+    av_buffer_pool_uninit(&pool);
+    return 0;
+}
+#endif
+
+int main(void)
+{
+    AVBufferPool *pool = av_buffer_pool_init(1024, NULL);
+    AVBufferRef *bufs[4];
+    AVBufferPoolStats stats;
+    int i;
+
+    if (!pool)
+        return 1;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(bufs); i++)
+        if (!(bufs[i] = av_buffer_pool_get(pool)))
+            return 1;
+    print_stats(pool);
+    for (i = 0; i < FF_ARRAY_ELEMS(bufs); i++)
+        av_buffer_unref(&bufs[i]);
+    print_stats(pool);
+    for (i = 0; i < 2; i++)
+        if (!(bufs[i] = av_buffer_pool_get(pool)))
+            return 1;
+    print_stats(pool);
+    for (i = 0; i < 2; i++)
+        av_buffer_unref(&bufs[i]);
+
+#if HAVE_THREADS
+    {
+        pthread_t threads[NB_THREADS];
+        void *ret;
+        int failed = 0;
+
+        for (i = 0; i < NB_THREADS; i++)
+            if (pthread_create(&threads[i], NULL, thread_main, pool))
+                return 1;
+        for (i = 0; i < NB_THREADS; i++) {
+            pthread_join(threads[i], &ret);
+            failed |= !!ret;
+        }
+        if (failed)
+            return 1;
+    }
+#endif
+
+    av_buffer_pool_get_stats(pool, &stats);
+    if (stats.outstanding ||
+        stats.hits + stats.misses != 6 + (uint64_t)HAVE_THREADS * NB_THREADS * NB_ITERS * 3)
+        return 1;
+
+    av_buffer_pool_uninit(&pool);
+
+#if HAVE_THREADS
+    if (test_fixed_pool())
+        return 1;
+#endif
+    return 0;
+}
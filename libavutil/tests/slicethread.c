@@ -0,0 +1,214 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Runs several slice threading contexts concurrently on the shared worker
+ * pool and on an executor, and checks that every job is run exactly once and
+ * that thread numbers are never used by two threads at the same time.
+ * Also checks that a main function waiting for the jobs, as the vp9 loop
+ * filter does, completes while the workers are busy.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "libavutil/cpu.h"
+#include "libavutil/executor.h"
+#include "libavutil/mem.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define NB_CONTEXTS 3
+#define NB_THREADS  4
+#define MAX_JOBS    32
+#define NB_ROUNDS   2000
+
+typedef struct Context {
+    AVSliceThread *thread;
+    atomic_int    jobs[MAX_JOBS];
+    atomic_int    busy[NB_THREADS];
+    int           nb_main;
+    int           failed;
+} Context;
+
+static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    Context *c = priv;
+
+    if (threadnr < 0 || threadnr >= nb_threads || nb_threads > NB_THREADS ||
+        atomic_exchange(&c->busy[threadnr], 1)) {
+        c->failed = 1;
+        return;
+    }
+    atomic_fetch_add(&c->jobs[jobnr], 1);
+    atomic_store(&c->busy[threadnr], 0);
+}
+
+static void main_func(void *priv)
+{
+    Context *c = priv;
+    c->nb_main++;
+}
+
+static void *thread_main(void *arg)
+{
+    Context *c = arg;
+    int i, j;
+
+    for (i = 0; i < NB_ROUNDS && !c->failed; i++) {
+        int nb_jobs = 1 + i % MAX_JOBS;
+
+        for (j = 0; j < MAX_JOBS; j++)
+            atomic_store(&c->jobs[j], 0);
+        avpriv_slicethread_execute(c->thread, nb_jobs, i & 1);
+        for (j = 0; j < MAX_JOBS; j++)
+            if (atomic_load(&c->jobs[j]) != (j < nb_jobs))
+                c->failed = 1;
+    }
+    return NULL;
+}
+
+typedef struct BusyContext {
+    AVSliceThread *thread;
+    pthread_t     caller;
+    atomic_int    entered;
+    atomic_int    release;
+    atomic_int    nb_done;
+} BusyContext;
+
+/* blocks the worker running it until released */
+static void busy_worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    BusyContext *b = priv;
+
+    if (pthread_equal(pthread_self(), b->caller)) {
+        while (!atomic_load(&b->entered))
+            av_usleep(100);
+        return;
+    }
+    atomic_store(&b->entered, 1);
+    while (!atomic_load(&b->release))
+        av_usleep(100);
+}
+
+static void *busy_thread_main(void *arg)
+{
+    BusyContext *b = arg;
+
+    b->caller = pthread_self();
+    avpriv_slicethread_execute(b->thread, 2, 0);
+    return NULL;
+}
+
+static void count_worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    BusyContext *b = priv;
+    atomic_fetch_add(&b->nb_done, 1);
+}
+
+static void wait_main_func(void *priv)
+{
+    BusyContext *b = priv;
+
+    while (atomic_load(&b->nb_done) < 4)
+        av_usleep(100);
+}
+
+static int test_busy_workers(void)
+{
+    static BusyContext busy, waiter;
+    AVBufferRef *executor;
+    AVExecutorContext *exec;
+    pthread_t thread;
+
+    if (!(executor = av_executor_alloc()))
+        return 1;
+    exec = (AVExecutorContext*)executor->data;
+    exec->nb_threads = 1;
+    if (av_executor_init(executor) < 0 ||
+        avpriv_slicethread_create2(&busy.thread, &busy, busy_worker_func,
+                                   NULL, 2, executor) != 2 ||
+        avpriv_slicethread_create2(&waiter.thread, &waiter, count_worker_func,
+                                   wait_main_func, 2, executor) != 2)
+        return 1;
+    av_buffer_unref(&executor);
+
+    /* keep the only worker busy, then run jobs the main function waits for */
+    if (pthread_create(&thread, NULL, busy_thread_main, &busy))
+        return 1;
+    while (!atomic_load(&busy.entered))
+        av_usleep(100);
+    avpriv_slicethread_execute(waiter.thread, 4, 1);
+
+    atomic_store(&busy.release, 1);
+    pthread_join(thread, NULL);
+    avpriv_slicethread_free(&waiter.thread);
+    avpriv_slicethread_free(&busy.thread);
+    return atomic_load(&waiter.nb_done) != 4;
+}
+
+int main(void)
+{
+    static Context ctx[NB_CONTEXTS];
+    pthread_t threads[NB_CONTEXTS];
+    AVBufferRef *executor;
+    AVExecutorContext *exec;
+    int i, ret = 0;
+
+    av_set_thread_budget(2);
+
+    if (!(executor = av_executor_alloc()))
+        return 1;
+    exec = (AVExecutorContext*)executor->data;
+    exec->nb_threads = 2;
+    exec->affinity   = av_strdup("0,0-1,x");
+    if (av_executor_init(executor) != AVERROR(EINVAL))
+        return 1;
+    av_freep(&exec->affinity);
+    if (av_executor_init(executor) < 0)
+        return 1;
+
+    /* the last context runs on the executor */
+    for (i = 0; i < NB_CONTEXTS; i++) {
+        if (avpriv_slicethread_create2(&ctx[i].thread, &ctx[i], worker_func,
+                                       i ? main_func : NULL, NB_THREADS,
+                                       i == NB_CONTEXTS - 1 ? executor : NULL) != NB_THREADS)
+            return 1;
+    }
+    av_buffer_unref(&executor);
+
+    for (i = 0; i < NB_CONTEXTS; i++)
+        if (pthread_create(&threads[i], NULL, thread_main, &ctx[i]))
+            return 1;
+    for (i = 0; i < NB_CONTEXTS; i++) {
+        pthread_join(threads[i], NULL);
+        if (ctx[i].failed || ctx[i].nb_main != (i ? NB_ROUNDS / 2 : 0)) {
+            fprintf(stderr, "context %d failed\n", i);
+            ret = 1;
+        }
+        avpriv_slicethread_free(&ctx[i].thread);
+    }
+
+    if (test_busy_workers()) {
+        fprintf(stderr, "main function waiting for busy workers failed\n");
+        ret = 1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,247 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Checks both message queue backends with several producer and consumer
+ * threads. With -t, the time taken by each configuration is printed.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+#include "libavutil/time.h"
+
+#define MAX_THREADS 4
+
+typedef struct Message {
+    unsigned producer;
+    unsigned seq;
+} Message;
+
+typedef struct Producer {
+    AVThreadMessageQueue *mq;
+    unsigned id;
+    unsigned nb_msgs;
+    int ret;
+} Producer;
+
+typedef struct Consumer {
+    AVThreadMessageQueue *mq;
+    unsigned nb_producers;
+    int check_order;
+    uint64_t count;
+    uint64_t sum;
+    unsigned next[MAX_THREADS];
+    int ret;
+} Consumer;
+
+static void *producer_thread(void *arg)
+{
+    Producer *p = arg;
+    unsigned i;
+
+    for (i = 0; i < p->nb_msgs; i++) {
+        Message msg = { p->id, i };
+        if ((p->ret = av_thread_message_queue_send(p->mq, &msg, 0)) < 0)
+            break;
+    }
+    return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+    Consumer *c = arg;
+    Message msg;
+
+    while ((c->ret = av_thread_message_queue_recv(c->mq, &msg, 0)) >= 0) {
+        if (msg.producer >= c->nb_producers ||
+            (c->check_order && msg.seq != c->next[msg.producer]++)) {
+            c->ret = AVERROR_BUG;
+            break;
+        }
+        c->count++;
+        c->sum += msg.seq;
+    }
+    if (c->ret == AVERROR_EOF)
+        c->ret = 0;
+    return NULL;
+}
+
+static int run(unsigned flags, unsigned nb_producers, unsigned nb_consumers,
+               unsigned queue_size, unsigned nb_msgs, int64_t *time)
+{
+    AVThreadMessageQueue *mq;
+    Producer producers[MAX_THREADS] = { { 0 } };
+    Consumer consumers[MAX_THREADS] = { { 0 } };
+    pthread_t pthreads[MAX_THREADS], cthreads[MAX_THREADS];
+    uint64_t count = 0, sum = 0;
+    int64_t start;
+    unsigned i;
+    int ret;
+
+    if ((ret = av_thread_message_queue_alloc2(&mq, queue_size, sizeof(Message),
+                                              flags)) < 0)
+        return ret;
+
+    start = av_gettime_relative();
+    for (i = 0; i < nb_consumers; i++) {
+        consumers[i].mq           = mq;
+        consumers[i].nb_producers = nb_producers;
+        consumers[i].check_order  = nb_consumers == 1;
+        if (pthread_create(&cthreads[i], NULL, consumer_thread, &consumers[i]))
+            return AVERROR(EINVAL);
+    }
+    for (i = 0; i < nb_producers; i++) {
+        producers[i].mq      = mq;
+        producers[i].id      = i;
+        producers[i].nb_msgs = nb_msgs;
+        if (pthread_create(&pthreads[i], NULL, producer_thread, &producers[i]))
+            return AVERROR(EINVAL);
+    }
+
+    for (i = 0; i < nb_producers; i++) {
+        pthread_join(pthreads[i], NULL);
+        if (producers[i].ret < 0)
+            ret = producers[i].ret;
+    }
+    av_thread_message_queue_set_err_recv(mq, AVERROR_EOF);
+    for (i = 0; i < nb_consumers; i++) {
+        pthread_join(cthreads[i], NULL);
+        if (consumers[i].ret < 0)
+            ret = consumers[i].ret;
+        count += consumers[i].count;
+        sum   += consumers[i].sum;
+    }
+    *time = av_gettime_relative() - start;
+
+    av_thread_message_queue_free(&mq);
+
+    if (ret >= 0 &&
+        (count != (uint64_t)nb_producers * nb_msgs ||
+         sum   != (uint64_t)nb_producers * nb_msgs * (nb_msgs - 1) / 2))
+        ret = AVERROR_BUG;
+    return ret;
+}
+
+static int nb_freed;
+
+static void free_msg(void *msg)
+{
+    nb_freed++;
+}
+
+static int check_single_thread(unsigned flags)
+{
+    AVThreadMessageQueue *mq;
+    Message msg = { 0 };
+    int i, ret;
+
+    if ((ret = av_thread_message_queue_alloc2(&mq, 3, sizeof(msg), flags)) < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(mq, free_msg);
+
+    /* the lock-free queue rounds its capacity up to 4 */
+    for (i = 0; i < 5; i++) {
+        msg.seq = i;
+        ret = av_thread_message_queue_send(mq, &msg, AV_THREAD_MESSAGE_NONBLOCK);
+        if (ret == AVERROR(EAGAIN))
+            break;
+        if (ret < 0)
+            goto end;
+    }
+    if (i != (flags & AV_THREAD_MESSAGE_QUEUE_FLAG_LOCKLESS ? 4 : 3) ||
+        av_thread_message_queue_nb_elems(mq) != i) {
+        ret = AVERROR_BUG;
+        goto end;
+    }
+
+    if ((ret = av_thread_message_queue_recv(mq, &msg, 0)) < 0)
+        goto end;
+    if (msg.seq != 0) {
+        ret = AVERROR_BUG;
+        goto end;
+    }
+
+    nb_freed = 0;
+    av_thread_message_flush(mq);
+    if (nb_freed != i - 1 || av_thread_message_queue_nb_elems(mq)) {
+        ret = AVERROR_BUG;
+        goto end;
+    }
+
+    ret = av_thread_message_queue_recv(mq, &msg, AV_THREAD_MESSAGE_NONBLOCK);
+    if (ret != AVERROR(EAGAIN)) {
+        ret = AVERROR_BUG;
+        goto end;
+    }
+    av_thread_message_queue_set_err_recv(mq, AVERROR_EOF);
+    ret = av_thread_message_queue_recv(mq, &msg, 0);
+    if (ret != AVERROR_EOF) {
+        ret = AVERROR_BUG;
+        goto end;
+    }
+    av_thread_message_queue_set_err_send(mq, AVERROR_EXIT);
+    ret = av_thread_message_queue_send(mq, &msg, 0);
+    ret = ret == AVERROR_EXIT ? 0 : AVERROR_BUG;
+
+end:
+    av_thread_message_queue_free(&mq);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const unsigned configs[][2] = {
+        { 1, 1 }, { 1, 4 }, { 4, 1 }, { 4, 4 },
+    };
+    int timing = argc > 1 && !strcmp(argv[1], "-t");
+    unsigned nb_msgs = timing ? 1000000 : 10000;
+    int64_t time;
+    int i, j, ret;
+
+    for (j = 0; j < 2; j++) {
+        unsigned flags = j ? AV_THREAD_MESSAGE_QUEUE_FLAG_LOCKLESS : 0;
+        const char *name = j ? "lockless" : "locked";
+
+        if ((ret = check_single_thread(flags)) < 0) {
+            fprintf(stderr, "%s: single thread check failed: %s\n",
+                    name, av_err2str(ret));
+            return 1;
+        }
+
+        for (i = 0; i < FF_ARRAY_ELEMS(configs); i++) {
+            ret = run(flags, configs[i][0], configs[i][1], 64, nb_msgs, &time);
+            if (ret < 0) {
+                fprintf(stderr, "%s %up/%uc: failed: %s\n", name,
+                        configs[i][0], configs[i][1], av_err2str(ret));
+                return 1;
+            }
+            if (timing)
+                printf("%-8s %up/%uc: %u msgs per producer in %"PRId64" us\n",
+                       name, configs[i][0], configs[i][1], nb_msgs, time);
+        }
+    }
+
+    return 0;
+}
@@ -18,34 +18,102 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+#include <string.h>
+
+#include "common.h"
+#include "cpu.h"
 #include "fifo.h"
+#include "mem.h"
 #include "threadmessage.h"
 #include "thread.h"
 
+/* number of attempts of a lock-free operation before blocking, spinning is
+ * pointless on a single CPU since the other side cannot make progress */
+#define SPIN_COUNT 1000
+
 struct AVThreadMessageQueue {
 #if HAVE_THREADS
     AVFifoBuffer *fifo;
     pthread_mutex_t lock;
     pthread_cond_t cond_recv;
     pthread_cond_t cond_send;
-    int err_send;
-    int err_recv;
+    atomic_int err_send;
+    atomic_int err_recv;
     unsigned elsize;
     void (*free_func)(void *msg);
+
+    /* Lock-free ring buffer, used instead of the fifo with
+     * AV_THREAD_MESSAGE_QUEUE_FLAG_LOCKLESS. The slot for position pos can be
+     * written when its sequence number is pos and read when it is pos + 1.
+     * The lock and conditions are only used to park threads which could not
+     * make progress after spinning. */
+    uint8_t *ring;
+    atomic_uint *seq;
+    unsigned mask;
+    int spin_count;
+    atomic_uint head;           /* next position to read */
+    atomic_uint tail;           /* next position to write */
+    atomic_int nb_waiting_send;
+    atomic_int nb_waiting_recv;
+    uint8_t *flush_buf;         /* message being freed by av_thread_message_flush() */
 #else
     int dummy;
 #endif
 };
 
+#if HAVE_THREADS
+static int ring_alloc(AVThreadMessageQueue *mq, unsigned nelem)
+{
+    unsigned i, size = 1;
+
+    while (size < nelem)
+        size <<= 1;
+    if (size > INT_MAX / mq->elsize)
+        return AVERROR(EINVAL);
+
+    mq->ring      = av_malloc_array(size, mq->elsize);
+    mq->seq       = av_malloc_array(size, sizeof(*mq->seq));
+    mq->flush_buf = av_malloc(mq->elsize);
+    if (!mq->ring || !mq->seq || !mq->flush_buf)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < size; i++)
+        atomic_init(&mq->seq[i], i);
+    mq->mask = size - 1;
+    mq->spin_count = av_cpu_count() > 1 ? SPIN_COUNT : 1;
+    atomic_init(&mq->head, 0);
+    atomic_init(&mq->tail, 0);
+    atomic_init(&mq->nb_waiting_send, 0);
+    atomic_init(&mq->nb_waiting_recv, 0);
+    return 0;
+}
+
+static void ring_free(AVThreadMessageQueue *mq)
+{
+    av_freep(&mq->ring);
+    av_freep(&mq->seq);
+    av_freep(&mq->flush_buf);
+}
+#endif
+
 int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize)
+{
+    return av_thread_message_queue_alloc2(mq, nelem, elsize, 0);
+}
+
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags)
 {
 #if HAVE_THREADS
     AVThreadMessageQueue *rmq;
     int ret = 0;
 
-    if (nelem > INT_MAX / elsize)
+    if (!elsize || nelem > INT_MAX / elsize)
         return AVERROR(EINVAL);
     if (!(rmq = av_mallocz(sizeof(*rmq))))
         return AVERROR(ENOMEM);
@@ -64,14 +132,21 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
         av_free(rmq);
         return AVERROR(ret);
     }
-    if (!(rmq->fifo = av_fifo_alloc(elsize * nelem))) {
+    rmq->elsize = elsize;
+    atomic_init(&rmq->err_send, 0);
+    atomic_init(&rmq->err_recv, 0);
+    if (flags & AV_THREAD_MESSAGE_QUEUE_FLAG_LOCKLESS)
+        ret = ring_alloc(rmq, nelem);
+    else if (!(rmq->fifo = av_fifo_alloc(elsize * nelem)))
+        ret = AVERROR(ENOMEM);
+    if (ret < 0) {
+        ring_free(rmq);
         pthread_cond_destroy(&rmq->cond_send);
         pthread_cond_destroy(&rmq->cond_recv);
         pthread_mutex_destroy(&rmq->lock);
         av_free(rmq);
-        return AVERROR(ENOMEM);
+        return ret;
     }
-    rmq->elsize = elsize;
     *mq = rmq;
     return 0;
 #else
@@ -94,6 +169,7 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
     if (*mq) {
         av_thread_message_flush(*mq);
         av_fifo_freep(&(*mq)->fifo);
+        ring_free(*mq);
         pthread_cond_destroy(&(*mq)->cond_send);
         pthread_cond_destroy(&(*mq)->cond_recv);
         pthread_mutex_destroy(&(*mq)->lock);
@@ -106,6 +182,11 @@ int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq)
 {
 #if HAVE_THREADS
     int ret;
+    if (mq->ring) {
+        unsigned head = atomic_load_explicit(&mq->head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(&mq->tail, memory_order_relaxed);
+        return FFMAX((int)(tail - head), 0);
+    }
     pthread_mutex_lock(&mq->lock);
     ret = av_fifo_size(mq->fifo);
     pthread_mutex_unlock(&mq->lock);
@@ -151,6 +232,133 @@ static int av_thread_message_queue_recv_locked(AVThreadMessageQueue *mq,
     return 0;
 }
 
+static int ring_try_send(AVThreadMessageQueue *mq, void *msg)
+{
+    unsigned pos = atomic_load_explicit(&mq->tail, memory_order_relaxed);
+
+    while (1) {
+        unsigned seq = atomic_load_explicit(&mq->seq[pos & mq->mask],
+                                            memory_order_acquire);
+        int diff = (int)(seq - pos);
+        if (!diff) {
+            if (atomic_compare_exchange_weak_explicit(&mq->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return AVERROR(EAGAIN);
+        } else {
+            pos = atomic_load_explicit(&mq->tail, memory_order_relaxed);
+        }
+    }
+    memcpy(mq->ring + (size_t)(pos & mq->mask) * mq->elsize, msg, mq->elsize);
+    atomic_store_explicit(&mq->seq[pos & mq->mask], pos + 1, memory_order_release);
+    return 0;
+}
+
+static int ring_try_recv(AVThreadMessageQueue *mq, void *msg)
+{
+    unsigned pos = atomic_load_explicit(&mq->head, memory_order_relaxed);
+
+    while (1) {
+        unsigned seq = atomic_load_explicit(&mq->seq[pos & mq->mask],
+                                            memory_order_acquire);
+        int diff = (int)(seq - (pos + 1));
+        if (!diff) {
+            if (atomic_compare_exchange_weak_explicit(&mq->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return AVERROR(EAGAIN);
+        } else {
+            pos = atomic_load_explicit(&mq->head, memory_order_relaxed);
+        }
+    }
+    memcpy(msg, mq->ring + (size_t)(pos & mq->mask) * mq->elsize, mq->elsize);
+    atomic_store_explicit(&mq->seq[pos & mq->mask], pos + mq->mask + 1,
+                          memory_order_release);
+    return 0;
+}
+
+/* Wake up one thread parked waiting for the given condition. The fence pairs
+ * with the one in ring_park() so that either the waiting thread sees the
+ * progress made, or this thread sees the waiting thread. */
+static void ring_wake(AVThreadMessageQueue *mq, atomic_int *nb_waiting,
+                      pthread_cond_t *cond)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(nb_waiting, memory_order_relaxed)) {
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&mq->lock);
+    }
+}
+
+static void ring_park(atomic_int *nb_waiting)
+{
+    atomic_fetch_add_explicit(nb_waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+static int ring_send(AVThreadMessageQueue *mq, void *msg, unsigned flags)
+{
+    int i, ret;
+
+    for (i = 0; i < mq->spin_count; i++) {
+        if ((ret = atomic_load(&mq->err_send)))
+            return ret;
+        ret = ring_try_send(mq, msg);
+        if (ret != AVERROR(EAGAIN))
+            goto done;
+        if (flags & AV_THREAD_MESSAGE_NONBLOCK)
+            return ret;
+    }
+
+    pthread_mutex_lock(&mq->lock);
+    ring_park(&mq->nb_waiting_send);
+    while (!(ret = atomic_load(&mq->err_send)) &&
+           (ret = ring_try_send(mq, msg)) == AVERROR(EAGAIN))
+        pthread_cond_wait(&mq->cond_send, &mq->lock);
+    atomic_fetch_sub_explicit(&mq->nb_waiting_send, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&mq->lock);
+    if (ret < 0)
+        return ret;
+
+done:
+    ring_wake(mq, &mq->nb_waiting_recv, &mq->cond_recv);
+    return 0;
+}
+
+static int ring_recv(AVThreadMessageQueue *mq, void *msg, unsigned flags)
+{
+    int i, ret, err = 0;
+
+    for (i = 0; i < mq->spin_count; i++) {
+        ret = ring_try_recv(mq, msg);
+        if (ret != AVERROR(EAGAIN))
+            goto done;
+        if ((err = atomic_load(&mq->err_recv)))
+            return err;
+        if (flags & AV_THREAD_MESSAGE_NONBLOCK)
+            return ret;
+    }
+
+    pthread_mutex_lock(&mq->lock);
+    ring_park(&mq->nb_waiting_recv);
+    while ((ret = ring_try_recv(mq, msg)) == AVERROR(EAGAIN) &&
+           !(err = atomic_load(&mq->err_recv)))
+        pthread_cond_wait(&mq->cond_recv, &mq->lock);
+    atomic_fetch_sub_explicit(&mq->nb_waiting_recv, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&mq->lock);
+    if (ret < 0)
+        return err;
+
+done:
+    ring_wake(mq, &mq->nb_waiting_send, &mq->cond_send);
+    return 0;
+}
+
 #endif /* HAVE_THREADS */
 
 int av_thread_message_queue_send(AVThreadMessageQueue *mq,
@@ -160,6 +368,9 @@ int av_thread_message_queue_send(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->ring)
+        return ring_send(mq, msg, flags);
+
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_send_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -176,6 +387,9 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->ring)
+        return ring_recv(mq, msg, flags);
+
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_recv_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -222,6 +436,14 @@ void av_thread_message_flush(AVThreadMessageQueue *mq)
     void *free_func = mq->free_func;
 
     pthread_mutex_lock(&mq->lock);
+    if (mq->ring) {
+        while (ring_try_recv(mq, mq->flush_buf) >= 0)
+            if (mq->free_func)
+                mq->free_func(mq->flush_buf);
+        pthread_cond_broadcast(&mq->cond_send);
+        pthread_mutex_unlock(&mq->lock);
+        return;
+    }
     used = av_fifo_size(mq->fifo);
     if (free_func)
         for (off = 0; off < used; off += mq->elsize)
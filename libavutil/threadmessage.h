@@ -45,6 +45,30 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize);
 
+/**
+ * Use a lock-free ring buffer instead of a mutex protected FIFO.
+ *
+ * Send and receive operations only take the queue lock when they have to
+ * block, which reduces contention when several threads exchange many small
+ * messages. The capacity of the queue is rounded up to a power of two.
+ */
+#define AV_THREAD_MESSAGE_QUEUE_FLAG_LOCKLESS (1 << 0)
+
+/**
+ * Allocate a new message queue.
+ *
+ * @param mq      pointer to the message queue
+ * @param nelem   maximum number of elements in the queue
+ * @param elsize  size of each element in the queue
+ * @param flags   a combination of AV_THREAD_MESSAGE_QUEUE_FLAG_*
+ * @return  >=0 for success; <0 for error, in particular AVERROR(ENOSYS) if
+ *          lavu was built without thread support
+ */
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags);
+
 /**
  * Free a message queue.
  *
@@ -446,6 +446,18 @@ gaplessenc(){
     probegaplessinfo "$(target_path "$file1")"
 }
 
+mov_faststart(){
+    file="${outdir}/${test}.mov"
+    cleanfiles="$cleanfiles $file"
+
+    # the muxer is only bitexact when given in the arguments, the moov is
+    # moved in place otherwise where the filesystem supports it
+    ffmpeg -f lavfi -i "testsrc2=r=10:d=5" -f lavfi -i "sine=d=5" -flags +bitexact -threads 1 \
+        -c:v mpeg4 -c:a pcm_s16le -movflags +faststart "$@" -y $(target_path $file) || return
+    # reading from a pipe requires the moov in front of the mdat
+    ffmpeg -i pipe: -c copy -bitexact -f framecrc - < $file
+}
+
 audio_match(){
     sample=$(target_path $1)
     trefile=$2
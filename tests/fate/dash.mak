@@ -0,0 +1,20 @@
+tests/data/dash_segment_list.mpd: TAG = GEN
+tests/data/dash_segment_list.mpd: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+	-f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=20" -f dash -use_template 0 -use_timeline 0 -map 0 \
+	-seg_duration 2 -codec:a mp2fixed -flags +bitexact -fflags +bitexact \
+	-init_seg_name 'dash_segment_list-init.m4s' -media_seg_name 'dash_segment_list-$$Number%05d$$.m4s' \
+	$(TARGET_PATH)/tests/data/dash_segment_list.mpd 2>/dev/null
+
+FATE_DASH-$(call ALLYES, DASH_DEMUXER DASH_MUXER MOV_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-dash-segment-list
+fate-dash-segment-list: tests/data/dash_segment_list.mpd
+fate-dash-segment-list: CMD = framecrc -flags +bitexact -i $(TARGET_PATH)/tests/data/dash_segment_list.mpd -c copy
+
+FATE_DASH-$(call ALLYES, DASH_DEMUXER DASH_MUXER MOV_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-dash-segment-list-prefetch
+fate-dash-segment-list-prefetch: tests/data/dash_segment_list.mpd
+fate-dash-segment-list-prefetch: CMD = framecrc -flags +bitexact -prefetch_segments 3 -prefetch_size 65536 -i $(TARGET_PATH)/tests/data/dash_segment_list.mpd -c copy
+fate-dash-segment-list-prefetch: REF = $(SRC_PATH)/tests/ref/fate/dash-segment-list
+
+FATE_FFMPEG += $(FATE_DASH-yes)
+
+fate-dash: $(FATE_DASH-yes)
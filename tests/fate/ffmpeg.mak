@@ -38,6 +38,12 @@ FATE_SAMPLES_FFMPEG-$(CONFIG_COLORKEY_FILTER) += fate-ffmpeg-filter_colorkey
 fate-ffmpeg-filter_colorkey: tests/data/filtergraphs/colorkey
 fate-ffmpeg-filter_colorkey: CMD = framecrc -idct simple -fflags +bitexact -flags +bitexact  -sws_flags +accurate_rnd+bitexact -i $(TARGET_SAMPLES)/cavs/cavs.mpg -fflags +bitexact -flags +bitexact -sws_flags +accurate_rnd+bitexact -i $(TARGET_SAMPLES)/lena.pnm -an -filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/colorkey -sws_flags +accurate_rnd+bitexact -fflags +bitexact -flags +bitexact -qscale 2 -frames:v 10
 
+FATE_FFMPEG-$(call ALLYES, TESTSRC_FILTER SPLIT_FILTER SCALE_FILTER RAWVIDEO_ENCODER FRAMECRC_MUXER) += fate-ffmpeg-parallel_outputs
+fate-ffmpeg-parallel_outputs: CMD = ffmpeg -parallel_outputs -filter_complex "testsrc=d=2:r=25:s=64x48,split=3[a][b][c]" \
+  -map "[a]" -c:v rawvideo -fflags +bitexact -f framecrc md5: \
+  -map "[b]" -c:v rawvideo -s 32x24 -sws_flags +accurate_rnd+bitexact -fflags +bitexact -f framecrc md5: \
+  -map "[c]" -c:v rawvideo -r 10 -fflags +bitexact -f framecrc md5:
+
 FATE_FFMPEG-$(CONFIG_COLOR_FILTER) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
@@ -71,6 +71,13 @@ fate-filter-lavd-life: CMD = framecrc -f lavfi -i life=s=40x40:r=5:seed=42:mold=
 FATE_FILTER-$(call ALLYES, AVDEVICE TESTSRC_FILTER) += fate-filter-lavd-testsrc
 fate-filter-lavd-testsrc: CMD = framecrc -f lavfi -i testsrc=r=7:n=2:d=10
 
+FATE_FILTER_GRAPH_THREADS = fate-filter-graph-threads fate-filter-graph-threads-graph
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER SPLIT_FILTER HFLIP_FILTER VFLIP_FILTER SCALE_FILTER CROP_FILTER PAD_FILTER HSTACK_FILTER) += $(FATE_FILTER_GRAPH_THREADS)
+FILTER_GRAPH_THREADS = testsrc2=s=320x240:r=5:d=2,split=3[a][b][c];[a]hflip,scale=160:120[a1];[b]vflip,crop=160:120,pad=160:120[b1];[c]scale=160:120,hflip,vflip[c1];[a1][b1][c1]hstack=3
+fate-filter-graph-threads: CMD = framecrc -filter_complex_threads 1 -filter_complex "$(FILTER_GRAPH_THREADS)" -pix_fmt yuv420p
+fate-filter-graph-threads-graph: CMD = framecrc -filter_thread_type slice+graph -filter_complex_threads 4 -filter_complex "$(FILTER_GRAPH_THREADS)" -pix_fmt yuv420p
+fate-filter-graph-threads-graph: REF = $(SRC_PATH)/tests/ref/fate/filter-graph-threads
+
 FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER) += fate-filter-testsrc2-yuv420p
 fate-filter-testsrc2-yuv420p: CMD = framecrc -lavfi testsrc2=r=7:d=10 -pix_fmt yuv420p
 
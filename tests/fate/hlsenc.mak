@@ -63,6 +63,11 @@ FATE_AFILTER-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FIL
 fate-hls-segment-single: tests/data/hls_segment_single.m3u8
 fate-hls-segment-single: CMD = framecrc -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_segment_single.m3u8 -vf setpts=N*23
 
+FATE_AFILTER-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-segment-single-prefetch
+fate-hls-segment-single-prefetch: tests/data/hls_segment_single.m3u8
+fate-hls-segment-single-prefetch: CMD = framecrc -flags +bitexact -prefetch_segments 3 -prefetch_size 65536 -i $(TARGET_PATH)/tests/data/hls_segment_single.m3u8 -vf setpts=N*23
+fate-hls-segment-single-prefetch: REF = $(SRC_PATH)/tests/ref/fate/hls-segment-single
+
 tests/data/hls_init_time.m3u8: TAG = GEN
 tests/data/hls_init_time.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
 	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
@@ -2,6 +2,14 @@
 #fate-async: libavformat/tests/async$(EXESUF)
 #fate-async: CMD = run libavformat/tests/async
 
+FATE_LIBAVFORMAT-yes += fate-aviobuf
+fate-aviobuf: libavformat/tests/aviobuf$(EXESUF)
+fate-aviobuf: CMD = run libavformat/tests/aviobuf$(EXESUF)
+
+FATE_LIBAVFORMAT-yes += fate-index
+fate-index: libavformat/tests/index$(EXESUF)
+fate-index: CMD = run libavformat/tests/index$(EXESUF)
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy$(EXESUF)
@@ -22,6 +30,10 @@ FATE_LIBAVFORMAT-$(CONFIG_MOV_MUXER) += fate-movenc
 fate-movenc: libavformat/tests/movenc$(EXESUF)
 fate-movenc: CMD = run libavformat/tests/movenc$(EXESUF)
 
+FATE_LIBAVFORMAT-$(CONFIG_MPEGTS_MUXER) += fate-mpegtsenc
+fate-mpegtsenc: libavformat/tests/mpegtsenc$(EXESUF)
+fate-mpegtsenc: CMD = run libavformat/tests/mpegtsenc$(EXESUF)
+
 FATE_LIBAVFORMAT += $(FATE_LIBAVFORMAT-yes)
 FATE-$(CONFIG_AVFORMAT) += $(FATE_LIBAVFORMAT)
 fate-libavformat: $(FATE_LIBAVFORMAT)
@@ -35,6 +35,10 @@ FATE_LIBAVUTIL += fate-base64
 fate-base64: libavutil/tests/base64$(EXESUF)
 fate-base64: CMD = run libavutil/tests/base64$(EXESUF)
 
+FATE_LIBAVUTIL += fate-buffer
+fate-buffer: libavutil/tests/buffer$(EXESUF)
+fate-buffer: CMD = run libavutil/tests/buffer$(EXESUF)
+
 FATE_LIBAVUTIL += fate-blowfish
 fate-blowfish: libavutil/tests/blowfish$(EXESUF)
 fate-blowfish: CMD = run libavutil/tests/blowfish$(EXESUF)
@@ -53,6 +57,16 @@ fate-cpu_init: libavutil/tests/cpu_init$(EXESUF)
 fate-cpu_init: CMD = run libavutil/tests/cpu_init$(EXESUF)
 fate-cpu_init: CMP = null
 
+FATE_LIBAVUTIL-$(HAVE_THREADS) += fate-slicethread
+fate-slicethread: libavutil/tests/slicethread$(EXESUF)
+fate-slicethread: CMD = run libavutil/tests/slicethread$(EXESUF)
+fate-slicethread: CMP = null
+
+FATE_LIBAVUTIL-$(HAVE_THREADS) += fate-threadmessage
+fate-threadmessage: libavutil/tests/threadmessage$(EXESUF)
+fate-threadmessage: CMD = run libavutil/tests/threadmessage$(EXESUF)
+fate-threadmessage: CMP = null
+
 FATE_LIBAVUTIL += fate-crc
 fate-crc: libavutil/tests/crc$(EXESUF)
 fate-crc: CMD = run libavutil/tests/crc$(EXESUF)
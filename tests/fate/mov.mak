@@ -7,6 +7,8 @@ FATE_MOV = fate-mov-3elist \
            fate-mov-2elist-elist1-ends-bframe \
            fate-mov-3elist-encrypted \
            fate-mov-frag-encrypted \
+           fate-mov-frag-encrypted-zerocopy \
+           fate-mov-frag-encrypted-mmap \
            fate-mov-tenc-only-encrypted \
            fate-mov-invalid-elst-entry-count \
            fate-mov-gpmf-remux \
@@ -36,7 +38,10 @@ FATE_SAMPLES_AVCONV += $(FATE_MOV)
 FATE_SAMPLES_FFPROBE += $(FATE_MOV_FFPROBE)
 FATE_SAMPLES_FASTSTART += $(FATE_MOV_FASTSTART)
 
-fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART)
+FATE_MOV_FFMPEG-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER SINE_FILTER MPEG4_ENCODER PCM_S16LE_ENCODER MOV_MUXER MOV_DEMUXER PIPE_PROTOCOL FILE_PROTOCOL) += fate-mov-faststart fate-mov-faststart-bitexact
+FATE_FFMPEG += $(FATE_MOV_FFMPEG-yes)
+
+fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART) $(FATE_MOV_FFMPEG-yes)
 
 # Make sure we handle edit lists correctly in normal cases.
 fate-mov-1elist-noctts: CMD = framemd5 -i $(TARGET_SAMPLES)/mov/mov-1elist-noctts.mov
@@ -50,6 +55,12 @@ fate-mov-3elist-encrypted: CMD = framemd5 -decryption_key 1234567890123456789012
 # Fragmented encryption with senc boxes in movie fragments.
 fate-mov-frag-encrypted: CMD = framemd5 -decryption_key 12345678901234567890123456789012 -i $(TARGET_SAMPLES)/mov/mov-frag-encrypted.mp4
 
+# Same with packets sharing the I/O buffer, which must not be decrypted in place.
+fate-mov-frag-encrypted-zerocopy: REF = $(SRC_PATH)/tests/ref/fate/mov-frag-encrypted
+fate-mov-frag-encrypted-zerocopy: CMD = framemd5 -fflags +zerocopy -decryption_key 12345678901234567890123456789012 -i $(TARGET_SAMPLES)/mov/mov-frag-encrypted.mp4
+fate-mov-frag-encrypted-mmap: REF = $(SRC_PATH)/tests/ref/fate/mov-frag-encrypted
+fate-mov-frag-encrypted-mmap: CMD = framemd5 -mmap 1 -decryption_key 12345678901234567890123456789012 -i $(TARGET_SAMPLES)/mov/mov-frag-encrypted.mp4
+
 # Full-sample encryption and constant IV using only tenc atom (no senc/saio/saiz).
 fate-mov-tenc-only-encrypted: CMD = framemd5 -decryption_key 12345678901234567890123456789012 -i $(TARGET_SAMPLES)/mov/mov-tenc-only-encrypted.mp4
 
@@ -124,3 +135,9 @@ fate-mov-faststart-4gb-overflow: CMP = oneline
 fate-mov-faststart-4gb-overflow: REF = bc875921f151871e787c4b4023269b29
 
 fate-mov-mp4-with-mov-in24-ver: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -show_entries stream=codec_name -select_streams 1 $(TARGET_SAMPLES)/mov/mp4-with-mov-in24-ver.mp4
+
+# Inserts space for the moov into the file where the filesystem supports it,
+# and moves the data otherwise, as with bitexact.
+fate-mov-faststart: CMD = mov_faststart
+fate-mov-faststart-bitexact: CMD = mov_faststart -fflags +bitexact
+fate-mov-faststart-bitexact: REF = $(SRC_PATH)/tests/ref/fate/mov-faststart
@@ -246,6 +246,11 @@ fate-seek-lavf-y4m:      SRC = lavf/lavf.y4m
 
 FATE_SEEK += $(FATE_SEEK_LAVF-yes:%=fate-seek-lavf-%)
 
+FATE_SEEK_PREFETCH-$(call ENCDEC2, MPEG4, MP2, MATROSKA) += fate-seek-lavf-mkv-prefetch
+fate-seek-lavf-mkv-prefetch: fate-lavf-mkv libavformat/tests/seek$(EXESUF)
+fate-seek-lavf-mkv-prefetch: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.mkv -prefetch_clusters 2 -prefetch_size 65536
+fate-seek-lavf-mkv-prefetch: REF = $(SRC_PATH)/tests/ref/seek/lavf-mkv
+
 # extra files
 
 FATE_SEEK_EXTRA-$(CONFIG_MP3_DEMUXER)   += fate-seek-extra-mp3
@@ -272,6 +277,6 @@ $(FATE_SEEK) $(FATE_SAMPLES_SEEK): CMD = run libavformat/tests/seek$(EXESUF) $(T
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): fate-seek-%: fate-%
 fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
-FATE_AVCONV += $(FATE_SEEK)
+FATE_AVCONV += $(FATE_SEEK) $(FATE_SEEK_PREFETCH-yes)
 FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
-fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+fate-seek:     $(FATE_SEEK) $(FATE_SEEK_PREFETCH-yes) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
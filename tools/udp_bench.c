@@ -0,0 +1,184 @@
+/*
+ * UDP protocol loopback benchmark
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Send datagrams to a udp:// URL on the loopback interface and receive them
+ * with another one, e.g. to compare
+ *     tools/udp_bench -oo gso=0 -oi gro=0
+ *     tools/udp_bench -oo gso=1 -oi gro=1
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if HAVE_SYS_RESOURCE_H
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+#if HAVE_THREADS
+typedef struct Receiver {
+    AVIOContext *pb;
+    int count;
+    int received;
+    int errors;
+    int64_t end_time;
+} Receiver;
+
+static int64_t cpu_time(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage rusage;
+
+    getrusage(RUSAGE_SELF, &rusage);
+    return (rusage.ru_utime.tv_sec + rusage.ru_stime.tv_sec) * 1000000LL +
+            rusage.ru_utime.tv_usec + rusage.ru_stime.tv_usec;
+#else
+    return 0;
+#endif
+}
+
+static void *receive(void *arg)
+{
+    Receiver *r = arg;
+    static uint8_t buf[65536];
+    uint32_t expected = 0;
+
+    while (r->received < r->count) {
+        int ret = avio_read_partial(r->pb, buf, sizeof(buf));
+        if (ret == AVERROR(EAGAIN))
+            continue;
+        if (ret < 4)
+            break;
+        /* datagrams may be lost, but neither reordered nor altered */
+        if (AV_RB32(buf) < expected)
+            r->errors++;
+        expected = AV_RB32(buf) + 1;
+        r->received++;
+        r->end_time = av_gettime_relative();
+    }
+    return NULL;
+}
+
+static int usage(const char *argv0, int ret)
+{
+    fprintf(stderr, "%s [-n count] [-s size] [-p port] [-oi <options>] [-oo <options>]\n", argv0);
+    fprintf(stderr, "<options>: AVOptions of the receiving (-oi) and sending (-oo) udp URLs, expressed as key=value, :-separated\n");
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int count = 100000, size = 1316, port = 23456, ret, i;
+    char url[64], size_str[16];
+    AVDictionary *in_opts = NULL, *out_opts = NULL;
+    AVIOContext *output;
+    Receiver r = { 0 };
+    pthread_t thread;
+    uint8_t *buf;
+    int64_t start_time, send_time, cpu;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            size = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if ((!strcmp(argv[i], "-oi") || !strcmp(argv[i], "-oo")) && i + 1 < argc) {
+            if (av_dict_parse_string(argv[i][2] == 'i' ? &in_opts : &out_opts,
+                                     argv[i + 1], "=", ":", 0) < 0) {
+                fprintf(stderr, "Cannot parse option string %s\n", argv[i + 1]);
+                return usage(argv[0], 1);
+            }
+            i++;
+        } else {
+            return usage(argv[0], 1);
+        }
+    }
+    if (count <= 0 || size < 4 || size > 65507)
+        return usage(argv[0], 1);
+
+    avformat_network_init();
+
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d", port);
+    snprintf(size_str, sizeof(size_str), "%d", size);
+    av_dict_set(&in_opts,  "timeout",  "1000000", AV_DICT_DONT_OVERWRITE);
+    av_dict_set(&out_opts, "pkt_size", size_str,  AV_DICT_DONT_OVERWRITE);
+
+    if ((ret = avio_open2(&r.pb, url, AVIO_FLAG_READ, NULL, &in_opts)) < 0) {
+        fprintf(stderr, "Unable to open %s: %s\n", url, av_err2str(ret));
+        return 1;
+    }
+    if ((ret = avio_open2(&output, url, AVIO_FLAG_WRITE, NULL, &out_opts)) < 0) {
+        fprintf(stderr, "Unable to open %s: %s\n", url, av_err2str(ret));
+        return 1;
+    }
+    if (!(buf = av_mallocz(size)))
+        return 1;
+
+    r.count = count;
+    if ((ret = pthread_create(&thread, NULL, receive, &r))) {
+        fprintf(stderr, "Unable to start the receiver: %s\n", av_err2str(AVERROR(ret)));
+        return 1;
+    }
+
+    start_time = av_gettime_relative();
+    cpu        = cpu_time();
+    for (i = 0; i < count && !output->error; i++) {
+        AV_WB32(buf, i);
+        avio_write(output, buf, size);
+        avio_flush(output);
+    }
+    avio_closep(&output);
+    send_time = av_gettime_relative() - start_time;
+
+    pthread_join(thread, NULL);
+    cpu = cpu_time() - cpu;
+
+    printf("sent %d datagrams of %d bytes in %.3fs, %.1f Mbit/s\n",
+           i, size, send_time / 1000000.0, i * (size * 8.0) / FFMAX(send_time, 1));
+    printf("received %d datagrams in %.3fs, %d lost, %d out of order\n",
+           r.received, (r.end_time - start_time) / 1000000.0,
+           count - r.received, r.errors);
+    printf("cpu time %.3fs, %.2fus per datagram\n",
+           cpu / 1000000.0, (double)cpu / FFMAX(r.received, 1));
+
+    avio_closep(&r.pb);
+    av_free(buf);
+    av_dict_free(&in_opts);
+    av_dict_free(&out_opts);
+    avformat_network_deinit();
+    return 0;
+}
+#else
+int main(int argc, char **argv)
+{
+    fprintf(stderr, "%s requires threads\n", argv[0]);
+    return 1;
+}
+#endif